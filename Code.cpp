@@ -1,4 +1,6 @@
 ﻿#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <iostream>
 #include <winsock2.h> // ���� ��� ���� 
 #include <windows.h> 
@@ -9,6 +11,25 @@
 #include <vector>
 #include <fstream>
 #include "SerialClass.h"
+#include "mouse_parser.h"
+#include "wait_strategy.h"
+#include "mouse_link.h"
+#include "byte_source.h"
+#include "clock_sync.h"
+#include "kinematics.hpp"
+#include "tracker_config.h"
+#include "fixed_odometry.h"
+#include "record_format.h"
+#include "pose_history.h"
+#include "pose_predictor.h"
+#include "pose_packet.h"
+#include "pose_publisher.h"
+#include "pose_shm_channel.h"
+#include "async_logger.h"
+#include "log_sink.h"
+#include "stream_log.h"
+#include "session_clock.h"
+#include "session_stop.h"
 #include  <signal.h>
 
 #include "myologger.h"
@@ -23,55 +44,133 @@
 using std::fstream;
 using std::to_string;
 
-#define BUFFER_SIZE 128 //���� ���� �ÿ��� ��� default=1024
-const double D = 2.834646; //inch
-const double CPI = 1200.0;
-const double PI = 3.14159265358979323846;
-const double R = 180.0 / (PI * D * CPI);
-const double l1 = 5; //���� �̸� �����ؾ���
-const double l2 = 8;
-const double l3 = 3;
-const int TERM = 2;
-
-double move[TERM][2]; // [ [xi, yi] , [xi+1, yi+1] ��.   ]
-double dmove[TERM][2]; // [ [dxi, dyi] , [dxi+1, dyi+1] ��.   ]
-double theta[TERM];
-double degree1, degree2, degree3;
+#define BUFFER_SIZE 512 //���� ���� �ÿ��� ��� default=1024
+//D, CPI and ARM are in tracker_config.h
+//firmware built with BINARY_PROTOCOL sends mouse_packet.h frames instead of ASCII
+const bool BINARY_PROTOCOL = false;
+//read the serial port from a background thread into a ring buffer
+const bool SERIAL_READER_THREAD = true;
+//what the loop does while no bytes are coming in, see wait_strategy.h
+const WaitMode WAIT_MODE = WaitMode::Block;
+//print CPU use and estimated queueing latency of WAIT_MODE at exit
+const bool MEASURE_WAIT = false;
+//rate the firmware starts with, and the rate negotiated right after connecting
+//(set LINK_BAUD = SERIAL_BAUD for firmware without the 'B' command)
+const unsigned long SERIAL_BAUD = 9600;
+const unsigned long LINK_BAUD = 1000000;
+//samples kept in poseHistory for readers outside the tracking loop
+const size_t POSE_HISTORY_DEPTH = 1024;
+//solve IK incrementally from the last sample (DifferentialArmSolver), pays
+//off once the firmware reports every few ms; off: closed form every sample
+const bool DIFFERENTIAL_IK = false;
+//dead reckoning core: MouseOdometry<double>, or FixedOdometry which integrates
+//in integer counts, is cheaper and replays a capture bit for bit anywhere
+typedef MouseOdometry<double> Odometry;
+//send visual.py the pose extrapolated to this long after the report arrived
+//(its render latency), see PosePredictor; 0 sends the measured pose
+const long long PREDICT_DISPLAY_NS = 0;
+//send pose_packet.h datagrams to visual.py; false sends the old text lines
+//(visual.py reads both)
+const bool UDP_BINARY = true;
+//PosePublisher sends the newest pose every this many ns (e.g. 16666667 for a
+//60 Hz display); 0 sends every pose as soon as it is computed
+const long long PUBLISH_INTERVAL_NS = 0;
+//also write every pose to the pose_shm.h segment, for consumers on this
+//machine (visual.py --shm); UDP stays on for the others
+const bool POSE_SHM = true;
+
 
 //extern std::chrono::time_point<clock_> begin_time;
 
 int c = 0;
 
-//���� ��ȯ
-double degree_to_rad(double degree);
-double rad_to_degree(double rad);
-
-//mouse���� ���� input�� ����ؼ� move, dmove, theta�� ���
-void theta_converter(int dx1, int dy1, int dx2, int dy2, int buttonState1, int buttonState2, int index);
+// cntr c handler
 
-//inverse kinematics
-void _2dof_inversekinematics(double x, double y);
-void _3dof_inversekinematics(double x, double y, double degree);//���ⱸ���� Ǫ�� ����
+void     INThandler(int);
 
-//����� �е� �߾ӿ� ������ ����
-void diffMean(double centerX, double centerY, double centerTheta);
-//x,y,theta ���� �ʱ�ȭ
-void reset(int cnt);
+//Code.exe [--capture file] [--replay file [--speed N]] [--generate reports]
+//  --capture  also write every raw serial chunk to file, see CaptureWriter
+//  --replay   read a capture instead of the port, --speed 1 is real time,
+//             N is N times faster, 0 as fast as possible
+//  --generate run on synthetic reports instead of the port
+//Replay and generate run without the port, Myo and Motive.
+int main(int argc, char* argv[])
+{
+	const char* capturePath = nullptr;
+	const char* replayPath = nullptr;
+	double replaySpeed = 1.0;
+	long generateReports = 0;
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--capture") == 0) capturePath = argv[++i];
+		else if (strcmp(argv[i], "--replay") == 0) replayPath = argv[++i];
+		else if (strcmp(argv[i], "--speed") == 0) replaySpeed = atof(argv[++i]);
+		else if (strcmp(argv[i], "--generate") == 0) generateReports = atol(argv[++i]);
+	}
+	bool live = replayPath == nullptr && generateReports == 0;
 
-void file_out(std::ofstream& file, int x, int y, int x1, int y1, int x2, int y2, double theta, double degree1, double degree2, double degree3);
+	//the epoch every thread stamps from; calibrating the TSC takes a moment,
+	//better here than in the first sample of a thread
+	session_clock_start();
 
-// cntr c handler
+	//Myo and Motive come up while the port connects
+	if (live)
+	{
+		//myo
+		std::thread* mt = new std::thread(LogMyoArmband, "myoarmband");
+		if (mt) mt->detach();
+		else std::printf("Failed to start Myo Armband Thread\n");
+
+		//motion capture
+		std::thread* motive = new std::thread(logMotive);
+		if (motive) motive->detach();
+		else std::printf("Failed to start Motive Thraed\n");
+	}
 
-void     INThandler(int);
+	ByteSource* source;
+	Serial* SP = nullptr;
+	unsigned long linkBaud = SERIAL_BAUD;
+	if (replayPath != nullptr)
+		source = new ReplaySource(replayPath, replaySpeed);
+	else if (generateReports > 0)
+		source = new GeneratorSource(generateReports, BINARY_PROTOCOL);
+	else
+	{
+		//connect serial port
+		printf("Welcome to the serial test app!\n\n");
+		SP = new Serial("\\\\.\\COM5", SERIAL_BAUD);    // ����� pc�� ���缭 �����ؾ���
+
+		if (SP->IsConnected())
+			std::cout << "We're connected\n" << std::endl;
+		if (SERIAL_READER_THREAD && !SP->StartReader())
+			std::cout << "failed to start the serial reader thread" << std::endl;
+
+		//wait until the firmware is up instead of a fixed sleep
+		FirmwareHello hello;
+		if (SP->IsConnected())
+		{
+			if (!wait_for_hello(*SP, HELLO_TIMEOUT_MS, hello))
+				std::cout << "no hello from the firmware, carrying on" << std::endl;
+			else if (hello.binary != BINARY_PROTOCOL)
+				std::cout << "firmware sends " << (hello.binary ? "binary" : "ascii") << " reports, check BINARY_PROTOCOL" << std::endl;
+			else
+				std::cout << "firmware v" << hello.version << " ready" << std::endl;
+		}
 
-int main()
-{
-	//connect serial port
-	printf("Welcome to the serial test app!\n\n");
-	Serial* SP = new Serial("\\\\.\\COM5");    // ����� pc�� ���缭 �����ؾ���
+		if (SP->IsConnected() && LINK_BAUD != SERIAL_BAUD)
+		{
+			if (negotiate_baud(*SP, SERIAL_BAUD, LINK_BAUD))
+				linkBaud = LINK_BAUD;
+			else
+				std::cout << "baud rate switch to " << LINK_BAUD << " failed" << std::endl;
+			std::cout << "serial link at " << linkBaud << " baud" << std::endl;
+		}
+		source = new SerialSource(*SP);
+	}
 
-	if (SP->IsConnected())
-		std::cout << "We're connected\n" << std::endl;
+	CaptureWriter capture;
+	if (capturePath != nullptr && !capture.Open(capturePath))
+		std::cout << "could not open capture file " << capturePath << std::endl;
 
 	//make socket
 	WSADATA wsaData;
@@ -103,6 +202,20 @@ int main()
 		exit(0);
 	}
 
+	//a full socket buffer drops the datagram, the next pose is newer anyway
+	u_long nonBlocking = 1;
+	ioctlsocket(ClientSocket, FIONBIO, &nonBlocking);
+
+	//sendto runs on the publisher thread, never in the serial loop
+	PosePublisher publisher([&](const char* data, int length) {
+		return sendto(ClientSocket, data, length, 0, (struct sockaddr*)&ToServer, sizeof(ToServer)) == length;
+	}, UDP_BINARY, PUBLISH_INTERVAL_NS);
+	publisher.Start();
+
+	PoseShmWriter shmWriter;
+	if (POSE_SHM && !shmWriter.Open())
+		std::cout << "could not create the pose shared memory " << POSE_SHM_NAME << std::endl;
+
 	std::cout << std::fixed;
 	std::cout.precision(2);
 
@@ -111,243 +224,241 @@ int main()
 
 
 	//receive data
-	char incomingData[2] = "";
+	char incomingData[4096] = "";
 	int readResult = 0;
 	int dx1(0), dy1(0), dx2(0), dy2(0);
-	double x1, y1, x2, y2;
 	int button[2] = { 0, 0 };
-	int cnt = 0;
-	std::string inputState = "";
-	std::string num = "0";
-	move[0][0] = l1;  //�ʱ� x��
-	move[0][1] = l2 + l3; //�ʱ� y��
-
-	std::ofstream mouseOutFile;
-	mouseOutFile.open("rawdata/mouse.csv");
-	if (!mouseOutFile.is_open())
+	MouseStreamParser parser;
+	MousePacketDecoder decoder;
+	ClockSync clockSync;
+	long long sampleNs = 0;
+	long long hostNs = 0;
+	//session clock when the current read returned, the latency stats start from it
+	long long readNs = 0;
+	//device stamp of the current report, for the pose datagram
+	bool hasDeviceTime = false;
+	uint32_t deviceMicros = 0;
+	//mouse starts with the arm stretched out along +y
+	Odometry odometry(CPI, D, ARM.l1, ARM.l2 + ARM.l3);
+	//written only by process_sample, read lock-free by other threads
+	PoseHistory poseHistory(POSE_HISTORY_DEPTH);
+	DifferentialArmSolver<double> armSolver(ARM);
+	PosePredictor predictor;
+	PredictionStats predictionStats;
+
+	//rawdata/mouse is written by a background thread, see BINARY_LOGS
+	std::unique_ptr<LogSink> mouseFile = open_log_sink(BINARY_LOGS ? "rawdata/mouse.bin" : "rawdata/mouse.csv", MMAP_LOGS);
+	if (!mouseFile)
 	{
 		std::cout << "mouse not opened" << std::endl;
 		return 1;
 	}
-
-	//myo
-	std::thread* mt = new std::thread(LogMyoArmband, "myoarmband");
-	if (mt) mt->detach();
-	else std::printf("Failed to start Myo Armband Thread\n");
-
-	//motion capture
-	std::thread* motive = new std::thread(logMotive);
-	if (motive) motive->detach();
-	else std::printf("Failed to start Motive Thraed\n");
+	StreamLogEncoder<MouseRow> mouseBinary(mouse_schema());
+	TextEncoder<MouseRow> mouseText(format_mouse_row, MOUSE_ROW_MAX_CHARS);
+	AsyncLogger<MouseRow> mouseLog(*mouseFile, BINARY_LOGS ? (RecordEncoder<MouseRow>&)mouseBinary : mouseText, LOG_FLUSH_MS);
+	mouseLog.Start();
 
 
-	while (SP->IsConnected() && c != 3)
+	//one complete sample: dead reckoning, inverse kinematics, log and send
+	auto process_sample = [&]()
 	{
-		readResult = SP->ReadData(incomingData, 1);
-		if (readResult != 0)
+		odometry.Update(dx1, dy1, dx2, dy2);
+		//std::cout << " " << dx1 << " " << dx2 << " " << dy1 << " " << dy2 << " " << button[0] << " " << button[1] << std::endl;
+
+		double endRad = degree_to_rad(-odometry.Theta() + 90);
+		ArmSolution<double> solution = DIFFERENTIAL_IK ? armSolver.Solve(odometry.X(), odometry.Y(), endRad)
+			: solve_arm(ARM, odometry.X(), odometry.Y(), endRad);
+		//degrees from here on, for the history, the log and visual.py
+		JointAngles<double> q = { rad_to_degree(solution.q1), rad_to_degree(solution.q2), rad_to_degree(solution.q3) };
+		ArmPose<double> arm = { solution.x1, solution.y1, solution.x2, solution.y2 };
+		PoseSample pose = { 0, sampleNs, odometry.X(), odometry.Y(), odometry.Theta(), q.degree1, q.degree2, q.degree3 };
+		poseHistory.Push(pose);
+		//hostNs, sampleNs: when the report arrived and when the sensors were read, in the
+		//byte source's timebase (session_clock.h live, see ClockSync)
+		MouseRow row = { hostNs, sampleNs, hasDeviceTime ? (long long)deviceMicros : -1,
+			pose.x, pose.y, arm.x1, arm.y1, arm.x2, arm.y2, pose.theta, q.degree1, q.degree2, q.degree3,
+			dx1, dy1, dx2, dy2 };
+		mouseLog.Push(row);
+		/*std::cout << "x1: " << std::setw(5) << arm.x1
+			<< ", y1: " << std::setw(5) << arm.y1
+			<< ", x2: " << std::setw(5) << arm.x2
+			<< ", y2: " << std::setw(5) << arm.y2
+			<< ", x: " << std::setw(5) << odometry.X()
+			<< ", y: " << std::setw(5) << odometry.Y()
+			<< ", th: " << std::setw(5) << odometry.Theta()
+			<< ", th1: " << std::setw(5) << q.degree1
+			<< ",  th2: " << std::setw(5) << q.degree2
+			<< ", th3: " << std::setw(5) << q.degree3 << std::endl;*/
+
+			/*		std::cout << "dx1: " << std::setw(3) << dx1
+						<< ", dx2: " << std::setw(3) << dx2
+						<< ", dy1: " << std::setw(3) << dy1
+						<< ", dy3: " << std::setw(3) << dy2
+						<< ", th: " << std::setw(5) << odometry.Theta() << std::endl;*/
+
+
+
+		//send packet
+		PoseSample sent = pose;
+		bool predicted = false;
+		if (PREDICT_DISPLAY_NS > 0)
 		{
-			char ch = incomingData[0];
-			//std::cout << ch;
-
-			switch (ch)
+			long long targetNs = source->ArrivalNs() + PREDICT_DISPLAY_NS;
+			predictionStats.Actual(pose);
+			if (predictor.Predict(poseHistory, targetNs, sent))
 			{
-			case 'f':
-				std::cout << "end of clutching" << std::endl;
-				reset(cnt);
-				break;
-			case 'x':
-			case 'y':
-			case 'c':
-				inputState = ch;
-				break;
-			case 'a':
-			case 'b':
-				inputState += ch;
-				break;
-			default:
-				if (inputState == "n") num += ch;
-				else
-				{
-					if (inputState == "xa")
-					{
-						button[1] = stoi(num);
-
-						//TERM ����, x, y, theta�� ����� l1, l2 + l3, 0�� �ǵ��� ����
-						//if (cnt == TERM - 1) diffMean(l1, l2 + l3, 0);
-
-						cnt = (cnt + 1) % TERM;
-						theta_converter(dx1, dy1, dx2, dy2, button[0], button[1], cnt);
-						//std::cout << " " << dx1 << " " << dx2 << " " << dy1 << " " << dy2 << " " << button[0] << " " << button[1] << std::endl;
-
-						x1 = l1 * cos(degree_to_rad(degree1));
-						y1 = l1 * sin(degree_to_rad(degree1));
-						x2 = x1 + l2 * cos(degree_to_rad(degree1 + degree2));
-						y2 = y1 + l2 * sin(degree_to_rad(degree1 + degree2));
-
-						_3dof_inversekinematics(move[cnt][0], move[cnt][1], -theta[cnt] + 90);
-						file_out(mouseOutFile, move[cnt][0], move[cnt][1], x1, y1, x2, y2, theta[cnt], degree1, degree2, degree3);
-						/*std::cout << "x1: " << std::setw(5) << x1
-							<< ", y1: " << std::setw(5) << y1
-							<< ", x2: " << std::setw(5) << x2
-							<< ", y2: " << std::setw(5) << y2
-							<< ", x: " << std::setw(5) << move[cnt][0]
-							<< ", y: " << std::setw(5) << move[cnt][1]
-							<< ", th: " << std::setw(5) << theta[cnt]
-							<< ", th1: " << std::setw(5) << degree1
-							<< ",  th2: " << std::setw(5) << degree2
-							<< ", th3: " << std::setw(5) << degree3 << std::endl;*/
-
-							/*		std::cout << "dx1: " << std::setw(3) << dx1
-										<< ", dx2: " << std::setw(3) << dx2
-										<< ", dy1: " << std::setw(3) << dy1
-										<< ", dy3: " << std::setw(3) << dy2
-										<< ", th: " << std::setw(5) << theta[cnt] << std::endl;*/
-
-
-
-										//send packet
-						sprintf_s(Buffer, "%lf %lf %lf %lf %lf %lf %lf %lf %lf %lf \n", x1, y1, x2, y2, move[cnt][0], move[cnt][1], degree1, degree2, degree3, theta[cnt]);
-						Send_Size = sendto(ClientSocket, Buffer, BUFFER_SIZE, 0,
-							(struct sockaddr*)&ToServer, sizeof(ToServer));
-
-						// ��Ŷ�۽Ž� ����ó��
-						if (Send_Size != BUFFER_SIZE)
-						{
-							std::cout << "sendto() error!" << std::endl;
-							exit(0);
-						}
-
-					}
-					else if (inputState == "xb") dx1 = stoi(num);
-					else if (inputState == "ya") dx2 = -stoi(num);
-					else if (inputState == "yb") dy1 = -stoi(num);
-					else if (inputState == "ca") dy2 = -stoi(num);
-					else if (inputState == "cb") button[0] = stoi(num);
-
-					inputState = "n";
-					num = ch;
-				}
+				predictionStats.Expect(targetNs, sent, pose);
+				ArmSolution<double> ahead = solve_arm(ARM, sent.x, sent.y, degree_to_rad(-sent.theta + 90));
+				arm = { ahead.x1, ahead.y1, ahead.x2, ahead.y2 };
+				q = { rad_to_degree(ahead.q1), rad_to_degree(ahead.q2), rad_to_degree(ahead.q3) };
+				predicted = true;
 			}
+		}
 
-			/*std::cout << inputState;
-			char temp;
-			std::cin.get(temp);
-			std::cout << temp << std::endl;*/
+		PosePacket packet;
+		packet.flags = (uint16_t)((hasDeviceTime ? POSE_FLAG_DEVICE_TIME : 0) | (predicted ? POSE_FLAG_PREDICTED : 0));
+		packet.seq = 0;
+		packet.deviceMicros = hasDeviceTime ? deviceMicros : 0;
+		packet.hostNs = sent.timeNs;
+		packet.x1 = arm.x1; packet.y1 = arm.y1; packet.x2 = arm.x2; packet.y2 = arm.y2;
+		packet.x = sent.x; packet.y = sent.y;
+		packet.degree1 = q.degree1; packet.degree2 = q.degree2; packet.degree3 = q.degree3;
+		packet.theta = sent.theta;
+		//replayed stamps are in the capture's timebase, move them to the read
+		//(live the source stamps with the session clock and this changes nothing)
+		publisher.Post(packet, sampleNs + readNs - hostNs, readNs);
+		shmWriter.Publish(packet);
+	};
+
+	//one report from either protocol
+	auto on_record = [&](const MouseRecord& record)
+	{
+		if (record.clutch)
+		{
+			std::cout << "end of clutching" << std::endl;
+			odometry.Reset(ARM.l1, ARM.l2 + ARM.l3);
+			armSolver.Reset();
+			//the pose jumps back to the start, don't fit or score across it
+			poseHistory.MarkDiscontinuity();
+			predictionStats.Discontinuity();
+			return;
+		}
 
-			//If right-clicked, break the loop
-			if (button[1] == 1)
-			{
-				std::cout << "right clicked, break the loop" << std::endl;
-				break;
-			}
+		//device stamps mapped to host time, or the arrival time for firmware without them
+		long long arrivalNs = source->ArrivalNs();
+		hostNs = arrivalNs;
+		if (record.hasDeviceTime)
+		{
+			clockSync.Add(record.deviceMicros, arrivalNs);
+			sampleNs = clockSync.ToHost(record.deviceMicros);
+		}
+		else
+			sampleNs = arrivalNs;
+		hasDeviceTime = record.hasDeviceTime;
+		deviceMicros = record.deviceMicros;
+
+		dx1 = record.dx1;
+		dx2 = record.dx2;
+		dy1 = record.dy1;
+		dy2 = record.dy2;
+		button[0] = record.button[0];
+		button[1] = record.button[1];
+		process_sample();
+	};
+
+	WaitStrategy waiter(WAIT_MODE);
+	WaitStats waitStats;
+
+	while (source->IsOpen() && c != 3)
+	{
+		readResult = source->Read(incomingData, sizeof(incomingData));
+		if (MEASURE_WAIT)
+			waitStats.Record(readResult);
+
+		if (readResult <= 0)
+		{
+			waiter.Idle(*source);
+			continue;
+		}
+		waiter.Reset();
+		readNs = session_ns();
+		capture.Write(incomingData, readResult, source->ArrivalNs());
+
+		if (BINARY_PROTOCOL)
+		{
+			MousePacket packet;
+			for (int i = 0; i < readResult; i++)
+				if (decoder.Push(static_cast<uint8_t>(incomingData[i]), packet))
+					on_record(mouse_record_from_packet(packet));
+		}
+		else
+			parser.Feed(incomingData, readResult, on_record);
+
+		//If right-clicked, break the loop
+		if (button[1] == 1)
+		{
+			std::cout << "right clicked, break the loop" << std::endl;
+			break;
 		}
 	}
 
+	//last pose out before END
+	publisher.Stop();
+	shmWriter.Close();
+	mouseLog.Stop();
+
+	//the Myo and Motive threads stop their loggers and trim their files;
+	//a Hub::run or TT_Update rarely takes more than a few frames
+	if (live && !session_stop().StopAndWait(5000))
+		std::cout << "Myo / Motive log not closed in time, its rows may be cut short" << std::endl;
+
 	//���α׷� ���� �� "END"�� ��� ��Ŷ�� ����
 	sprintf_s(Buffer, "END ");
-	Send_Size = sendto(ClientSocket, Buffer, BUFFER_SIZE, 0,
+	Send_Size = sendto(ClientSocket, Buffer, (int)strlen(Buffer), 0,
 		(struct sockaddr*)&ToServer, sizeof(ToServer));
 
+	if (MEASURE_WAIT)
+		waitStats.Report(stdout, WAIT_MODE, linkBaud);
+	if (SP != nullptr && SP->DroppedBytes() > 0)
+		std::cout << "serial ring overflow, dropped " << SP->DroppedBytes() << " bytes" << std::endl;
+	if (BINARY_PROTOCOL)
+		std::cout << "binary frames: " << decoder.CrcErrors() << " CRC errors, " << decoder.LostFrames() << " lost" << std::endl;
+	if (clockSync.Ready())
+		std::cout << "device clock drift " << clockSync.DriftPpm() << " ppm, sync residual " << clockSync.ResidualNs() / 1e3 << " us" << std::endl;
+	if (PREDICT_DISPLAY_NS > 0)
+		predictionStats.Report(stdout);
+	std::cout << "published " << publisher.Sent() << " of " << publisher.Posted() << " poses, "
+		<< publisher.Coalesced() << " coalesced, " << publisher.Dropped() << " dropped" << std::endl;
+	if (publisher.SampleLatency().Count() > 0)
+	{
+		//what PREDICT_DISPLAY_NS has to cover, plus the render time of visual.py
+		std::cout << "pose latency, sent " << PREDICT_DISPLAY_NS / 1e6 << " ms ahead of arrival:" << std::endl;
+		publisher.SampleLatency().Report(stdout, "sensor read to sendto");
+		publisher.HostLatency().Report(stdout, "report arrival to sendto");
+	}
+	if (mouseLog.Dropped() > 0 || mouseLog.Failed())
+		std::cout << "mouse log: " << mouseLog.Records() << " rows written, " << mouseLog.Dropped() << " dropped"
+			<< (mouseLog.Failed() ? ", write error" : "") << std::endl;
+	if (DIFFERENTIAL_IK)
+		std::cout << "IK: " << armSolver.IncrementalSolves() << " incremental, " << armSolver.ClosedFormSolves() << " closed form" << std::endl;
+	if (capture.IsOpen())
+		std::cout << "captured " << capture.Chunks() << " chunks to " << capturePath << std::endl;
+	capture.Close();
+	delete source;
+	delete SP;
+
 	closesocket(ClientSocket); //���� �ݱ�
 	WSACleanup();
 
 	
-	if (mouseOutFile) mouseOutFile.close();
+	//closes the file, MmapSink trims it to what was written
+	mouseFile.reset();
 
 	std::cout << "program is terminating" << std::endl;
 	return 0;
 }
 
 
-double degree_to_rad(double degree)
-{
-	return degree * PI / 180;
-}
-
-double rad_to_degree(double rad)
-{
-	return (rad * 180 / PI);
-}
-
-void theta_converter(int dx1, int dy1, int dx2, int dy2, int buttonState1, int buttonState2, int index) {
-	int previousIndex = index == 0 ? TERM - 1 : index - 1;
-	double delta_theta = (static_cast<double>(dx1) + static_cast<double>(dx2)) * R;
-	theta[index] = theta[previousIndex] + (delta_theta / 2.0);
-
-	//std::cout << degree_to_rad(delta_theta) / (2.0 * sin(degree_to_rad(delta_theta / 2.0))) << std::endl;
-	double th = degree_to_rad(theta[index]);
-	double d_th = degree_to_rad(delta_theta);
-
-	dmove[index][0] = (cos(th) * dx1 + sin(th) * dy1) / CPI;
-	dmove[index][1] = (-1 * sin(th) * dx1 + cos(th) * dy1) / CPI;
-	for (int i = 0; i < 2; i++)
-		move[index][i] = move[previousIndex][i] + (d_th == 0 ? 1 : (d_th / (2.0 * sin(d_th / 2.0)))) * dmove[index][i];
-
-	theta[index] = theta[index] + delta_theta / 2.0;
-}
-
-void _2dof_inversekinematics(double x, double y)
-{
-	double k = ((pow(x, 2) + pow(y, 2) - pow(l1, 2) - pow(l2, 2)) / (2 * l1 * l2));
-	double a2 = (atan2(sqrt(1 - pow(k, 2)), k));
-	double a1 = atan2(y, x) - atan2(l2 * sin(a2), l1 + l2 * cos(a2));
-
-	a1 *= 180 / PI;//radian to degree
-	a2 *= 180 / PI;//radian to degree
-	degree1 = a1;
-	degree2 = a2;
-}
-
-void _3dof_inversekinematics(double x, double y, double degree)
-{
-	_2dof_inversekinematics(x - l3 * cos(degree_to_rad(degree)), y - l3 * sin(degree_to_rad(degree)));
-	//std::cout << x - l3 * cos(degree_to_rad(degree)) << " " << y - l3 * sin(degree_to_rad(degree)) << std::endl;
-	degree3 = degree - (degree1 + degree2);
-}
-
-void diffMean(double centerX, double centerY, double centerTheta)
-{
-	int half = TERM / 2;
-
-	double sumX = 0, sumY = 0, sumTh = 0;
-	for (int i = half; i < TERM; i++)
-	{
-		sumX += move[i][0];
-		sumY += move[i][1];
-		sumTh += theta[i];
-	}
-
-	move[TERM - 1][0] -= sumX / half - centerX;
-	move[TERM - 1][1] -= sumY / half - centerY;
-	theta[TERM - 1] -= sumTh / half - centerTheta;
-}
-
-void reset(int cnt)
-{
-	move[cnt][0] = l1;
-	move[cnt][1] = l2 + l3;
-	theta[cnt] = 0;
-}
-
-void file_out(std::ofstream& file, int x, int y, int x1, int y1, int x2, int y2, double theta, double degree1, double degree2, double degree3) {
-	//time_t timer;
-	//struct tm* t;
-	//timer = time(NULL); // 1970�� 1�� 1�� 0�� 0�� 0�ʺ��� �����Ͽ� ��������� ��
-	//t = localtime(&timer); // �������� ���� ����ü�� �ֱ�
-
-
-	//std::string time_str(to_string(t->tm_hour) + ":" + to_string(t->tm_min) + ":" + to_string(t->tm_sec));
-	std::string time_str = to_string(elapsed());
-
-	if (!file.is_open()) {
-		std::cout << "failed to open " << '\n';
-	}
-	else {
-		file << time_str << "," << to_string(x) << "," << to_string(y) << "," << to_string(x1) << "," << to_string(y1) << "," << to_string(x2) << "," << to_string(y2) << "," << to_string(theta) << "," << to_string(degree1) << "," << to_string(degree2) << "," << to_string(degree3) << std::endl;
-	}
-	//std::cout << "end!" << std::endl;
-}
-
 void  INThandler(int sig)
 {
 	char  j;
@@ -4,9 +4,13 @@
 
 #define ADVANCE_MODE
 
+//Uncomment this line to send fixed-size binary frames (mouse_packet.h) instead of ASCII
+//#define BINARY_PROTOCOL
+
 #include <SPI.h>
 #include <avr/pgmspace.h>
 #include <PMW3360.h>
+#include "mouse_packet.h"
 
 #ifdef ADVANCE_MODE
 #include <AdvMouse.h>
@@ -22,7 +26,9 @@
 #endif
 
 // User define values
+#define FIRMWARE_VERSION 4  // reported in the hello line
 #define DEFAULT_CPI  1200
+#define SERIAL_BAUD  9600   // rate after reset, the host can switch it with 'B'
 #define SENSOR_DISTANCE 72  // in mm
 
 #define SS1  9          // Slave Select pin. Connect this to SS on the module. (Front sensor)
@@ -53,9 +59,12 @@ bool reportSQ = false;  // report surface quality
 
 float sensor_dist_inch = (float)SENSOR_DISTANCE / 25.4;
 int current_cpi = DEFAULT_CPI;
+unsigned long current_baud = SERIAL_BAUD;
+
+uint8_t packet_seq = 0;
 
 void setup() {
-  Serial.begin(9600);
+  Serial.begin(SERIAL_BAUD);
   //while(!Serial);
   //sensor.begin(10, 1600); // to set CPI (Count per Inch), pass it as the second parameter
 
@@ -82,6 +91,8 @@ void setup() {
 
   MOUSE_BEGIN;
   buttons_init();
+
+  send_hello();
 }
 
 
@@ -122,14 +133,22 @@ void loop() {
 
     bool moved = data1.dx != 0 || data1.dy != 0 || data2.dx != 0 || data2.dy != 0;
 
+#ifdef BINARY_PROTOCOL
+    if(data.isOnSurface && !wasOnSurface)
+      send_packet(lastTS, 0, 0, 0, 0, MOUSE_FLAG_CLUTCH);
+    wasOnSurface = data.isOnSurface;
+
+    if(data.isOnSurface && moved)
+      send_packet(lastTS, data1.dx, data2.dx, data1.dy, data2.dy, 0);
+#else
     if(data.isOnSurface && !wasOnSurface)
       Serial.print("f");
     wasOnSurface = data.isOnSurface;
     
     if(data.isOnSurface && moved)
     {
-      //Serial.print(micros());
-      //Serial.print(' ');
+      Serial.print('t');        // when the sensors were read, for the host's clock sync
+      Serial.print(lastTS);
       Serial.print("xa");
       Serial.print(data1.dx);
       Serial.print("xb");
@@ -143,6 +162,7 @@ void loop() {
       Serial.print("cb");
       Serial.print(btn_state[1]);
     }
+#endif
     
 
 #ifdef ADVANCE_MODE
@@ -200,6 +220,16 @@ void loop() {
       posRatio = constrain(newPos, 0, 100);
       Serial.println(posRatio);
     }
+    else if (c == 'H')  // host asks whether we are up
+    {
+      send_hello();
+    }
+    else if (c == 'B')  // switch baud rate, e.g. "B1000000\n"
+    {
+      unsigned long newBaud = readNumber();
+      if (newBaud > 0)
+        change_baud(newBaud);
+    }
   }
 }
 
@@ -225,6 +255,69 @@ void translate_virtual_sensor(int s1_dx, int s1_dy, int s2_dx, int s2_dy, float
   vs_pos_y = (float)s2_dy + sin_t*sa_x + cos_t*sa_y - sa_y;  
 }
 
+// Send one binary frame, buttons are taken from the debounced state
+void send_packet(unsigned long sampleMicros, int dx1, int dx2, int dy1, int dy2, uint8_t flags)
+{
+  MousePacket packet;
+  uint8_t frame[MOUSE_PACKET_SIZE];
+
+  packet.seq = packet_seq++;
+  packet.timestamp = sampleMicros;
+  packet.dx1 = dx1;
+  packet.dx2 = dx2;
+  packet.dy1 = dy1;
+  packet.dy2 = dy2;
+  packet.buttons = flags;
+  if (btn_state[0]) packet.buttons |= MOUSE_BTN_LEFT;
+  if (btn_state[1]) packet.buttons |= MOUSE_BTN_RIGHT;
+
+  mouse_packet_encode(packet, frame);
+  Serial.write(frame, MOUSE_PACKET_SIZE);
+}
+
+// Tells the host setup() is done and reports follow, "\nHELLO <version> <protocol>\n".
+// Control lines start with '\n' so the host can tell them from report bytes.
+void send_hello()
+{
+  Serial.print("\nHELLO ");
+  Serial.print(FIRMWARE_VERSION);
+#ifdef BINARY_PROTOCOL
+  Serial.print(" binary\n");
+#else
+  Serial.print(" ascii\n");
+#endif
+}
+
+// Ack at the old rate, switch, then wait for the host to confirm with 'K'
+// at the new rate. Without a confirmation go back to the old rate, so a
+// failed switch never leaves the link dead.
+void change_baud(unsigned long newBaud)
+{
+  unsigned long oldBaud = current_baud;
+
+  Serial.print("\nB");
+  Serial.print(newBaud);
+  Serial.print('\n');
+  Serial.flush();
+
+  Serial.end();
+  Serial.begin(newBaud);
+
+  unsigned long start = millis();
+  while (millis() - start < 1000)
+  {
+    if (Serial.available() > 0 && Serial.read() == 'K')
+    {
+      current_baud = newBaud;
+      Serial.print("\nBOK\n");
+      return;
+    }
+  }
+
+  Serial.end();
+  Serial.begin(oldBaud);
+}
+
 void buttons_init()
 {
   for (int i = 0; i < NUMBTN; i++)
@@ -285,7 +378,7 @@ unsigned long readNumber()
 
     if (inChar == '\n')
     {
-      int val = inString.toInt();
+      long val = inString.toInt();   // int is 16 bit on AVR, too small for baud rates
       return (unsigned long)val;
     }
   }
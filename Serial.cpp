@@ -1,6 +1,128 @@
 #include "SerialClass.h"
 
-Serial::Serial(const char* portName)
+// Platform independent part of Serial. The port itself is opened, read and
+// written below for Windows and in SerialPosix.cpp for Linux.
+
+bool Serial::StartReader(unsigned int ringSize)
+{
+    if (!this->connected)
+        return false;
+    if (this->ring)
+        return true;
+
+    if (!this->BeginBlockingReads())
+        return false;
+
+    this->ring.reset(new SpscRing<char>(ringSize));
+    this->readerRunning = true;
+    this->reader = std::thread(&Serial::ReaderLoop, this);
+    return true;
+}
+
+void Serial::StopReader()
+{
+    if (!this->ring)
+        return;
+
+    this->readerRunning = false;
+    if (this->reader.joinable())
+        this->reader.join();
+    this->ring.reset();
+
+    this->EndBlockingReads();
+}
+
+unsigned long Serial::DroppedBytes()
+{
+    return this->droppedBytes;
+}
+
+void Serial::ReaderLoop()
+{
+    char chunk[4096];
+
+    while (this->readerRunning)
+    {
+        //One blocking read per burst instead of a status query + read per byte
+        int bytesRead = this->ReadBlocking(chunk, sizeof(chunk));
+
+        //If the consumer fell behind, stop reading so the driver buffer and
+        //flow control absorb the burst instead of throwing bytes away
+        size_t pushed = 0;
+        while (bytesRead > 0 && pushed < (size_t)bytesRead)
+        {
+            pushed += this->ring->Push(chunk + pushed, bytesRead - pushed);
+            this->NotifyConsumer();
+            if (pushed < (size_t)bytesRead)
+            {
+                if (!this->readerRunning)
+                {
+                    this->droppedBytes += (unsigned long)(bytesRead - pushed);
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        }
+
+        //The device went away, ReadBlocking cleared connected. Stop here
+        //instead of spinning on failed reads, and wake the consumer so it
+        //sees IsConnected() go false rather than waiting for data forever.
+        if (!this->connected)
+        {
+            this->readerRunning = false;
+            std::lock_guard<std::mutex> lock(this->dataMutex);
+            this->dataReady.notify_one();
+            break;
+        }
+    }
+}
+
+void Serial::NotifyConsumer()
+{
+    //Only pay for the mutex when the consumer is actually asleep
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (this->consumerWaiting)
+    {
+        std::lock_guard<std::mutex> lock(this->dataMutex);
+        this->dataReady.notify_one();
+    }
+}
+
+bool Serial::WaitForData(unsigned int timeoutMs)
+{
+    if (!this->ring)
+        return this->WaitReadable(timeoutMs);
+
+    if (this->ring->Size() > 0)
+        return true;
+
+    std::unique_lock<std::mutex> lock(this->dataMutex);
+    this->consumerWaiting = true;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    this->dataReady.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+        [this] { return this->ring->Size() > 0 || !this->readerRunning; });
+    this->consumerWaiting = false;
+
+    return this->ring->Size() > 0;
+}
+
+bool Serial::IsConnected()
+{
+    //Simply return the connection status
+    return this->connected;
+}
+
+#ifdef _WIN32
+
+//ReadFile errors after which the port won't deliver anything again: the
+//USB device was unplugged or the driver tore the handle down
+static bool IsDeviceGone(DWORD error)
+{
+    return error == ERROR_ACCESS_DENIED || error == ERROR_BAD_COMMAND || error == ERROR_OPERATION_ABORTED;
+}
+
+Serial::Serial(const char* portName, unsigned long baudRate)
+    : readerRunning(false), droppedBytes(0), consumerWaiting(false)
 {
     //We're not yet connected
     this->connected = false;
@@ -43,7 +165,7 @@ Serial::Serial(const char* portName)
         else
         {
             //Define serial connection parameters for the arduino board
-            dcbSerialParams.BaudRate = CBR_9600;
+            dcbSerialParams.BaudRate = baudRate;
             dcbSerialParams.ByteSize = 8;
             dcbSerialParams.StopBits = ONESTOPBIT;
             dcbSerialParams.Parity = NOPARITY;
@@ -62,8 +184,8 @@ Serial::Serial(const char* portName)
                 this->connected = true;
                 //Flush any remaining characters in the buffers 
                 PurgeComm(this->hSerial, PURGE_RXCLEAR | PURGE_TXCLEAR);
-                //We wait 2s as the arduino board will be reseting
-                Sleep(ARDUINO_WAIT_TIME);
+                //The board resets now, wait_for_hello (mouse_link.h) tells
+                //when it is ready instead of a fixed sleep
             }
         }
     }
@@ -72,13 +194,16 @@ Serial::Serial(const char* portName)
 
 Serial::~Serial()
 {
-    //Check if we are connected before trying to disconnect
-    if (this->connected)
+    this->StopReader();
+
+    //We're no longer connected
+    this->connected = false;
+    //Close the serial handler if it was opened: connected goes false when
+    //the device is unplugged or the comm setup failed, the handle is still ours
+    if (this->hSerial != INVALID_HANDLE_VALUE)
     {
-        //We're no longer connected
-        this->connected = false;
-        //Close the serial handler
         CloseHandle(this->hSerial);
+        this->hSerial = INVALID_HANDLE_VALUE;
     }
 }
 
@@ -89,6 +214,12 @@ int Serial::ReadData(char* buffer, unsigned int nbChar)
     //Number of bytes we'll really ask to read
     unsigned int toRead;
 
+    //The reader thread owns the port, just drain what it collected
+    if (this->ring)
+    {
+        return (int)this->ring->Pop(buffer, nbChar);
+    }
+
     //Use the ClearCommError function to get status info on the Serial port
     ClearCommError(this->hSerial, &this->errors, &this->status);
 
@@ -115,6 +246,8 @@ int Serial::ReadData(char* buffer, unsigned int nbChar)
             return bytesRead;
         }
 
+        if (IsDeviceGone(GetLastError()))
+            this->connected = false;
     }
 
     //If nothing has been read, or that an error was detected return 0
@@ -139,8 +272,86 @@ bool Serial::WriteData(const char* buffer, unsigned int nbChar)
         return true;
 }
 
-bool Serial::IsConnected()
+bool Serial::SetBaudRate(unsigned long baudRate)
 {
-    //Simply return the connection status
-    return this->connected;
-}
\ No newline at end of file
+    DCB dcbSerialParams = { 0 };
+
+    if (!GetCommState(this->hSerial, &dcbSerialParams))
+        return false;
+
+    dcbSerialParams.BaudRate = baudRate;
+    return SetCommState(this->hSerial, &dcbSerialParams) != 0;
+}
+
+unsigned long Serial::GetBaudRate()
+{
+    DCB dcbSerialParams = { 0 };
+
+    if (!GetCommState(this->hSerial, &dcbSerialParams))
+        return 0;
+    return dcbSerialParams.BaudRate;
+}
+
+bool Serial::BeginBlockingReads()
+{
+    //ReadFile returns as soon as at least one byte arrived, or after 50ms
+    //so the thread can notice StopReader()
+    COMMTIMEOUTS timeouts = { 0 };
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = 50;
+    if (!SetCommTimeouts(this->hSerial, &timeouts))
+    {
+        printf("ALERT: Could not set Serial Port timeouts");
+        return false;
+    }
+    return true;
+}
+
+int Serial::ReadBlocking(char* buffer, unsigned int nbChar)
+{
+    DWORD bytesRead;
+
+    //Note: the handle is not overlapped, so a WriteData call waits for this
+    //read to return (at most the 50ms timeout).
+    if (!ReadFile(this->hSerial, buffer, nbChar, &bytesRead, NULL))
+    {
+        //ReaderLoop stops on a hard error, anything else is a line error
+        //ClearCommError resets
+        if (IsDeviceGone(GetLastError()))
+            this->connected = false;
+        else
+            ClearCommError(this->hSerial, &this->errors, NULL);
+        return 0;
+    }
+    return (int)bytesRead;
+}
+
+void Serial::EndBlockingReads()
+{
+    //Back to the non-blocking reads ReadData expects
+    COMMTIMEOUTS timeouts = { 0 };
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    SetCommTimeouts(this->hSerial, &timeouts);
+}
+
+bool Serial::WaitReadable(unsigned int timeoutMs)
+{
+    //The handle is not overlapped, so WaitCommEvent can't time out. Poll
+    //the input queue instead; Sleep(1) sleeps for a scheduler tick, 1ms
+    //while something holds timeBeginPeriod(1), up to 15.6ms otherwise.
+    //Use the reader thread (StartReader) for a wakeup on every byte.
+    const ULONGLONG deadline = GetTickCount64() + timeoutMs;
+    for (;;)
+    {
+        if (!ClearCommError(this->hSerial, &this->errors, &this->status))
+            return false;
+        if (this->status.cbInQue > 0)
+            return true;
+        if (GetTickCount64() >= deadline)
+            return false;
+        Sleep(1);
+    }
+}
+
+#endif // _WIN32
@@ -1,27 +1,61 @@
 #ifndef SERIALCLASS_H_INCLUDED
 #define SERIALCLASS_H_INCLUDED
 
-#define ARDUINO_WAIT_TIME 2000
-
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "spsc_ring.h"
 
 class Serial
 {
 private:
+#ifdef _WIN32
     //Serial comm handler
     HANDLE hSerial;
-    //Connection status
-    bool connected;
     //Get various information about the connection
     COMSTAT status;
     //Keep track of last error
     DWORD errors;
+#else
+    //File descriptor of the tty (SerialPosix.cpp)
+    int fd;
+#endif
+    //Connection status
+    std::atomic<bool> connected;
+
+    //Background reader, see StartReader()
+    std::thread reader;
+    std::atomic<bool> readerRunning;
+    std::unique_ptr<SpscRing<char> > ring;
+    //Bytes still waiting for ring space when the reader was stopped
+    std::atomic<unsigned long> droppedBytes;
+    //Lets WaitForData sleep until the reader thread pushed something
+    std::mutex dataMutex;
+    std::condition_variable dataReady;
+    std::atomic<bool> consumerWaiting;
+
+    void ReaderLoop();
+    void NotifyConsumer();
+    //Platform hooks for the reader thread: switch the port to reads that
+    //block up to 50ms, read one burst, and switch back
+    bool BeginBlockingReads();
+    int ReadBlocking(char* buffer, unsigned int nbChar);
+    void EndBlockingReads();
+    //Platform wait used by WaitForData when there is no reader thread
+    bool WaitReadable(unsigned int timeoutMs);
 
 public:
-    //Initialize Serial communication with the given COM port
-    Serial(const char* portName);
+    //Initialize Serial communication with the given port, "\\\\.\\COM5" on
+    //Windows or "/dev/ttyACM0" on Linux, 8N1 at baudRate
+    Serial(const char* portName, unsigned long baudRate = 9600);
     //Close the connection
     ~Serial();
     //Read data in a buffer, if nbChar is greater than the
@@ -32,6 +66,22 @@ public:
     //Writes data from a buffer through the Serial connection
     //return true on success.
     bool WriteData(const char* buffer, unsigned int nbChar);
+    //Start a thread that reads everything the port delivers into a ring of
+    //ringSize bytes. ReadData then only copies out of the ring, so reading in
+    //large chunks costs no syscall at all. Returns false if not connected.
+    bool StartReader(unsigned int ringSize = 1 << 16);
+    //Stop the reader thread, ReadData goes back to reading the port directly
+    void StopReader();
+    unsigned long DroppedBytes();
+    //Sleep until ReadData has something to return or timeoutMs passed.
+    //Returns true if data is ready. With the reader thread this waits on a
+    //condition variable, otherwise in poll() (Linux) or WaitCommEvent (Windows).
+    bool WaitForData(unsigned int timeoutMs);
+    //Change the port speed of an open connection, the firmware has to be told
+    //first (see negotiate_baud in mouse_link.h). Returns true on success.
+    bool SetBaudRate(unsigned long baudRate);
+    //Current port speed, 0 if it can't be read
+    unsigned long GetBaudRate();
     //Check if we are actually connected
     bool IsConnected();
 
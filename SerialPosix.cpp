@@ -0,0 +1,258 @@
+// Linux / POSIX backend of the Serial class, see Serial.cpp for the Windows one.
+#ifndef _WIN32
+
+#include "SerialClass.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+//termios2 for arbitrary baud rates, <termios.h> can't be included next to it
+#include <asm/termbits.h>
+#include <linux/serial.h>
+#else
+#include <termios.h>
+#endif
+
+#ifdef __linux__
+static bool ConfigurePort(int fd, unsigned long baudRate)
+{
+    struct termios2 tio;
+
+    if (ioctl(fd, TCGETS2, &tio) != 0)
+        return false;
+
+    //Raw mode, same flags as cfmakeraw()
+    tio.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON | IXOFF | IXANY);
+    tio.c_oflag &= ~OPOST;
+    tio.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    tio.c_cflag &= ~(CSIZE | PARENB | CSTOPB | CRTSCTS);
+    tio.c_cflag |= CS8 | CREAD | CLOCAL;
+
+    //BOTHER takes the rate as a number, so 250000 or 1000000 work as well as 9600
+    tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    tio.c_ispeed = baudRate;
+    tio.c_ospeed = baudRate;
+
+    //read() returns whatever is already there without waiting,
+    //waiting for data is done with poll() so it can time out
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+
+    if (ioctl(fd, TCSETS2, &tio) != 0)
+        return false;
+
+    //USB serial adapters (ftdi_sio) batch bytes for 16ms unless asked not to.
+    //Not every driver supports this (ptys don't), so failures are ignored.
+    struct serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial) == 0)
+    {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        ioctl(fd, TIOCSSERIAL, &serial);
+    }
+
+    ioctl(fd, TCFLSH, TCIOFLUSH);
+    return true;
+}
+
+static bool SetPortSpeed(int fd, unsigned long baudRate)
+{
+    struct termios2 tio;
+
+    if (ioctl(fd, TCGETS2, &tio) != 0)
+        return false;
+
+    tio.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+    tio.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+    tio.c_ispeed = baudRate;
+    tio.c_ospeed = baudRate;
+
+    //TCSETSW2 lets pending output leave at the old rate first
+    return ioctl(fd, TCSETSW2, &tio) == 0;
+}
+
+static unsigned long GetPortSpeed(int fd)
+{
+    struct termios2 tio;
+
+    if (ioctl(fd, TCGETS2, &tio) != 0)
+        return 0;
+    return tio.c_ospeed;
+}
+#else
+static bool ConfigurePort(int fd, unsigned long baudRate)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) != 0)
+        return false;
+
+    cfmakeraw(&tio);
+    tio.c_cflag |= CREAD | CLOCAL;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    //BSD and macOS take the rate as a plain number
+    if (cfsetspeed(&tio, (speed_t)baudRate) != 0)
+        return false;
+
+    if (tcsetattr(fd, TCSANOW, &tio) != 0)
+        return false;
+
+    tcflush(fd, TCIOFLUSH);
+    return true;
+}
+
+static bool SetPortSpeed(int fd, unsigned long baudRate)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) != 0 || cfsetspeed(&tio, (speed_t)baudRate) != 0)
+        return false;
+    return tcsetattr(fd, TCSADRAIN, &tio) == 0;
+}
+
+static unsigned long GetPortSpeed(int fd)
+{
+    struct termios tio;
+
+    if (tcgetattr(fd, &tio) != 0)
+        return 0;
+    return (unsigned long)cfgetospeed(&tio);
+}
+#endif
+
+Serial::Serial(const char* portName, unsigned long baudRate)
+    : readerRunning(false), droppedBytes(0), consumerWaiting(false)
+{
+    //We're not yet connected
+    this->connected = false;
+
+    this->fd = open(portName, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (this->fd < 0)
+    {
+        if (errno == ENOENT)
+            printf("ERROR: Handle was not attached. Reason: %s not available.\n", portName);
+        else
+            printf("ERROR: could not open %s (errno %d)\n", portName, errno);
+        return;
+    }
+
+    //O_NONBLOCK was only needed so open() doesn't wait for carrier detect,
+    //reads are non-blocking through VMIN = VTIME = 0 and writes should block
+    fcntl(this->fd, F_SETFL, fcntl(this->fd, F_GETFL) & ~O_NONBLOCK);
+
+    if (!ConfigurePort(this->fd, baudRate))
+    {
+        printf("ALERT: Could not set Serial Port parameters");
+        close(this->fd);
+        this->fd = -1;
+        return;
+    }
+
+    //If everything went fine we're connected
+    this->connected = true;
+    //The board resets now, wait_for_hello (mouse_link.h) tells
+    //when it is ready instead of a fixed sleep
+}
+
+Serial::~Serial()
+{
+    this->StopReader();
+
+    if (this->fd >= 0)
+    {
+        this->connected = false;
+        close(this->fd);
+    }
+}
+
+int Serial::ReadData(char* buffer, unsigned int nbChar)
+{
+    //The reader thread owns the port, just drain what it collected
+    if (this->ring)
+    {
+        return (int)this->ring->Pop(buffer, nbChar);
+    }
+
+    ssize_t bytesRead = read(this->fd, buffer, nbChar);
+    if (bytesRead > 0)
+        return (int)bytesRead;
+
+    //The device went away (USB unplugged or the pty master closed)
+    if (bytesRead < 0 && errno != EAGAIN && errno != EINTR)
+        this->connected = false;
+    return 0;
+}
+
+bool Serial::WriteData(const char* buffer, unsigned int nbChar)
+{
+    while (nbChar > 0)
+    {
+        ssize_t written = write(this->fd, buffer, nbChar);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        buffer += written;
+        nbChar -= (unsigned int)written;
+    }
+    return true;
+}
+
+bool Serial::SetBaudRate(unsigned long baudRate)
+{
+    return SetPortSpeed(this->fd, baudRate);
+}
+
+unsigned long Serial::GetBaudRate()
+{
+    return GetPortSpeed(this->fd);
+}
+
+bool Serial::BeginBlockingReads()
+{
+    //Nothing to change, ReadBlocking waits in poll()
+    return true;
+}
+
+int Serial::ReadBlocking(char* buffer, unsigned int nbChar)
+{
+    struct pollfd pfd;
+    pfd.fd = this->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    //Wake up at least every 50ms so the thread can notice StopReader()
+    if (poll(&pfd, 1, 50) <= 0)
+        return 0;
+
+    ssize_t bytesRead = read(this->fd, buffer, nbChar);
+    if (bytesRead > 0)
+        return (int)bytesRead;
+
+    //Hung up and nothing left to read, ReaderLoop stops on this
+    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+        this->connected = false;
+    return 0;
+}
+
+void Serial::EndBlockingReads()
+{
+}
+
+bool Serial::WaitReadable(unsigned int timeoutMs)
+{
+    struct pollfd pfd;
+    pfd.fd = this->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    return poll(&pfd, 1, (int)timeoutMs) > 0 && (pfd.revents & POLLIN);
+}
+
+#endif // !_WIN32
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "log_sink.h"
+#include "record_encoder.h"
+#include "spsc_ring.h"
+
+// Logging off the tracking loop. The loop pushes fixed size Records into an
+// SpscRing, which is a copy and two atomic stores, and carries on; a
+// background thread runs them through a RecordEncoder (CSV text, a
+// stream_log.h file), which hands the LogSink large pieces, and flushes
+// every flushIntervalMs. A stall of the disk only fills the ring (16384
+// records by default, seconds of samples); when it is full a record is
+// dropped and counted, the loop never waits.
+//
+// Record has to be trivially copyable.
+template <typename Record>
+class AsyncLogger
+{
+public:
+    AsyncLogger(LogSink& sink, RecordEncoder<Record>& encoder, long long flushIntervalMs = 1000,
+        size_t ringRecords = 1 << 14)
+        : sink(sink), encoder(encoder), flushIntervalMs(flushIntervalMs),
+        ring(ringRecords), batch(256), running(false), dropped(0), records(0), failed(false)
+    {
+    }
+
+    ~AsyncLogger() { Stop(); }
+
+    void Start()
+    {
+        if (running)
+            return;
+        running = true;
+        thread = std::thread(&AsyncLogger::Run, this);
+    }
+
+    //Writes and flushes everything pushed before the call
+    void Stop()
+    {
+        if (!running)
+            return;
+        running = false;
+        if (thread.joinable())
+            thread.join();
+    }
+
+    //Tracking loop side, never blocks; false if the ring was full
+    bool Push(const Record& record)
+    {
+        if (ring.Push(&record, 1) == 1)
+            return true;
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint64_t Dropped() const { return dropped.load(std::memory_order_relaxed); }
+    uint64_t Records() const { return records.load(std::memory_order_relaxed); }
+    //A write or flush failed, the log is missing data from then on
+    bool Failed() const { return failed.load(std::memory_order_relaxed); }
+
+private:
+    void Run()
+    {
+        typedef std::chrono::steady_clock clock;
+        const std::chrono::milliseconds interval(flushIntervalMs);
+        clock::time_point lastFlush = clock::now();
+
+        while (running)
+        {
+            bool idle = !Drain();
+            clock::time_point now = clock::now();
+            if (now - lastFlush >= interval)
+            {
+                Flush();
+                lastFlush = now;
+            }
+            //nothing to do: sleep instead of waking per record, the ring has room
+            if (idle)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        Drain();
+        Flush();
+    }
+
+    //Encode whatever is in the ring, false if it was empty
+    bool Drain()
+    {
+        bool any = false;
+        for (;;)
+        {
+            size_t n = ring.Pop(batch.data(), batch.size());
+            if (n == 0)
+                return any;
+            any = true;
+            for (size_t i = 0; i < n; i++)
+                if (!encoder.Add(batch[i], sink))
+                    failed = true;
+            records.store(records.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        }
+    }
+
+    void Flush()
+    {
+        if (!encoder.Finish(sink) || !sink.Flush())
+            failed = true;
+    }
+
+    LogSink& sink;
+    //only touched by the background thread
+    RecordEncoder<Record>& encoder;
+    long long flushIntervalMs;
+
+    SpscRing<Record> ring;
+    std::vector<Record> batch;
+
+    std::thread thread;
+    std::atomic<bool> running;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> records;
+    std::atomic<bool> failed;
+};
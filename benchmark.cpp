@@ -0,0 +1,737 @@
+// Benchmarks of everything the trackers do per sample: parsing the mouse
+// stream, dead reckoning, IK/FK, the pose history, publishing the pose (UDP
+// datagram, shared memory) and the three loggers, as CSV and as stream logs, with the file and mmap log
+// sinks, the integer column codec and the session clock. Prints ns/op, throughput and heap allocations per op,
+// and compares against a baseline written earlier by --write-baseline.
+//
+//   g++ -O2 -std=c++17 benchmark.cpp record_format.cpp odometry_batch.cpp fixed_odometry.cpp
+//       pose_predictor.cpp byte_source.cpp pose_shm_channel.cpp stream_log.cpp log_sink.cpp
+//       delta_codec.cpp simd_level.cpp session_clock.cpp -o benchmark
+//
+//   benchmark [--filter text] [--min-time ms] [--baseline file] [--write-baseline file]
+//             [--tolerance fraction] [--scratch file]
+//
+// Every benchmark is run 5 times for at least --min-time (default 100ms),
+// the fastest run counts. With --baseline the exit code is 1 when any
+// benchmark got slower than tolerance (default 0.25) or allocates more.
+// The loggers write to a real file (--scratch, default benchmark.tmp, removed
+// at the end) since their flushes are a good part of what they cost.
+// bench_baseline.json was written on a Linux x86-64 desktop, numbers from
+// another machine only compare against a baseline written on that machine.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "byte_source.h"
+#include "delta_codec.h"
+#include "fixed_odometry.h"
+#include "kinematics.hpp"
+#include "latest_mailbox.h"
+#include "mouse_packet.h"
+#include "mouse_parser.h"
+#include "odometry_batch.h"
+#include "pose_history.h"
+#include "pose_packet.h"
+#include "pose_predictor.h"
+#include "pose_shm_channel.h"
+#include "record_format.h"
+#include "session_clock.h"
+#include "tracker_config.h"
+
+//Every heap allocation of the process goes through here
+static unsigned long long allocations = 0;
+
+void* operator new(size_t size)
+{
+    allocations++;
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+
+//Results land here so the compiler can't drop the work
+static volatile double sink;
+
+//LogSink onto the scratch file
+struct StreamSink : LogSink
+{
+    std::ostream& out;
+    explicit StreamSink(std::ostream& out) : out(out) {}
+    bool Write(const char* data, size_t size) override { out.write(data, (std::streamsize)size); return (bool)out; }
+    bool Flush() override { out.flush(); return (bool)out; }
+};
+
+const int SAMPLES = 4096;
+
+struct Benchmark
+{
+    std::string name;
+    //Run about iterations ops, return how many were done. bytes gets the
+    //bytes parsed or written, if that means anything for the benchmark.
+    std::function<size_t(size_t iterations, unsigned long long& bytes)> body;
+};
+
+struct Result
+{
+    std::string name;
+    double nsPerOp;
+    double bytesPerOp;
+    double allocsPerOp;
+};
+
+static Result measure(const Benchmark& bench, double minSeconds)
+{
+    typedef std::chrono::steady_clock clock;
+    unsigned long long bytes = 0;
+
+    //Grow the batch until one takes a tenth of the minimum time
+    size_t iterations = 1;
+    for (;;)
+    {
+        clock::time_point start = clock::now();
+        size_t done = bench.body(iterations, bytes);
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        if (seconds >= minSeconds / 10 || iterations >= ((size_t)1 << 40))
+        {
+            iterations = (size_t)(done * (minSeconds / (seconds > 0 ? seconds : 1e-9))) + 1;
+            break;
+        }
+        iterations *= 4;
+    }
+
+    Result result;
+    result.name = bench.name;
+    result.nsPerOp = 0;
+    for (int run = 0; run < 5; run++)
+    {
+        bytes = 0;
+        unsigned long long allocationsBefore = allocations;
+        clock::time_point start = clock::now();
+        size_t done = bench.body(iterations, bytes);
+        double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+
+        if (run == 0 || ns / done < result.nsPerOp)
+            result.nsPerOp = ns / done;
+        result.bytesPerOp = (double)bytes / done;
+        result.allocsPerOp = (double)(allocations - allocationsBefore) / done;
+    }
+    return result;
+}
+
+// Baseline file, one object per benchmark:
+//   { "benchmarks": [ { "name": "ik_3dof", "ns_per_op": 41.2, "allocs_per_op": 0 }, ... ] }
+static bool write_baseline(const char* path, const std::vector<Result>& results)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+        return false;
+    fprintf(file, "{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); i++)
+        fprintf(file, "    { \"name\": \"%s\", \"ns_per_op\": %.3f, \"allocs_per_op\": %.3f }%s\n",
+            results[i].name.c_str(), results[i].nsPerOp, results[i].allocsPerOp, i + 1 < results.size() ? "," : "");
+    fprintf(file, "  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+//Only reads what write_baseline writes, not JSON in general
+static bool read_baseline(const char* path, std::vector<Result>& baseline)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    std::stringstream text;
+    text << file.rdbuf();
+    std::string json = text.str();
+
+    size_t pos = 0;
+    while ((pos = json.find("\"name\"", pos)) != std::string::npos)
+    {
+        size_t open = json.find('"', json.find(':', pos) + 1);
+        size_t close = json.find('"', open + 1);
+        size_t ns = json.find("\"ns_per_op\"", close);
+        size_t allocs = json.find("\"allocs_per_op\"", close);
+        if (open == std::string::npos || close == std::string::npos || ns == std::string::npos || allocs == std::string::npos)
+            return false;
+
+        Result entry;
+        entry.name = json.substr(open + 1, close - open - 1);
+        entry.nsPerOp = atof(json.c_str() + json.find(':', ns) + 1);
+        entry.allocsPerOp = atof(json.c_str() + json.find(':', allocs) + 1);
+        entry.bytesPerOp = 0;
+        baseline.push_back(entry);
+        pos = close;
+    }
+    return true;
+}
+
+static std::string generated_stream(bool binary)
+{
+    GeneratorSource source(SAMPLES, binary);
+    std::string stream;
+    char buffer[4096];
+    while (source.IsOpen())
+        stream.append(buffer, source.Read(buffer, sizeof(buffer)));
+    return stream;
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = nullptr;
+    const char* baselinePath = nullptr;
+    const char* writeBaselinePath = nullptr;
+    const char* scratchPath = "benchmark.tmp";
+    double minSeconds = 0.1;
+    double tolerance = 0.25;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (!strcmp(argv[i], "--min-time") && i + 1 < argc)
+            minSeconds = atof(argv[++i]) / 1000;
+        else if (!strcmp(argv[i], "--baseline") && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (!strcmp(argv[i], "--write-baseline") && i + 1 < argc)
+            writeBaselinePath = argv[++i];
+        else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc)
+            tolerance = atof(argv[++i]);
+        else if (!strcmp(argv[i], "--scratch") && i + 1 < argc)
+            scratchPath = argv[++i];
+        else
+        {
+            fprintf(stderr, "usage: %s [--filter text] [--min-time ms] [--baseline file] [--write-baseline file]"
+                " [--tolerance fraction] [--scratch file]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    std::vector<Result> baseline;
+    if (baselinePath && !read_baseline(baselinePath, baseline))
+    {
+        fprintf(stderr, "can't read baseline %s\n", baselinePath);
+        return 2;
+    }
+
+    //Inputs, all the same synthetic session the generator source plays
+    const std::string ascii = generated_stream(false);
+    const std::string binary = generated_stream(true);
+    std::vector<int> dx1(SAMPLES), dy1(SAMPLES), dx2(SAMPLES), dy2(SAMPLES);
+    std::vector<double> poseX(SAMPLES), poseY(SAMPLES), poseDegree(SAMPLES);
+    std::vector<JointAngles<double> > joints(SAMPLES);
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        int raw[4];
+        synthetic_report(i, raw);
+        dx1[i] = raw[0];
+        dx2[i] = -raw[1];
+        dy1[i] = -raw[2];
+        dy2[i] = -raw[3];
+
+        //IK targets from a sweep through the joint space, so all are in reach
+        JointAngles<double> q = { 30 + 40 * std::sin(i * 0.003), 60 + 50 * std::sin(i * 0.005), -20 + 30 * std::cos(i * 0.007) };
+        ArmPose<double> pose = forward_kinematics(ARM, q);
+        poseDegree[i] = q.degree1 + q.degree2 + q.degree3;
+        poseX[i] = pose.x2 + ARM.l3 * std::cos(degree_to_rad(poseDegree[i]));
+        poseY[i] = pose.y2 + ARM.l3 * std::sin(degree_to_rad(poseDegree[i]));
+        joints[i] = q;
+    }
+    std::vector<double> outX(SAMPLES), outY(SAMPLES), outTheta(SAMPLES);
+    //opened once, opening allocates the stream buffer
+    std::ofstream scratch(scratchPath, std::ios::trunc);
+    if (!scratch)
+    {
+        fprintf(stderr, "can't open scratch file %s\n", scratchPath);
+        return 2;
+    }
+
+    std::vector<Benchmark> benchmarks;
+
+    benchmarks.push_back({ "parser_ascii", [&](size_t iterations, unsigned long long& bytes) {
+        MouseStreamParser parser;
+        size_t records = 0;
+        long sum = 0;
+        while (records < iterations)
+        {
+            parser.Feed(ascii.data(), ascii.size(), [&](const MouseRecord& record) { records++; sum += record.dx1; });
+            bytes += ascii.size();
+        }
+        sink = (double)sum;
+        return records;
+    } });
+
+    benchmarks.push_back({ "parser_binary", [&](size_t iterations, unsigned long long& bytes) {
+        MousePacketDecoder decoder;
+        MousePacket packet;
+        size_t records = 0;
+        long sum = 0;
+        while (records < iterations)
+        {
+            for (size_t i = 0; i < binary.size(); i++)
+                if (decoder.Push((uint8_t)binary[i], packet))
+                {
+                    records++;
+                    sum += mouse_record_from_packet(packet).dx1;
+                }
+            bytes += binary.size();
+        }
+        sink = (double)sum;
+        return records;
+    } });
+
+    benchmarks.push_back({ "odometry_update", [&](size_t iterations, unsigned long long&) {
+        MouseOdometry<double> odometry(CPI, D, 0, 0);
+        for (size_t i = 0; i < iterations; i++)
+        {
+            size_t k = i % SAMPLES;
+            odometry.Update(dx1[k], dy1[k], dx2[k], dy2[k]);
+        }
+        sink = odometry.X() + odometry.Y();
+        return iterations;
+    } });
+
+    benchmarks.push_back({ "odometry_fixed", [&](size_t iterations, unsigned long long&) {
+        FixedOdometry odometry(CPI, D, 0, 0);
+        for (size_t i = 0; i < iterations; i++)
+        {
+            size_t k = i % SAMPLES;
+            odometry.Update(dx1[k], dy1[k], dx2[k], dy2[k]);
+        }
+        sink = odometry.X() + odometry.Y();
+        return iterations;
+    } });
+
+    for (int level = 0; level <= (int)simd_level_best(); level++)
+    {
+        benchmarks.push_back({ std::string("dead_reckon_batch_") + simd_level_name((SimdLevel)level),
+            [&, level](size_t iterations, unsigned long long&) {
+            size_t done = 0;
+            while (done < iterations)
+            {
+                dead_reckon_batch(dx1.data(), dy1.data(), dx2.data(), SAMPLES, CPI, D, 0, 0, 0,
+                    outX.data(), outY.data(), outTheta.data(), (SimdLevel)level);
+                done += SAMPLES;
+            }
+            sink = outX[SAMPLES - 1];
+            return done;
+        } });
+    }
+
+    benchmarks.push_back({ "ik_3dof", [&](size_t iterations, unsigned long long&) {
+        double sum = 0;
+        for (size_t i = 0; i < iterations; i++)
+        {
+            size_t k = i % SAMPLES;
+            JointAngles<double> q = inverse_kinematics_3dof(ARM, poseX[k], poseY[k], poseDegree[k]);
+            sum += q.degree1 + q.degree2 + q.degree3;
+        }
+        sink = sum;
+        return iterations;
+    } });
+
+    benchmarks.push_back({ "fk", [&](size_t iterations, unsigned long long&) {
+        double sum = 0;
+        for (size_t i = 0; i < iterations; i++)
+        {
+            ArmPose<double> pose = forward_kinematics(ARM, joints[i % SAMPLES]);
+            sum += pose.x2 + pose.y2;
+        }
+        sink = sum;
+        return iterations;
+    } });
+
+    benchmarks.push_back({ "solve_arm", [&](size_t iterations, unsigned long long&) {
+        double sum = 0;
+        for (size_t i = 0; i < iterations; i++)
+        {
+            size_t k = i % SAMPLES;
+            ArmSolution<double> solution = solve_arm(ARM, poseX[k], poseY[k], degree_to_rad(poseDegree[k]));
+            sum += solution.q3 + solution.x2 + solution.y2;
+        }
+        sink = sum;
+        return iterations;
+    } });
+
+    benchmarks.push_back({ "solve_arm_differential", [&](size_t iterations, unsigned long long&) {
+        DifferentialArmSolver<double> solver(ARM);
+        double sum = 0;
+        for (size_t i = 0; i < iterations; i++)
+        {
+            //the sweep wraps around every SAMPLES, that jump goes through the closed form
+            size_t k = i % SAMPLES;
+            const ArmSolution<double>& solution = solver.Solve(poseX[k], poseY[k], degree_to_rad(poseDegree[k]));
+            sum += solution.q3 + solution.x2 + solution.y2;
+        }
+        sink = sum;
+        return iterations;
+    } });
+
+    benchmarks.push_back({ "pose_history_push", [&](size_t iterations, unsigned long long&) {
+        PoseHistory history(1024);
+        for (size_t i = 0; i < iterations; i++)
+        {
+            size_t k = i % SAMPLES;
+            PoseSample sample = { 0, (long long)i * 7200000, poseX[k], poseY[k], poseDegree[k],
+                joints[k].degree1, joints[k].degree2, joints[k].degree3 };
+            history.Push(sample);
+        }
+        PoseSample latest;
+        if (history.Latest(latest))
+            sink = latest.x;
+        return iterations;
+    } });
+
+    benchmarks.push_back({ "pose_predict", [&](size_t iterations, unsigned long long&) {
+        PoseHistory history(1024);
+        PosePredictor predictor;
+        PoseSample predicted = {};
+        for (size_t i = 0; i < iterations; i++)
+        {
+            size_t k = i % SAMPLES;
+            PoseSample sample = { 0, (long long)i * 7200000, poseX[k], poseY[k], poseDegree[k], 0, 0, 0 };
+            history.Push(sample);
+            predictor.Predict(history, sample.timeNs + 30000000, predicted);
+        }
+        sink = predicted.x;
+        return iterations;
+    } });
+
+    //the text branch of PosePublisher::Send
+    benchmarks.push_back({ "udp_pose_text", [&](size_t iterations, unsigned long long& bytes) {
+        char buffer[POSE_TEXT_BUFFER];
+        for (size_t i = 0; i < iterations; i++)
+        {
+            size_t k = i % SAMPLES;
+            ArmPose<double> pose = { 1.5, 4.7, 6.25, 10.5 };
+            int length = format_pose_text(buffer, sizeof(buffer), pose, poseX[k], poseY[k], joints[k], poseDegree[k]);
+            //Send drops a datagram that didn't fit
+            if (length >= 0 && length < (int)sizeof(buffer))
+                bytes += length;
+        }
+        sink = buffer[0];
+        return iterations;
+    } });
+
+    benchmarks.push_back({ "udp_pose_packet", [&](size_t iterations, unsigned long long& bytes) {
+        uint8_t buffer[POSE_PACKET_SIZE];
+        for (size_t i = 0; i < iterations; i++)
+        {
+            size_t k = i % SAMPLES;
+            PosePacket packet = { POSE_FLAG_DEVICE_TIME, (uint32_t)i, (uint32_t)(k * 7200), (int64_t)k * 7200000,
+                1.5, 4.7, 6.25, 10.5, poseX[k], poseY[k], joints[k].degree1, joints[k].degree2, joints[k].degree3, poseDegree[k] };
+            bytes += pose_packet_encode(packet, buffer);
+        }
+        sink = buffer[24];
+        return iterations;
+    } });
+
+    LatestMailbox<PosePacket> mailbox;
+    benchmarks.push_back({ "pose_mailbox_post", [&](size_t iterations, unsigned long long& bytes) {
+        PosePacket packet = {};
+        for (size_t i = 0; i < iterations; i++)
+        {
+            size_t k = i % SAMPLES;
+            packet.hostNs = (int64_t)k * 7200000;
+            packet.x = poseX[k];
+            packet.y = poseY[k];
+            packet.theta = poseDegree[k];
+            mailbox.Post(packet);
+        }
+        if (mailbox.Take(packet))
+            sink = packet.x;
+        bytes += iterations * sizeof(PosePacket);
+        return iterations;
+    } });
+
+    //a segment of its own, so a running tracker's readers don't see it
+    PoseShmWriter shmWriter;
+    if (shmWriter.Open("pmw_pose_bench"))
+        benchmarks.push_back({ "pose_shm_publish", [&](size_t iterations, unsigned long long& bytes) {
+            PosePacket packet = {};
+            for (size_t i = 0; i < iterations; i++)
+            {
+                size_t k = i % SAMPLES;
+                packet.hostNs = (int64_t)k * 7200000;
+                packet.x = poseX[k];
+                packet.y = poseY[k];
+                packet.theta = poseDegree[k];
+                shmWriter.Publish(packet);
+            }
+            bytes += iterations * 2 * sizeof(PoseShmSlot);
+            return iterations;
+        } });
+
+    //what the mouse AsyncLogger's thread does per row: format into its
+    //buffer, write the buffer out once it is full
+    std::vector<char> logBuffer(1 << 20);
+    benchmarks.push_back({ "mouse_csv_row", [&](size_t iterations, unsigned long long& bytes) {
+        scratch.seekp(0);
+        size_t used = 0;
+        for (size_t i = 0; i < iterations; i++)
+        {
+            size_t k = i % SAMPLES;
+            MouseRow row = { (long long)k * 7200000 + 1000000, (long long)k * 7200000, (long long)k * 7200, poseX[k], poseY[k],
+                2.5, 4.25, 7.125, 11.0625, poseDegree[k], joints[k].degree1, joints[k].degree2, joints[k].degree3,
+                dx1[k], dy1[k], dx2[k], dy2[k] };
+            if (logBuffer.size() - used < MOUSE_ROW_MAX_CHARS)
+            {
+                scratch.write(logBuffer.data(), used);
+                used = 0;
+            }
+            used += format_mouse_row(row, logBuffer.data() + used);
+        }
+        scratch.write(logBuffer.data(), used);
+        scratch.flush();
+        bytes += (unsigned long long)scratch.tellp();
+        return iterations;
+    } });
+
+    benchmarks.push_back({ "myo_row", [&](size_t iterations, unsigned long long& bytes) {
+        MyoSample sample = { true, true, false, 0.25f, -1.5f, 3.0f, { 0.01f, -0.98f, 0.12f }, { 1.5f, -2.25f, 0.5f },
+            { 3, -5, 12, -1, 0, 7, -33, 2 } };
+        scratch.seekp(0);
+        for (size_t i = 0; i < iterations; i++)
+        {
+            sample.emg[i & 7] = (int8_t)(i * 37);
+            write_myo_row(scratch, (unsigned int)(i * 20), sample);
+        }
+        bytes += (unsigned long long)scratch.tellp();
+        return iterations;
+    } });
+
+    benchmarks.push_back({ "marker_row", [&](size_t iterations, unsigned long long& bytes) {
+        //5 markers like the motion_capture.cpp header
+        double markers[15];
+        scratch.seekp(0);
+        for (size_t i = 0; i < iterations; i++)
+        {
+            for (int m = 0; m < 15; m++)
+                markers[m] = poseX[(i + m) % SAMPLES] * 0.01 * (m + 1);
+            write_marker_row(scratch, (int)i, (unsigned long)(i * 8), markers, 5);
+        }
+        bytes += (unsigned long long)scratch.tellp();
+        return iterations;
+    } });
+
+    //The same rows into stream_log.h files
+    StreamSink scratchSink(scratch);
+    StreamLogEncoder<MouseRow> mouseBinary(mouse_schema());
+    StreamLogEncoder<MyoRow> myoBinary(myo_schema());
+    StreamLogEncoder<MarkerFrame> markerBinary(marker_schema());
+
+    benchmarks.push_back({ "mouse_bin_row", [&](size_t iterations, unsigned long long& bytes) {
+        scratch.seekp(0);
+        for (size_t i = 0; i < iterations; i++)
+        {
+            size_t k = i % SAMPLES;
+            MouseRow row = { (long long)k * 7200000 + 1000000, (long long)k * 7200000, (long long)k * 7200, poseX[k], poseY[k],
+                2.5, 4.25, 7.125, 11.0625, poseDegree[k], joints[k].degree1, joints[k].degree2, joints[k].degree3,
+                dx1[k], dy1[k], dx2[k], dy2[k] };
+            mouseBinary.Add(row, scratchSink);
+        }
+        mouseBinary.Finish(scratchSink);
+        scratch.flush();
+        bytes += (unsigned long long)scratch.tellp();
+        return iterations;
+    } });
+
+    benchmarks.push_back({ "myo_bin_row", [&](size_t iterations, unsigned long long& bytes) {
+        MyoRow row = { 0, 0, 0, { true, true, false, 0.25f, -1.5f, 3.0f, { 0.01f, -0.98f, 0.12f }, { 1.5f, -2.25f, 0.5f },
+            { 3, -5, 12, -1, 0, 7, -33, 2 } } };
+        scratch.seekp(0);
+        for (size_t i = 0; i < iterations; i++)
+        {
+            row.hostNs = (long long)i * 20000000;
+            row.emgMicros = row.imuMicros = 1000000000 + (uint64_t)i * 20000;
+            row.sample.emg[i & 7] = (int8_t)(i * 37);
+            myoBinary.Add(row, scratchSink);
+        }
+        myoBinary.Finish(scratchSink);
+        scratch.flush();
+        bytes += (unsigned long long)scratch.tellp();
+        return iterations;
+    } });
+
+    benchmarks.push_back({ "marker_bin_row", [&](size_t iterations, unsigned long long& bytes) {
+        MarkerFrame frame = {};
+        frame.values = 15;
+        scratch.seekp(0);
+        for (size_t i = 0; i < iterations; i++)
+        {
+            frame.frame = (int32_t)i;
+            frame.hostNs = (long long)i * 8333333;
+            frame.deviceMicros = (long long)i * 8333;
+            for (int m = 0; m < 15; m++)
+                frame.xyz[m] = poseX[(i + m) % SAMPLES] * 0.01 * (m + 1);
+            markerBinary.Add(frame, scratchSink);
+        }
+        markerBinary.Finish(scratchSink);
+        scratch.flush();
+        bytes += (unsigned long long)scratch.tellp();
+        return iterations;
+    } });
+
+    //What the logger threads hand their sink, 1KB at a time. A sink is opened
+    //once and starts over every 64MB so the file stays small; opening one
+    //costs milliseconds (MmapSink preallocates), which a session pays once.
+    std::vector<char> sinkData(1024, 'x');
+    const std::string sinkPaths[2] = { std::string(scratchPath) + ".file", std::string(scratchPath) + ".mmap" };
+    std::unique_ptr<LogSink> sinks[2];
+    size_t sinkWrites[2] = { 0, 0 };
+    auto sinkBenchmark = [&](int mapped) {
+        return [&, mapped](size_t iterations, unsigned long long& bytes) {
+            const size_t perFile = (64 << 20) / sinkData.size();
+            for (size_t i = 0; i < iterations; i++)
+            {
+                if (!sinks[mapped] || sinkWrites[mapped] == perFile)
+                {
+                    sinks[mapped].reset();
+                    sinks[mapped] = open_log_sink(sinkPaths[mapped].c_str(), mapped != 0);
+                    sinkWrites[mapped] = 0;
+                }
+                sinks[mapped]->Write(sinkData.data(), sinkData.size());
+                if (++sinkWrites[mapped] % 1024 == 0)
+                    sinks[mapped]->Flush();
+            }
+            bytes += iterations * sinkData.size();
+            return iterations;
+        };
+    };
+    sinks[0] = open_log_sink(sinkPaths[0].c_str(), false);
+    sinks[1] = open_log_sink(sinkPaths[1].c_str(), true);
+    benchmarks.push_back({ "log_sink_file", sinkBenchmark(0) });
+    benchmarks.push_back({ "log_sink_mmap", sinkBenchmark(1) });
+
+    //delta_codec.h on the integer columns of a mouse chunk: the four sensor
+    //counts and the sample clock, coded one column at a time as stream_log does
+    const int CODEC_COLUMNS = 5;
+    std::vector<int64_t> codecValues;
+    for (const std::vector<int>* column : { &dx1, &dy1, &dx2, &dy2 })
+        codecValues.insert(codecValues.end(), column->begin(), column->end());
+    for (int i = 0; i < SAMPLES; i++)
+        codecValues.push_back((long long)i * 7200000 + (i * 7919) % 2000);
+    std::vector<uint8_t> coded(CODEC_COLUMNS * delta_encode_bound(SAMPLES));
+    std::vector<size_t> codedStart(CODEC_COLUMNS + 1, 0);
+    for (int c = 0; c < CODEC_COLUMNS; c++)
+        codedStart[c + 1] = codedStart[c] + delta_encode(&codecValues[c * SAMPLES], SAMPLES, &coded[codedStart[c]]);
+    std::vector<int64_t> decoded(codecValues.size());
+    //timing a decoder that gets the values wrong would mean nothing
+    for (int c = 0; c < CODEC_COLUMNS; c++)
+    {
+        if (!delta_decode(&coded[codedStart[c]], codedStart[c + 1] - codedStart[c], SAMPLES, &decoded[c * SAMPLES])
+            || !std::equal(decoded.begin() + c * SAMPLES, decoded.begin() + (c + 1) * SAMPLES,
+            codecValues.begin() + c * SAMPLES))
+        {
+            fprintf(stderr, "delta_decode does not return the coded column %d\n", c);
+            return 2;
+        }
+    }
+
+    benchmarks.push_back({ "delta_encode", [&](size_t iterations, unsigned long long& bytes) {
+        size_t done = 0;
+        while (done < iterations)
+        {
+            size_t used = 0;
+            for (int c = 0; c < CODEC_COLUMNS; c++)
+                used += delta_encode(&codecValues[c * SAMPLES], SAMPLES, &coded[used]);
+            done += codecValues.size();
+            sink = (double)used;
+        }
+        bytes += done * sizeof(int64_t);
+        return done;
+    } });
+
+    benchmarks.push_back({ "delta_decode", [&](size_t iterations, unsigned long long& bytes) {
+        size_t done = 0;
+        while (done < iterations)
+        {
+            for (int c = 0; c < CODEC_COLUMNS; c++)
+                delta_decode(&coded[codedStart[c]], codedStart[c + 1] - codedStart[c], SAMPLES, &decoded[c * SAMPLES]);
+            done += codecValues.size();
+        }
+        sink = (double)decoded[SAMPLES - 1];
+        bytes += done * sizeof(int64_t);
+        return done;
+    } });
+
+    //Stamping a record: the session clock against reading steady_clock
+    session_clock_start();
+    benchmarks.push_back({ "session_ns", [&](size_t iterations, unsigned long long&) {
+        long long sum = 0;
+        for (size_t i = 0; i < iterations; i++)
+            sum += session_ns();
+        sink = (double)sum;
+        return iterations;
+    } });
+    benchmarks.push_back({ "steady_clock_now", [&](size_t iterations, unsigned long long&) {
+        long long sum = 0;
+        for (size_t i = 0; i < iterations; i++)
+            sum += std::chrono::steady_clock::now().time_since_epoch().count();
+        sink = (double)sum;
+        return iterations;
+    } });
+
+    printf("%-26s %12s %10s %10s %10s %s\n", "benchmark", "ns/op", "Mops/s", "MB/s", "allocs/op", baselinePath ? "  vs baseline" : "");
+
+    std::vector<Result> results;
+    int regressions = 0;
+    for (size_t i = 0; i < benchmarks.size(); i++)
+    {
+        if (filter && benchmarks[i].name.find(filter) == std::string::npos)
+            continue;
+        Result result = measure(benchmarks[i], minSeconds);
+        results.push_back(result);
+
+        char throughput[32] = "-";
+        if (result.bytesPerOp > 0)
+            snprintf(throughput, sizeof(throughput), "%.1f", result.bytesPerOp / result.nsPerOp * 1e3);
+        printf("%-26s %12.2f %10.2f %10s %10.2f", result.name.c_str(), result.nsPerOp, 1e3 / result.nsPerOp,
+            throughput, result.allocsPerOp);
+
+        for (size_t b = 0; b < baseline.size(); b++)
+        {
+            if (baseline[b].name != result.name)
+                continue;
+            double change = result.nsPerOp / baseline[b].nsPerOp - 1;
+            bool slower = change > tolerance;
+            bool allocates = result.allocsPerOp > baseline[b].allocsPerOp + 0.01;
+            printf("  %+6.1f%%%s%s", change * 100, slower ? " SLOWER" : "", allocates ? " MORE ALLOCATIONS" : "");
+            if (slower || allocates)
+                regressions++;
+        }
+        printf("\n");
+    }
+    scratch.close();
+    remove(scratchPath);
+    for (int i = 0; i < 2; i++)
+    {
+        sinks[i].reset();
+        remove(sinkPaths[i].c_str());
+    }
+
+    if (writeBaselinePath && !write_baseline(writeBaselinePath, results))
+    {
+        fprintf(stderr, "can't write baseline %s\n", writeBaselinePath);
+        return 2;
+    }
+    if (regressions)
+    {
+        printf("%d regression(s) against %s\n", regressions, baselinePath);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,214 @@
+#include "byte_source.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#include "mouse_packet.h"
+
+static const char CAPTURE_MAGIC[8] = { 'P', 'M', 'W', 'C', 'A', 'P', '1', '\n' };
+static const size_t CAPTURE_HEADER = 12;
+
+CaptureWriter::CaptureWriter()
+    : file(nullptr), chunks(0)
+{
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    Close();
+}
+
+bool CaptureWriter::Open(const char* path)
+{
+    Close();
+    file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+
+    //Chunks are small, let stdio batch them into big writes
+    setvbuf(file, nullptr, _IOFBF, 1 << 20);
+    fwrite(CAPTURE_MAGIC, 1, sizeof(CAPTURE_MAGIC), file);
+    chunks = 0;
+    return true;
+}
+
+void CaptureWriter::Close()
+{
+    if (file == nullptr)
+        return;
+    fclose(file);
+    file = nullptr;
+}
+
+void CaptureWriter::Write(const char* data, int length, long long arrivalNs)
+{
+    if (file == nullptr || length <= 0)
+        return;
+
+    unsigned long long ns = (unsigned long long)arrivalNs;
+    unsigned char header[CAPTURE_HEADER];
+    for (int i = 0; i < 8; i++)
+        header[i] = (unsigned char)(ns >> (8 * i));
+    for (int i = 0; i < 4; i++)
+        header[8 + i] = (unsigned char)((unsigned int)length >> (8 * i));
+
+    fwrite(header, 1, sizeof(header), file);
+    fwrite(data, 1, length, file);
+    chunks++;
+}
+
+ReplaySource::ReplaySource(const char* path, double speed)
+    : file(nullptr), speed(speed), started(false), chunkPos(0), chunkTime(0)
+{
+    file = fopen(path, "rb");
+    if (file == nullptr)
+    {
+        printf("could not open capture %s\n", path);
+        return;
+    }
+
+    char magic[sizeof(CAPTURE_MAGIC)];
+    if (fread(magic, 1, sizeof(magic), file) != sizeof(magic) || memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) != 0)
+    {
+        printf("%s is not a capture file\n", path);
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+ReplaySource::~ReplaySource()
+{
+    if (file != nullptr)
+        fclose(file);
+}
+
+bool ReplaySource::NextChunk()
+{
+    unsigned char header[CAPTURE_HEADER];
+    if (file == nullptr || fread(header, 1, sizeof(header), file) != sizeof(header))
+        return false;
+
+    unsigned long long ns = 0;
+    unsigned int length = 0;
+    for (int i = 0; i < 8; i++)
+        ns |= (unsigned long long)header[i] << (8 * i);
+    for (int i = 0; i < 4; i++)
+        length |= (unsigned int)header[8 + i] << (8 * i);
+
+    chunk.resize(length);
+    if (fread(chunk.data(), 1, length, file) != length)
+    {
+        //Capture was cut off mid-record, the partial chunk is not played
+        chunk.clear();
+        return false;
+    }
+    chunkPos = 0;
+    chunkTime = ns;
+
+    //Timing is relative to the first chunk, not to when capturing started
+    if (!started)
+    {
+        started = true;
+        start = std::chrono::steady_clock::now() - std::chrono::nanoseconds(speed > 0 ? (long long)(ns / speed) : 0);
+    }
+    return true;
+}
+
+std::chrono::steady_clock::time_point ReplaySource::DueTime() const
+{
+    return start + std::chrono::nanoseconds((long long)(chunkTime / speed));
+}
+
+int ReplaySource::Read(char* buffer, unsigned int length)
+{
+    if (chunkPos == chunk.size() && !NextChunk())
+    {
+        if (file != nullptr)
+            fclose(file);
+        file = nullptr;
+        return 0;
+    }
+    if (speed > 0 && std::chrono::steady_clock::now() < DueTime())
+        return 0;
+
+    size_t n = std::min<size_t>(length, chunk.size() - chunkPos);
+    memcpy(buffer, chunk.data() + chunkPos, n);
+    chunkPos += n;
+    return (int)n;
+}
+
+void ReplaySource::Wait(unsigned int timeoutMs)
+{
+    //Unthrottled replay and the end of a chunk never have to wait
+    if (speed <= 0 || chunkPos == chunk.size())
+        return;
+    std::chrono::steady_clock::time_point until = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    std::this_thread::sleep_until(std::min(until, DueTime()));
+}
+
+bool ReplaySource::IsOpen()
+{
+    return file != nullptr || chunkPos < chunk.size();
+}
+
+void synthetic_report(long index, int raw[4])
+{
+    //one circle every 1000 reports, about 7s at the firmware's report rate
+    const double step = 2 * 3.14159265358979323846 / 1000;
+    double c = cos(index * step);
+    double s = sin(index * step);
+    raw[0] = (int)lround(40 * c) + (int)(index % 7) - 3;
+    raw[1] = (int)lround(-38 * c) + (int)(index % 5) - 2;
+    raw[2] = (int)lround(-40 * s) + (int)(index % 3) - 1;
+    raw[3] = (int)lround(-40 * s) + (int)(index % 11) - 5;
+}
+
+void append_ascii_report(std::string& out, uint32_t deviceMicros, const int raw[4], int btn0, int btn1)
+{
+    out += "t" + std::to_string(deviceMicros) + "xa" + std::to_string(raw[0]) + "xb" + std::to_string(raw[1]) + "ya" + std::to_string(raw[2]) +
+        "yb" + std::to_string(raw[3]) + "ca" + std::to_string(btn0) + "cb" + std::to_string(btn1);
+}
+
+GeneratorSource::GeneratorSource(long reports, bool binary)
+    : reports(reports), binary(binary), produced(0), pending(0), arrival(0)
+{
+}
+
+int GeneratorSource::Read(char* buffer, unsigned int length)
+{
+    if (pending == stream.size())
+    {
+        //A few reports per batch, about what a serial read returns in one go
+        stream.clear();
+        pending = 0;
+        for (long end = std::min(produced + 16, reports); produced < end; produced++)
+        {
+            int raw[4];
+            synthetic_report(produced, raw);
+            if (binary)
+            {
+                MousePacket packet;
+                packet.seq = (uint8_t)produced;
+                packet.timestamp = (uint32_t)(produced * SYNTHETIC_INTERVAL_US);
+                packet.dx1 = (int16_t)raw[0];
+                packet.dx2 = (int16_t)raw[1];
+                packet.dy1 = (int16_t)raw[2];
+                packet.dy2 = (int16_t)raw[3];
+                packet.buttons = 0;
+                uint8_t frame[MOUSE_PACKET_SIZE];
+                mouse_packet_encode(packet, frame);
+                stream.append((const char*)frame, sizeof(frame));
+            }
+            else
+                append_ascii_report(stream, (uint32_t)(produced * SYNTHETIC_INTERVAL_US), raw, 0, 0);
+        }
+        arrival = (produced - 1) * SYNTHETIC_INTERVAL_US * 1000LL + 1000000;
+    }
+
+    size_t n = std::min<size_t>(length, stream.size() - pending);
+    memcpy(buffer, stream.data() + pending, n);
+    pending += n;
+    return (int)n;
+}
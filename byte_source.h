@@ -0,0 +1,134 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "SerialClass.h"
+#include "session_clock.h"
+
+// Where the tracking loop gets its bytes from. Code.cpp reads a live port,
+// a capture file recorded earlier, or synthetic reports, and everything
+// after the read (parser, dead reckoning, IK, logging) runs unchanged.
+class ByteSource
+{
+public:
+    virtual ~ByteSource() {}
+
+    //Copy up to length bytes into buffer, 0 if nothing is available right now
+    virtual int Read(char* buffer, unsigned int length) = 0;
+    //Sleep until Read has something to return or timeoutMs passed
+    virtual void Wait(unsigned int timeoutMs) = 0;
+    //False once the port is gone or the source is used up
+    virtual bool IsOpen() = 0;
+    //When the bytes of the last Read arrived on the host, in nanoseconds:
+    //session_clock.h time for a live port, a replay gives the captured times
+    virtual long long ArrivalNs() = 0;
+};
+
+class SerialSource : public ByteSource
+{
+public:
+    explicit SerialSource(Serial& port) : port(port), arrival(0) {}
+
+    int Read(char* buffer, unsigned int length) override
+    {
+        int n = port.ReadData(buffer, length);
+        if (n > 0)
+            arrival = session_ns();
+        return n;
+    }
+    void Wait(unsigned int timeoutMs) override { port.WaitForData(timeoutMs); }
+    bool IsOpen() override { return port.IsConnected(); }
+    long long ArrivalNs() override { return arrival; }
+
+private:
+    Serial& port;
+    long long arrival;
+};
+
+// Capture file, one record per chunk the port returned:
+//   "PMWCAP1\n"
+//   { uint64 arrival ns, uint32 length, length raw bytes } ...
+// integers little-endian. The arrival time is the source's ArrivalNs, the
+// session clock for a live port, so a replay stamps its reports with the
+// times the logs of the captured session have.
+class CaptureWriter
+{
+public:
+    CaptureWriter();
+    ~CaptureWriter();
+
+    bool Open(const char* path);
+    void Close();
+    bool IsOpen() const { return file != nullptr; }
+
+    //Record a chunk that arrived at arrivalNs (ByteSource::ArrivalNs)
+    void Write(const char* data, int length, long long arrivalNs);
+    unsigned long long Chunks() const { return chunks; }
+
+private:
+    FILE* file;
+    unsigned long long chunks;
+};
+
+// Plays a capture file back with its original timing scaled by speed:
+// 1 is real time, N is N times faster, 0 hands out chunks as fast as they
+// are read. A Read never spans two chunks, so ArrivalNs is the captured
+// time of exactly the bytes returned.
+class ReplaySource : public ByteSource
+{
+public:
+    ReplaySource(const char* path, double speed);
+    ~ReplaySource();
+
+    int Read(char* buffer, unsigned int length) override;
+    void Wait(unsigned int timeoutMs) override;
+    bool IsOpen() override;
+    long long ArrivalNs() override { return (long long)chunkTime; }
+
+private:
+    //Load the next record into chunk, false at the end of the file
+    bool NextChunk();
+    std::chrono::steady_clock::time_point DueTime() const;
+
+    FILE* file;
+    double speed;
+    bool started;
+    std::chrono::steady_clock::time_point start;
+    std::vector<char> chunk;
+    size_t chunkPos;
+    unsigned long long chunkTime;
+};
+
+// Raw deltas dx1, dx2, dy1, dy2 of report index of a deterministic synthetic
+// stream, as the firmware would send them: both sensors go round a slow
+// circle with a bit of jitter on top. Reports are SYNTHETIC_INTERVAL_US apart.
+#define SYNTHETIC_INTERVAL_US 7200
+void synthetic_report(long index, int raw[4]);
+// Firmware text of one ASCII protocol report
+void append_ascii_report(std::string& out, uint32_t deviceMicros, const int raw[4], int btn0, int btn1);
+
+// In-memory firmware: hands out synthetic_report() reports, in ASCII or as
+// mouse_packet.h frames, with no pacing at all. Each batch of reports
+// "arrives" 1ms after its last report was stamped.
+class GeneratorSource : public ByteSource
+{
+public:
+    GeneratorSource(long reports, bool binary);
+
+    int Read(char* buffer, unsigned int length) override;
+    void Wait(unsigned int) override {}
+    bool IsOpen() override { return produced < reports || pending < stream.size(); }
+    long long ArrivalNs() override { return arrival; }
+
+private:
+    long reports;
+    bool binary;
+    long produced;
+    std::string stream;
+    size_t pending;
+    long long arrival;
+};
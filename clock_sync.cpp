@@ -0,0 +1,119 @@
+#include "clock_sync.h"
+
+#include <math.h>
+
+ClockSync::ClockSync(unsigned int bucketMs, unsigned int buckets)
+    : bucketUs((long long)bucketMs * 1000), maxBuckets(buckets < 2 ? 2 : buckets), oldest(0),
+    currentIndex(0), lastDevice(0), samples(0), originDevice(0), originHost(0), rate(1.0), residualNs(0)
+{
+    closed.reserve(maxBuckets);
+    current.deviceUs = 0;
+    current.minDelta = 0;
+}
+
+long long ClockSync::Unwrap(uint32_t deviceMicros) const
+{
+    //Signed distance to the last stamp, so a wrap of micros() in between is harmless
+    int32_t diff = (int32_t)(deviceMicros - (uint32_t)lastDevice);
+    return lastDevice + diff;
+}
+
+void ClockSync::Add(uint32_t deviceMicros, long long hostNs)
+{
+    long long device = samples == 0 ? (long long)deviceMicros : Unwrap(deviceMicros);
+    long long delta = hostNs - device * 1000;
+    long long index = device / bucketUs;
+
+    if (samples == 0)
+    {
+        currentIndex = index;
+        current.deviceUs = device;
+        current.minDelta = delta;
+    }
+    else if (index == currentIndex)
+    {
+        if (delta < current.minDelta)
+        {
+            current.deviceUs = device;
+            current.minDelta = delta;
+        }
+    }
+    else if (index > currentIndex)
+    {
+        if (closed.size() < maxBuckets)
+            closed.push_back(current);
+        else
+        {
+            closed[oldest] = current;
+            oldest = (oldest + 1) % maxBuckets;
+        }
+        Fit();
+
+        currentIndex = index;
+        current.deviceUs = device;
+        current.minDelta = delta;
+    }
+
+    //Until there is a line to fit, go with the earliest arrival at rate 1
+    if (closed.size() < 2 && (samples == 0 || delta < originHost - originDevice * 1000))
+    {
+        originDevice = device;
+        originHost = hostNs;
+        rate = 1.0;
+    }
+
+    if (device > lastDevice || samples == 0)
+        lastDevice = device;
+    samples++;
+}
+
+void ClockSync::Fit()
+{
+    size_t n = closed.size();
+    if (n < 2)
+        return;
+
+    //Relative to the first bucket, keeps the sums well inside double precision
+    long long x0 = closed[0].deviceUs;
+    long long y0 = closed[0].minDelta;
+    double meanX = 0, meanY = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        meanX += (double)(closed[i].deviceUs - x0);
+        meanY += (double)(closed[i].minDelta - y0);
+    }
+    meanX /= n;
+    meanY /= n;
+
+    double sxx = 0, sxy = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double dx = (closed[i].deviceUs - x0) - meanX;
+        double dy = (closed[i].minDelta - y0) - meanY;
+        sxx += dx * dx;
+        sxy += dx * dy;
+    }
+    if (sxx <= 0)
+        return;
+
+    //delta = host - 1000 * device grows by slope ns per device us
+    double slope = sxy / sxx;
+    double sum = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double dx = (closed[i].deviceUs - x0) - meanX;
+        double dy = (closed[i].minDelta - y0) - meanY;
+        sum += (dy - slope * dx) * (dy - slope * dx);
+    }
+
+    originDevice = x0 + (long long)llround(meanX);
+    originHost = originDevice * 1000 + y0 + (long long)llround(meanY + slope * (originDevice - x0 - meanX));
+    rate = 1.0 + slope / 1000.0;
+    residualNs = sqrt(sum / n);
+}
+
+long long ClockSync::ToHost(uint32_t deviceMicros) const
+{
+    long long device = Unwrap(deviceMicros);
+    return originHost + (long long)llround(rate * (double)(device - originDevice) * 1000.0);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+// Maps the firmware's micros() stamps into the host's monotonic timebase.
+//
+// A report stamped d on the device arrives on the host at
+//     h = offset + rate * d + delay,   delay >= 0
+// where delay is serial transmission plus USB and scheduling jitter. The
+// earliest arrivals have the smallest and steadiest delay, so the device time
+// is split into buckets, only the minimum of h - d is kept per bucket and a
+// least squares line through the bucket minima of the last window gives
+// offset and rate (the drift of the board's oscillator).
+//
+// The mapped time still contains the minimum delay, about one report's worth
+// of bytes on the wire plus a USB frame, which is constant for a given link.
+class ClockSync
+{
+public:
+    //bucketMs of device time per minimum, fit over the last buckets of them
+    explicit ClockSync(unsigned int bucketMs = 500, unsigned int buckets = 64);
+
+    //A report stamped deviceMicros arrived at hostNs
+    void Add(uint32_t deviceMicros, long long hostNs);
+    //Host time of a device stamp, the stamp has to be within ~35 minutes of
+    //the last one passed to Add (micros() wraps every 71 minutes)
+    long long ToHost(uint32_t deviceMicros) const;
+
+    //At least one report seen, ToHost is valid from here on
+    bool Ready() const { return samples > 0; }
+    //Device clock rate error in parts per million, 0 until two buckets closed
+    double DriftPpm() const { return (rate - 1.0) * 1e6; }
+    //Spread of the bucket minima around the fitted line, in nanoseconds
+    double ResidualNs() const { return residualNs; }
+    unsigned long long Samples() const { return samples; }
+
+private:
+    struct Bucket
+    {
+        long long deviceUs;
+        //Minimum host - device arrival of the bucket, in ns
+        long long minDelta;
+    };
+
+    long long Unwrap(uint32_t deviceMicros) const;
+    void Fit();
+
+    long long bucketUs;
+    unsigned int maxBuckets;
+    std::vector<Bucket> closed;
+    unsigned int oldest;
+    Bucket current;
+    long long currentIndex;
+
+    long long lastDevice;
+    unsigned long long samples;
+
+    //host = originHost + rate * (device - originDevice) * 1000
+    long long originDevice;
+    long long originHost;
+    double rate;
+    double residualNs;
+};
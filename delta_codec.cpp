@@ -0,0 +1,167 @@
+#include "delta_codec.h"
+
+#include <string.h>
+
+static const size_t BLOCK = 128;
+static const uint8_t DIFFERENCES = 0x80;
+
+static inline uint64_t zigzag(int64_t value)
+{
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static inline uint64_t unzigzag(uint64_t value)
+{
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+//Bits needed for value, 0 for 0
+static inline unsigned bit_width(uint64_t value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return value ? 64 - __builtin_clzll(value) : 0;
+#else
+    unsigned width = 0;
+    for (; value; value >>= 1)
+        width++;
+    return width;
+#endif
+}
+
+static inline size_t packed_bytes(size_t count, unsigned width)
+{
+    return (count * width + 7) / 8;
+}
+
+//Little endian 64-bit load; the byte loop is not merged into one load by
+//every compiler, the decoder spends most of its time here
+static inline uint64_t load_le64(const uint8_t* p)
+{
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__) \
+    || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+#else
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++)
+        value |= (uint64_t)p[i] << (8 * i);
+    return value;
+#endif
+}
+
+//The same, bytes at or past end read as 0
+static inline uint64_t load_le64(const uint8_t* p, const uint8_t* end)
+{
+    if (end - p >= 8)
+        return load_le64(p);
+    uint64_t value = 0;
+    for (size_t i = 0; p + i < end; i++)
+        value |= (uint64_t)p[i] << (8 * i);
+    return value;
+}
+
+static uint8_t* pack(const uint64_t* values, size_t count, unsigned width, uint8_t* out)
+{
+    if (width == 0)
+        return out;
+    uint64_t bits = 0;
+    unsigned used = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        bits |= values[i] << used;
+        if (used + width < 64)
+        {
+            used += width;
+            continue;
+        }
+        for (int b = 0; b < 8; b++)
+            *out++ = (uint8_t)(bits >> (8 * b));
+        unsigned spilled = used + width - 64;
+        bits = spilled ? values[i] >> (width - spilled) : 0;
+        used = spilled;
+    }
+    for (unsigned b = 0; b < used; b += 8)
+        *out++ = (uint8_t)(bits >> b);
+    return out;
+}
+
+size_t delta_encode_bound(size_t count)
+{
+    return (count + BLOCK - 1) / BLOCK + count * 8;
+}
+
+size_t delta_encode(const int64_t* values, size_t count, uint8_t* out)
+{
+    uint8_t* p = out;
+    uint64_t previous = 0;
+    uint64_t differences[BLOCK], plain[BLOCK];
+    for (size_t start = 0; start < count; start += BLOCK)
+    {
+        size_t n = count - start < BLOCK ? count - start : BLOCK;
+        uint64_t differenceBits = 0, plainBits = 0;
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t value = (uint64_t)values[start + i];
+            differences[i] = zigzag((int64_t)(value - previous));
+            plain[i] = zigzag((int64_t)value);
+            differenceBits |= differences[i];
+            plainBits |= plain[i];
+            previous = value;
+        }
+
+        //the plain block on a tie, it decodes without the prefix sum
+        unsigned differenceWidth = bit_width(differenceBits), plainWidth = bit_width(plainBits);
+        bool useDifferences = differenceWidth < plainWidth;
+        unsigned width = useDifferences ? differenceWidth : plainWidth;
+        *p++ = (uint8_t)((useDifferences ? DIFFERENCES : 0) | width);
+        p = pack(useDifferences ? differences : plain, n, width, p);
+    }
+    return p - out;
+}
+
+static void decode_block(const uint8_t* in, const uint8_t* end, size_t count, unsigned width,
+    bool differences, uint64_t previous, int64_t* out)
+{
+    const uint64_t mask = width == 64 ? ~(uint64_t)0 : ((uint64_t)1 << width) - 1;
+    //with 8 bytes to spare after the block no load needs the end check
+    const bool slack = (size_t)(end - in) >= packed_bytes(count, width) + 8;
+    uint64_t bit = 0;
+    for (size_t i = 0; i < count; i++, bit += width)
+    {
+        const uint8_t* p = in + (bit >> 3);
+        unsigned shift = (unsigned)(bit & 7);
+        uint64_t value = (slack ? load_le64(p) : load_le64(p, end)) >> shift;
+        //a value of more than 57 bits can reach into a 9th byte
+        if (shift + width > 64)
+            value |= (uint64_t)p[8] << (64 - shift);
+        value = unzigzag(value & mask);
+        previous = differences ? previous + value : value;
+        out[i] = (int64_t)previous;
+    }
+}
+
+bool delta_decode(const uint8_t* in, size_t size, size_t count, int64_t* values)
+{
+    const uint8_t* p = in;
+    const uint8_t* end = in + size;
+    uint64_t previous = 0;
+    for (size_t start = 0; start < count; start += BLOCK)
+    {
+        size_t n = count - start < BLOCK ? count - start : BLOCK;
+        if (p == end)
+            return false;
+        unsigned width = *p & ~DIFFERENCES;
+        bool differences = (*p & DIFFERENCES) != 0;
+        p++;
+        size_t bytes = packed_bytes(n, width);
+        if (width > 64 || (size_t)(end - p) < bytes)
+            return false;
+
+        decode_block(p, end, n, width, differences, previous, values + start);
+
+        previous = (uint64_t)values[start + n - 1];
+        p += bytes;
+    }
+    return p == end;
+}
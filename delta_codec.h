@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Compression of integer columns (stream_log.h): timestamps, frame numbers,
+// Myo EMG and flags, mouse sensor counts. Values are coded in blocks of 128:
+// each block is stored either as the differences to the value before it or
+// as the values themselves, whichever needs fewer bits, zigzag mapped so
+// small negative numbers are small too, and bit-packed at the width of the
+// largest one. A block is one header byte (bit 7: differences, bits 0-6:
+// width 0..64) and 128 * width bits, the last block of a column holds the
+// rest of the values. A counter or a clock stepping by about the same amount
+// takes a few bits per value, a constant column 1 byte per block; a column
+// never grows by more than 1 byte per block.
+
+//Most bytes delta_encode writes for count values
+size_t delta_encode_bound(size_t count);
+
+//Codes count values into out, returns the bytes written
+size_t delta_encode(const int64_t* values, size_t count, uint8_t* out);
+
+//Decodes count values from the size bytes at in, false if those are not
+//what delta_encode wrote for count values
+bool delta_decode(const uint8_t* in, size_t size, size_t count, int64_t* values);
@@ -0,0 +1,144 @@
+// Checks delta_codec.h: every column delta_encode codes decodes back to the
+// same values, blocks of every width and length, and decoding refuses input
+// that is cut short or too long. Prints every failed check and returns 1 if
+// there was one.
+//
+//   g++ -O2 -std=c++14 delta_codec_test.cpp delta_codec.cpp -o delta_codec_test
+//   ./delta_codec_test
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "delta_codec.h"
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                                   \
+    do                                                          \
+    {                                                           \
+        if (!(condition))                                       \
+        {                                                       \
+            failures++;                                         \
+            printf("FAILED %s:%d: %s: ", __FILE__, __LINE__, #condition); \
+            printf(__VA_ARGS__);                                \
+            printf("\n");                                       \
+        }                                                       \
+    } while (0)
+
+//splitmix64, the same columns on every run
+static uint64_t random_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t next_random()
+{
+    uint64_t z = (random_state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+//Random values of at most bits bits, signed
+static std::vector<int64_t> random_column(size_t count, unsigned bits)
+{
+    std::vector<int64_t> values(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t value = next_random();
+        values[i] = bits >= 64 ? (int64_t)value : (int64_t)(value >> (64 - bits)) - ((int64_t)1 << (bits - 1));
+    }
+    return values;
+}
+
+static std::vector<uint8_t> encode(const std::vector<int64_t>& values)
+{
+    std::vector<uint8_t> coded(delta_encode_bound(values.size()));
+    coded.resize(delta_encode(values.data(), values.size(), coded.data()));
+    return coded;
+}
+
+//Codes values and decodes them, what comes back must be values
+static void round_trip(const std::vector<int64_t>& values, const char* name)
+{
+    std::vector<uint8_t> coded = encode(values);
+    CHECK(coded.size() <= delta_encode_bound(values.size()), "%s: %zu bytes for %zu values", name, coded.size(),
+        values.size());
+    //a guard value after the end catches a decoder writing past count
+    std::vector<int64_t> decoded(values.size() + 1, 0x5A5A5A5A);
+    bool ok = delta_decode(coded.data(), coded.size(), values.size(), decoded.data());
+    CHECK(ok, "%s: decode failed", name);
+    CHECK(ok && (values.empty() || memcmp(decoded.data(), values.data(), values.size() * sizeof(int64_t)) == 0),
+        "%s: decoded values differ", name);
+    CHECK(decoded[values.size()] == 0x5A5A5A5A, "%s: wrote past the end", name);
+}
+
+static void test_widths()
+{
+    //partial blocks, one block, a block and a bit, many full blocks
+    const size_t lengths[] = { 0, 1, 5, 127, 128, 129, 1000 };
+    char name[64];
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+    {
+        for (unsigned bits = 1; bits <= 64; bits++)
+        {
+            snprintf(name, sizeof(name), "%zu values of %u bits", lengths[l], bits);
+            round_trip(random_column(lengths[l], bits), name);
+        }
+    }
+}
+
+static void test_columns()
+{
+    const size_t n = 1000;
+    std::vector<int64_t> constant(n, -7), counter(n), clock(n), extremes(n), emg(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        counter[i] = (int64_t)i + 1000;
+        clock[i] = (int64_t)i * 7200000 + (int64_t)(next_random() % 2000);
+        extremes[i] = i % 2 ? INT64_MAX : INT64_MIN;
+        emg[i] = (int8_t)next_random();
+    }
+    round_trip(constant, "constant");
+    round_trip(counter, "counter");
+    round_trip(clock, "clock");
+    round_trip(extremes, "INT64_MIN, INT64_MAX");
+    round_trip(emg, "EMG");
+
+    //after its first block a constant column is one header byte per block
+    std::vector<int64_t> first(constant.begin(), constant.begin() + 128);
+    size_t rest = encode(constant).size() - encode(first).size();
+    CHECK(rest == (n - 1) / 128, "constant: %zu bytes after the first block", rest);
+}
+
+static void test_damaged()
+{
+    std::vector<int64_t> values = random_column(300, 20);
+    std::vector<uint8_t> coded = encode(values);
+    std::vector<int64_t> decoded(values.size());
+
+    CHECK(!delta_decode(coded.data(), coded.size() - 1, values.size(), decoded.data()), "one byte short decodes");
+    coded.push_back(0);
+    CHECK(!delta_decode(coded.data(), coded.size(), values.size(), decoded.data()), "one byte too many decodes");
+    coded.pop_back();
+    CHECK(!delta_decode(coded.data(), coded.size(), values.size() + 1, decoded.data()), "more values than coded decode");
+
+    //header of the first block with a width over 64
+    uint8_t header = coded[0];
+    coded[0] = (uint8_t)((header & 0x80) | 65);
+    CHECK(!delta_decode(coded.data(), coded.size(), values.size(), decoded.data()), "width 65 decodes");
+}
+
+int main()
+{
+    test_widths();
+    test_columns();
+    test_damaged();
+
+    if (failures > 0)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "fixed_odometry.h"
+
+#include <math.h>
+
+static const double PI = 3.14159265358979323846;
+//table positions per turn, Q32
+static const double PHASE_PER_TURN = 70368744177664.0; // 2^46
+static const double Q30 = 1073741824.0;
+//steps up to this many rotation counts use the arc table
+static const size_t ARC_TABLE_SIZE = 4096;
+
+static double arc_minus_one(double rad)
+{
+    return rad == 0 ? 0 : rad / (2 * sin(rad / 2)) - 1;
+}
+
+FixedOdometry::FixedOdometry(double cpi, double sensorDistance, double x, double y, double theta)
+    : cpi(cpi), radPerCount(1 / (sensorDistance * cpi))
+{
+    phasePerHalfCount = (uint64_t)llround(PHASE_PER_TURN * radPerCount / 2 / (2 * PI));
+
+    sine.resize(TABLE_SIZE + TABLE_SIZE / 4 + 1);
+    for (size_t i = 0; i < sine.size(); i++)
+        sine[i] = (int32_t)lround(sin(2 * PI * i / TABLE_SIZE) * Q30);
+
+    arc.resize(ARC_TABLE_SIZE);
+    for (size_t i = 0; i < arc.size(); i++)
+        arc[i] = llround(arc_minus_one(i * radPerCount) * Q30);
+
+    Reset(x, y, theta);
+}
+
+void FixedOdometry::Reset(double newX, double newY, double newTheta)
+{
+    x0 = newX;
+    y0 = newY;
+    theta0 = newTheta;
+    //whole turns dropped first, what's left fits an int64 of phase
+    double turns = newTheta / 360 - floor(newTheta / 360);
+    phase0 = (uint64_t)llround(turns * PHASE_PER_TURN);
+    x = 0;
+    y = 0;
+    heading = 0;
+}
+
+int64_t FixedOdometry::ArcCorrectionSlow(int64_t rotation) const
+{
+    //a step of more than a turn is garbage anyway, keep the products in range
+    double correction = arc_minus_one((double)rotation * radPerCount);
+    if (!(correction < 2.0))
+        correction = 2.0;
+    return llround(correction * Q30);
+}
+
+double FixedOdometry::X() const
+{
+    return x0 + (double)x / Q30 / cpi;
+}
+
+double FixedOdometry::Y() const
+{
+    return y0 + (double)y / Q30 / cpi;
+}
+
+double FixedOdometry::Theta() const
+{
+    return theta0 + (double)heading * radPerCount * 180 / PI;
+}
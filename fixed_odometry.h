@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// MouseOdometry (kinematics.hpp) in integer arithmetic, for sessions that
+// have to replay bit for bit, on any machine and compiler.
+//
+// The heading is kept as the exact sum of the rotation counts (dx1 + dx2),
+// the position in counts as 64-bit fixed point with 30 fraction bits.
+// Per sample there is no floating point at all: sine and cosine of the mid
+// step heading come from a table (16384 steps per turn, linearly
+// interpolated) and the chord/arc correction from a second table over the
+// rotation counts of one step. Inches and degrees are only computed when
+// X(), Y() or Theta() is called, i.e. when a pose is logged or published.
+//
+// Follows MouseOdometry<double> to ~1e-9 of the distance travelled; the
+// tables are built in double once, so two builds only differ if a table
+// entry rounds differently, not by rounding that accumulates per sample.
+class FixedOdometry
+{
+public:
+    //cpi: sensor resolution, sensorDistance: inch between the two sensors
+    FixedOdometry(double cpi, double sensorDistance, double x, double y, double theta = 0);
+
+    void Reset(double newX, double newY, double newTheta = 0);
+
+    void Update(int dx1, int dy1, int dx2, int /*dy2*/)
+    {
+        const int64_t rotation = (int64_t)dx1 + dx2;
+        //mid step heading, in half counts
+        const int64_t mid = 2 * heading + rotation;
+
+        int32_t c, s;
+        SinCos(phase0 + (uint64_t)mid * phasePerHalfCount, c, s);
+        int64_t stepX = (int64_t)c * dx1 + (int64_t)s * dy1;
+        int64_t stepY = -(int64_t)s * dx1 + (int64_t)c * dy1;
+
+        //arc / chord - 1 in Q30, small, so the step loses its low 15 bits first
+        const int64_t arc = ArcCorrection(rotation);
+        stepX += ((stepX >> 15) * arc) >> 15;
+        stepY += ((stepY >> 15) * arc) >> 15;
+
+        x += stepX;
+        y += stepY;
+        heading += rotation;
+    }
+
+    double X() const;
+    double Y() const;
+    //Heading in degrees, 0 when the mouse points along +y
+    double Theta() const;
+
+    //Raw state: position in counts << 30, heading in rotation counts
+    int64_t RawX() const { return x; }
+    int64_t RawY() const { return y; }
+    int64_t RawHeading() const { return heading; }
+
+private:
+    static const int TABLE_BITS = 14;
+    static const uint32_t TABLE_SIZE = 1u << TABLE_BITS;
+
+    //phase: table position, Q32 table steps, so a turn is 2^46 and uint64
+    //overflow wraps whole turns. Results in Q30.
+    void SinCos(uint64_t phase, int32_t& c, int32_t& s) const
+    {
+        const uint32_t index = (uint32_t)(phase >> 32) & (TABLE_SIZE - 1);
+        const int64_t frac = (int64_t)((phase >> 16) & 0xFFFF);
+        const int32_t* p = &sine[index];
+        s = p[0] + (int32_t)(((int64_t)(p[1] - p[0]) * frac) >> 16);
+        p += TABLE_SIZE / 4;
+        c = p[0] + (int32_t)(((int64_t)(p[1] - p[0]) * frac) >> 16);
+    }
+
+    int64_t ArcCorrection(int64_t rotation) const
+    {
+        const uint64_t magnitude = rotation < 0 ? (uint64_t)-rotation : (uint64_t)rotation;
+        return magnitude < arc.size() ? arc[(size_t)magnitude] : ArcCorrectionSlow(rotation);
+    }
+    int64_t ArcCorrectionSlow(int64_t rotation) const;
+
+    double cpi;
+    double radPerCount;
+    //table position of one half count of rotation, Q32 table steps
+    uint64_t phasePerHalfCount;
+    //table position of heading 0, from the initial theta
+    uint64_t phase0;
+    double theta0;
+    double x0, y0;
+
+    int64_t x, y;
+    int64_t heading;
+
+    //sin over a turn plus a quarter (cos) plus one for the interpolation, Q30
+    std::vector<int32_t> sine;
+    //arc correction by rotation counts of a step, Q30
+    std::vector<int64_t> arc;
+};
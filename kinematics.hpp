@@ -0,0 +1,430 @@
+#ifndef KINEMATICS_HPP_INCLUDED
+#define KINEMATICS_HPP_INCLUDED
+
+// Dead reckoning of the dual sensor mouse and kinematics of the planar
+// 3 link arm it drives, shared by the live loop (Code.cpp), the benchmark
+// and offline reprocessing. T is float or double.
+//
+// Angles are in degrees like everywhere else in the project. Every function
+// has a single sample form and a batch form over contiguous arrays, the
+// batch forms are plain loops over the single sample code so both give
+// identical results.
+
+#include <stddef.h>
+#include <cmath>
+
+template <typename T>
+struct KinematicsConstants
+{
+    static T Pi() { return (T)3.14159265358979323846; }
+};
+
+template <typename T>
+inline T degree_to_rad(T degree)
+{
+    return degree * KinematicsConstants<T>::Pi() / 180;
+}
+
+template <typename T>
+inline T rad_to_degree(T rad)
+{
+    return rad * 180 / KinematicsConstants<T>::Pi();
+}
+
+// Link lengths from the shoulder out, in the unit positions are given in
+template <typename T>
+struct ArmGeometry
+{
+    T l1, l2, l3;
+};
+
+template <typename T>
+struct JointAngles
+{
+    T degree1, degree2, degree3;
+};
+
+// Forward kinematics result: elbow (x1, y1) and wrist (x2, y2)
+template <typename T>
+struct ArmPose
+{
+    T x1, y1, x2, y2;
+};
+
+// Pose of the mouse on the pad, integrated from the raw counts of the front
+// (1) and rear (2) sensor, already in the host sign convention (MouseRecord).
+// Rotation comes from the x counts of both sensors, translation from the
+// front sensor rotated by the heading halfway through the step, scaled by
+// the chord/arc correction d / (2 sin(d/2)). The rear sensor's y count says
+// the same as the front one's for a rigid mouse and isn't used.
+template <typename T>
+class MouseOdometry
+{
+public:
+    //cpi: sensor resolution, sensorDistance: inch between the two sensors
+    MouseOdometry(T cpi, T sensorDistance, T x, T y, T theta = 0)
+        : cpi(cpi), degreePerCount(180 / (KinematicsConstants<T>::Pi() * sensorDistance * cpi)),
+        x(x), y(y), theta(theta)
+    {
+    }
+
+    void Reset(T newX, T newY, T newTheta = 0)
+    {
+        x = newX;
+        y = newY;
+        theta = newTheta;
+    }
+
+    void Update(int dx1, int dy1, int dx2, int /*dy2*/)
+    {
+        T deltaTheta = ((T)dx1 + (T)dx2) * degreePerCount;
+        T midTheta = theta + deltaTheta / 2;
+
+        T th = degree_to_rad(midTheta);
+        T dTh = degree_to_rad(deltaTheta);
+        T c = std::cos(th);
+        T s = std::sin(th);
+        T stepX = (c * dx1 + s * dy1) / cpi;
+        T stepY = (-s * dx1 + c * dy1) / cpi;
+        T arc = dTh == 0 ? (T)1 : dTh / (2 * std::sin(dTh / 2));
+
+        x += arc * stepX;
+        y += arc * stepY;
+        theta = midTheta + deltaTheta / 2;
+    }
+
+    //Update for count samples, writing the pose after each one. Any of the
+    //outputs may be null.
+    void UpdateBatch(const int* dx1, const int* dy1, const int* dx2, const int* dy2, size_t count,
+        T* outX, T* outY, T* outTheta)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            Update(dx1[i], dy1[i], dx2[i], dy2[i]);
+            if (outX) outX[i] = x;
+            if (outY) outY[i] = y;
+            if (outTheta) outTheta[i] = theta;
+        }
+    }
+
+    T X() const { return x; }
+    T Y() const { return y; }
+    //Heading in degrees, 0 when the mouse points along +y
+    T Theta() const { return theta; }
+
+private:
+    T cpi;
+    T degreePerCount;
+    T x, y, theta;
+};
+
+// Two link inverse kinematics, elbow angle taken positive. degree3 is 0.
+// Out of reach targets give NaN.
+template <typename T>
+inline JointAngles<T> inverse_kinematics_2dof(const ArmGeometry<T>& arm, T x, T y)
+{
+    T k = (x * x + y * y - arm.l1 * arm.l1 - arm.l2 * arm.l2) / (2 * arm.l1 * arm.l2);
+    T a2 = std::atan2(std::sqrt(1 - k * k), k);
+    T a1 = std::atan2(y, x) - std::atan2(arm.l2 * std::sin(a2), arm.l1 + arm.l2 * std::cos(a2));
+
+    const T toDegree = 180 / KinematicsConstants<T>::Pi();
+    JointAngles<T> q;
+    q.degree1 = a1 * toDegree;
+    q.degree2 = a2 * toDegree;
+    q.degree3 = 0;
+    return q;
+}
+
+// Three link inverse kinematics: end of the last link at (x, y), last link
+// pointing at degree
+template <typename T>
+inline JointAngles<T> inverse_kinematics_3dof(const ArmGeometry<T>& arm, T x, T y, T degree)
+{
+    T rad = degree_to_rad(degree);
+    JointAngles<T> q = inverse_kinematics_2dof(arm, x - arm.l3 * std::cos(rad), y - arm.l3 * std::sin(rad));
+    q.degree3 = degree - (q.degree1 + q.degree2);
+    return q;
+}
+
+template <typename T>
+inline ArmPose<T> forward_kinematics(const ArmGeometry<T>& arm, const JointAngles<T>& q)
+{
+    T a1 = degree_to_rad(q.degree1);
+    T a12 = degree_to_rad(q.degree1 + q.degree2);
+
+    ArmPose<T> pose;
+    pose.x1 = arm.l1 * std::cos(a1);
+    pose.y1 = arm.l1 * std::sin(a1);
+    pose.x2 = pose.x1 + arm.l2 * std::cos(a12);
+    pose.y2 = pose.y1 + arm.l2 * std::sin(a12);
+    return pose;
+}
+
+// Inverse and forward kinematics of the 3 link arm in one go, for the per
+// sample path. Radians throughout; degrees only where the result is logged
+// or sent.
+template <typename T>
+struct ArmSolution
+{
+    //Joint angles in radians, q1 in (-pi, pi], q2 in [0, pi]
+    T q1, q2, q3;
+    //Elbow (x1, y1) and wrist (x2, y2), as forward_kinematics gives them
+    T x1, y1, x2, y2;
+};
+
+// End of the last link at (x, y), pointing at rad. Same solution as
+// inverse_kinematics_3dof followed by forward_kinematics, but with one sincos
+// (the end orientation) and one atan2 per joint: the shoulder angle is taken
+// as a single rotation instead of the difference of two atan2, and the joint
+// positions are built from the sines and cosines the solve already has.
+// Out of reach targets give NaN.
+template <typename T>
+inline ArmSolution<T> solve_arm(const ArmGeometry<T>& arm, T x, T y, T rad)
+{
+    T c = std::cos(rad);
+    T s = std::sin(rad);
+    T wx = x - arm.l3 * c;
+    T wy = y - arm.l3 * s;
+
+    T c2 = (wx * wx + wy * wy - arm.l1 * arm.l1 - arm.l2 * arm.l2) / (2 * arm.l1 * arm.l2);
+    T s2 = std::sqrt(1 - c2 * c2);
+
+    //Rotate the wrist direction back by the angle the elbow adds at the shoulder
+    T a = arm.l1 + arm.l2 * c2;
+    T b = arm.l2 * s2;
+    T u = wx * a + wy * b;
+    T v = wy * a - wx * b;
+    T r = std::sqrt(u * u + v * v);
+    T c1 = u / r;
+    T s1 = v / r;
+
+    ArmSolution<T> solution;
+    solution.q1 = std::atan2(v, u);
+    solution.q2 = std::atan2(s2, c2);
+    solution.q3 = rad - (solution.q1 + solution.q2);
+    solution.x1 = arm.l1 * c1;
+    solution.y1 = arm.l1 * s1;
+    solution.x2 = solution.x1 + arm.l2 * (c1 * c2 - s1 * s2);
+    solution.y2 = solution.y1 + arm.l2 * (s1 * c2 + c1 * s2);
+    return solution;
+}
+
+// solve_arm for a target that moves a little between calls, as it does
+// when the firmware reports every millisecond: instead of the closed form,
+// Newton steps through the arm's Jacobian from the previous solution.
+//
+// The end orientation fixes q3 = rad - q1 - q2, which leaves the 3x3
+// Jacobian block triangular; what is solved is its 2x2 wrist block
+//   [ -y2  -l2 s12 ] [dq1]   [wrist error x]
+//   [  x2   l2 c12 ] [dq2] = [wrist error y],   det = l1 l2 sin q2
+// The first guess turns the joints as much as over the previous sample.
+// Sines and cosines of the joint angles are carried along and rotated by
+// each step with a short series, so an incremental solve has no trig call.
+// Results match solve_arm to tolerance (in the unit of the link lengths).
+// It falls back to solve_arm, and counts that, when
+//   - there is no previous solution (first call, after Reset or a NaN)
+//   - sin q2 is below singularity, the arm is (nearly) stretched or folded
+//   - a step would move a joint by more than maxStep rad
+//   - the wrist is still further than tolerance off after the Newton steps
+//   - reanchorEvery incremental solves went by, which bounds how far the
+//     carried sines and cosines can drift from the angles
+template <typename T>
+class DifferentialArmSolver
+{
+public:
+    DifferentialArmSolver(const ArmGeometry<T>& arm, T tolerance = (T)1e-6, unsigned int reanchorEvery = 1024)
+        : arm(arm), tolerance(tolerance), singularity((T)0.05), maxStep((T)0.05), newtonSteps(2),
+        reanchorEvery(reanchorEvery), valid(false), sinceAnchor(0), closedForm(0), incremental(0)
+    {
+    }
+
+    //Forget the previous solution, the next Solve is a closed form one
+    void Reset() { valid = false; }
+
+    const ArmSolution<T>& Solve(T x, T y, T rad)
+    {
+        if (!valid || ++sinceAnchor >= reanchorEvery || !Step(x, y, rad))
+            Anchor(x, y, rad);
+        else
+            incremental++;
+        return solution;
+    }
+
+    unsigned long long ClosedFormSolves() const { return closedForm; }
+    unsigned long long IncrementalSolves() const { return incremental; }
+
+private:
+    void Anchor(T x, T y, T rad)
+    {
+        solution = solve_arm(arm, x, y, rad);
+        closedForm++;
+        sinceAnchor = 0;
+        phi = rad;
+        c123 = std::cos(rad);
+        s123 = std::sin(rad);
+        c1 = solution.x1 / arm.l1;
+        s1 = solution.y1 / arm.l1;
+        c12 = (solution.x2 - solution.x1) / arm.l2;
+        s12 = (solution.y2 - solution.y1) / arm.l2;
+        rc1 = rc12 = 1;
+        rs1 = rs12 = 0;
+        dq1Last = dq2Last = 0;
+        //NaN compares false, an unreachable target leaves no solution to start from
+        valid = solution.q1 == solution.q1 && solution.q2 == solution.q2;
+    }
+
+    //cos and sin of a small angle, good to 1e-13 up to maxStep
+    static void SmallRotation(T angle, T& c, T& s)
+    {
+        T a2 = angle * angle;
+        c = 1 - a2 / 2 * (1 - a2 / 12 * (1 - a2 / 30));
+        s = angle * (1 - a2 / 6 * (1 - a2 / 20 * (1 - a2 / 42)));
+    }
+
+    static void Rotate(T& c, T& s, T angle)
+    {
+        T dc, ds;
+        SmallRotation(angle, dc, ds);
+        T nc = c * dc - s * ds;
+        s = s * dc + c * ds;
+        c = nc;
+    }
+
+    bool Step(T x, T y, T rad)
+    {
+        T dPhi = rad - phi;
+        if (std::fabs(dPhi) > maxStep)
+            return false;
+        T nc123 = c123, ns123 = s123;
+        Rotate(nc123, ns123, dPhi);
+        T wx = x - arm.l3 * nc123;
+        T wy = y - arm.l3 * ns123;
+
+        //Predict that the joints turn as much as over the last sample, the
+        //Newton steps then only correct for the change in speed
+        T nc1 = c1 * rc1 - s1 * rs1, ns1 = s1 * rc1 + c1 * rs1;
+        T nc12 = c12 * rc12 - s12 * rs12, ns12 = s12 * rc12 + c12 * rs12;
+        T q1 = solution.q1 + dq1Last, q2 = solution.q2 + dq2Last;
+        //products of almost unit vectors, pull them back to length 1
+        //(one Newton step of 1/sqrt) or the error compounds sample after sample
+        T n1 = (3 - (nc1 * nc1 + ns1 * ns1)) / 2;
+        T n12 = (3 - (nc12 * nc12 + ns12 * ns12)) / 2;
+        nc1 *= n1;
+        ns1 *= n1;
+        nc12 *= n12;
+        ns12 *= n12;
+        T ex = 0, ey = 0;
+        for (int i = 0; i <= newtonSteps; i++)
+        {
+            T x1 = arm.l1 * nc1, y1 = arm.l1 * ns1;
+            T x2 = x1 + arm.l2 * nc12, y2 = y1 + arm.l2 * ns12;
+            ex = wx - x2;
+            ey = wy - y2;
+            if (i == newtonSteps || ex * ex + ey * ey <= tolerance * tolerance)
+                break;
+
+            T sin2 = nc1 * ns12 - ns1 * nc12;
+            if (std::fabs(sin2) < singularity)
+                return false;
+            T invDet = 1 / (arm.l1 * arm.l2 * sin2);
+            T dq1 = arm.l2 * (nc12 * ex + ns12 * ey) * invDet;
+            T dq2 = -(x2 * ex + y2 * ey) * invDet;
+            if (std::fabs(dq1) > maxStep || std::fabs(dq2) > maxStep)
+                return false;
+
+            Rotate(nc1, ns1, dq1);
+            Rotate(nc12, ns12, dq1 + dq2);
+            q1 += dq1;
+            q2 += dq2;
+        }
+        if (ex * ex + ey * ey > tolerance * tolerance)
+            return false;
+
+        //rotation from the previous to the new joint directions, next prediction
+        rc1 = nc1 * c1 + ns1 * s1;
+        rs1 = ns1 * c1 - nc1 * s1;
+        rc12 = nc12 * c12 + ns12 * s12;
+        rs12 = ns12 * c12 - nc12 * s12;
+        dq1Last = q1 - solution.q1;
+        dq2Last = q2 - solution.q2;
+
+        phi = rad;
+        c123 = nc123;
+        s123 = ns123;
+        c1 = nc1;
+        s1 = ns1;
+        c12 = nc12;
+        s12 = ns12;
+        //same range as solve_arm
+        const T pi = KinematicsConstants<T>::Pi();
+        if (q1 > pi)
+            q1 -= 2 * pi;
+        else if (q1 <= -pi)
+            q1 += 2 * pi;
+        solution.q1 = q1;
+        solution.q2 = q2;
+        solution.q3 = rad - (q1 + q2);
+        solution.x1 = arm.l1 * c1;
+        solution.y1 = arm.l1 * s1;
+        solution.x2 = solution.x1 + arm.l2 * c12;
+        solution.y2 = solution.y1 + arm.l2 * s12;
+        return true;
+    }
+
+    ArmGeometry<T> arm;
+    T tolerance;
+    T singularity;
+    T maxStep;
+    int newtonSteps;
+    unsigned int reanchorEvery;
+
+    bool valid;
+    unsigned int sinceAnchor;
+    ArmSolution<T> solution;
+    //end orientation and joint directions the solution was built from
+    T phi, c123, s123;
+    T c1, s1, c12, s12;
+    //how far the joints turned over the last incremental solve
+    T rc1, rs1, rc12, rs12;
+    T dq1Last, dq2Last;
+    unsigned long long closedForm;
+    unsigned long long incremental;
+};
+
+template <typename T>
+void inverse_kinematics_3dof_batch(const ArmGeometry<T>& arm, const T* x, const T* y, const T* degree, size_t count,
+    T* degree1, T* degree2, T* degree3)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        JointAngles<T> q = inverse_kinematics_3dof(arm, x[i], y[i], degree[i]);
+        degree1[i] = q.degree1;
+        degree2[i] = q.degree2;
+        degree3[i] = q.degree3;
+    }
+}
+
+template <typename T>
+void forward_kinematics_batch(const ArmGeometry<T>& arm, const T* degree1, const T* degree2, size_t count,
+    T* x1, T* y1, T* x2, T* y2)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        JointAngles<T> q = { degree1[i], degree2[i], 0 };
+        ArmPose<T> pose = forward_kinematics(arm, q);
+        x1[i] = pose.x1;
+        y1[i] = pose.y1;
+        x2[i] = pose.x2;
+        y2[i] = pose.y2;
+    }
+}
+
+template <typename T>
+void solve_arm_batch(const ArmGeometry<T>& arm, const T* x, const T* y, const T* rad, size_t count,
+    ArmSolution<T>* out)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = solve_arm(arm, x[i], y[i], rad[i]);
+}
+
+#endif // KINEMATICS_HPP_INCLUDED
@@ -0,0 +1,394 @@
+// Checks the fast paths of the per sample pipeline against the code they
+// replace: solve_arm and DifferentialArmSolver (kinematics.hpp) against
+// inverse_kinematics_3dof + forward_kinematics, FixedOdometry and every
+// SimdLevel of dead_reckon_batch against MouseOdometry<double>, over random
+// motion and the edge cases: stretched, folded and unreachable arms, clutch
+// resets, headings far past a turn, batches shorter than a vector. Prints
+// every failed check and returns 1 if there was one.
+//
+//   g++ -O2 -std=c++14 kinematics_test.cpp fixed_odometry.cpp odometry_batch.cpp simd_level.cpp -o kinematics_test
+//   ./kinematics_test
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "kinematics.hpp"
+#include "fixed_odometry.h"
+#include "odometry_batch.h"
+#include "tracker_config.h"
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                                   \
+    do                                                          \
+    {                                                           \
+        if (!(condition))                                       \
+        {                                                       \
+            failures++;                                         \
+            printf("FAILED %s:%d: %s: ", __FILE__, __LINE__, #condition); \
+            printf(__VA_ARGS__);                                \
+            printf("\n");                                       \
+        }                                                       \
+    } while (0)
+
+static const double PI = 3.14159265358979323846;
+
+//splitmix64, the same motion on every run
+static uint64_t random_state = 0x9E3779B97F4A7C15ull;
+
+static uint64_t next_random()
+{
+    uint64_t z = (random_state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+//Uniform in [low, high)
+static double random_real(double low, double high)
+{
+    return low + (high - low) * (double)(next_random() >> 11) / 9007199254740992.0;
+}
+
+//Uniform in [-limit, limit]
+static int random_count(int limit)
+{
+    return (int)(next_random() % (uint64_t)(2 * limit + 1)) - limit;
+}
+
+//Difference of two angles in radians, folded into [-pi, pi]
+static double angle_difference(double a, double b)
+{
+    return remainder(a - b, 2 * PI);
+}
+
+//End of the last link for joint angles in radians
+static void arm_end(double q1, double q2, double q3, double& x, double& y, double& rad)
+{
+    rad = q1 + q2 + q3;
+    x = ARM.l1 * cos(q1) + ARM.l2 * cos(q1 + q2) + ARM.l3 * cos(rad);
+    y = ARM.l1 * sin(q1) + ARM.l2 * sin(q1 + q2) + ARM.l3 * sin(rad);
+}
+
+//solve_arm and what it replaces for the same target, tolerance in link units and radians
+static void compare_solve_arm(double x, double y, double rad, double tolerance, const char* name)
+{
+    ArmSolution<double> fast = solve_arm(ARM, x, y, rad);
+    JointAngles<double> q = inverse_kinematics_3dof(ARM, x, y, rad_to_degree(rad));
+    ArmPose<double> pose = forward_kinematics(ARM, q);
+
+    double q1 = degree_to_rad(q.degree1), q2 = degree_to_rad(q.degree2), q3 = degree_to_rad(q.degree3);
+    CHECK(fabs(angle_difference(fast.q1, q1)) <= tolerance && fabs(angle_difference(fast.q2, q2)) <= tolerance
+        && fabs(angle_difference(fast.q3, q3)) <= tolerance,
+        "%s: joints %.12g %.12g %.12g, reference %.12g %.12g %.12g", name, fast.q1, fast.q2, fast.q3, q1, q2, q3);
+    CHECK(fabs(fast.x1 - pose.x1) <= tolerance && fabs(fast.y1 - pose.y1) <= tolerance
+        && fabs(fast.x2 - pose.x2) <= tolerance && fabs(fast.y2 - pose.y2) <= tolerance,
+        "%s: elbow (%.12g, %.12g) wrist (%.12g, %.12g), reference (%.12g, %.12g) (%.12g, %.12g)", name,
+        fast.x1, fast.y1, fast.x2, fast.y2, pose.x1, pose.y1, pose.x2, pose.y2);
+    CHECK(fast.q1 > -PI && fast.q1 <= PI && fast.q2 >= 0 && fast.q2 <= PI, "%s: joints %.12g %.12g out of range",
+        name, fast.q1, fast.q2);
+}
+
+static void test_solve_arm()
+{
+    char name[64];
+    for (int i = 0; i < 100000; i++)
+    {
+        double x, y, rad;
+        //elbow away from stretched and folded, there both solutions lose digits
+        arm_end(random_real(-PI, PI), random_real(0.01, PI - 0.01), random_real(-PI, PI), x, y, rad);
+        snprintf(name, sizeof(name), "target %d", i);
+        compare_solve_arm(x, y, rad, 1e-9, name);
+    }
+
+    //stretched and folded exactly: sin q2 is 0, the shoulder angle still defined
+    ArmSolution<double> stretched = solve_arm(ARM, ARM.l1 + ARM.l2 + ARM.l3, 0.0, 0.0);
+    CHECK(stretched.q1 == 0 && stretched.q2 == 0 && stretched.q3 == 0, "stretched: joints %g %g %g",
+        stretched.q1, stretched.q2, stretched.q3);
+    CHECK(stretched.x2 == ARM.l1 + ARM.l2 && stretched.y2 == 0, "stretched: wrist (%g, %g)", stretched.x2, stretched.y2);
+    compare_solve_arm(ARM.l1 + ARM.l2 + ARM.l3, 0.0, 0.0, 1e-9, "stretched");
+    ArmSolution<double> folded = solve_arm(ARM, ARM.l3 - (ARM.l2 - ARM.l1), 0.0, 0.0);
+    CHECK(folded.q1 == 0 && folded.q2 == PI, "folded: joints %.17g %.17g", folded.q1, folded.q2);
+    CHECK(fabs(folded.x2 - (ARM.l1 - ARM.l2)) <= 1e-12 && fabs(folded.y2) <= 1e-12, "folded: wrist (%g, %g)",
+        folded.x2, folded.y2);
+
+    //close to stretched the elbow angle is sqrt of a rounding error, the positions still agree
+    for (int i = 0; i < 10000; i++)
+    {
+        double x, y, rad;
+        arm_end(random_real(-PI, PI), random_real(1e-7, 1e-4), random_real(-PI, PI), x, y, rad);
+        snprintf(name, sizeof(name), "nearly stretched %d", i);
+        ArmSolution<double> fast = solve_arm(ARM, x, y, rad);
+        JointAngles<double> q = inverse_kinematics_3dof(ARM, x, y, rad_to_degree(rad));
+        ArmPose<double> pose = forward_kinematics(ARM, q);
+        //NaN in both when rounding puts the wrist a hair out of reach
+        if (fast.q2 != fast.q2 || q.degree2 != q.degree2)
+        {
+            CHECK(fast.q2 != fast.q2 && q.degree2 != q.degree2, "%s: only one of them out of reach", name);
+            continue;
+        }
+        CHECK(fabs(fast.x2 - pose.x2) <= 1e-6 && fabs(fast.y2 - pose.y2) <= 1e-6,
+            "%s: wrist (%.12g, %.12g), reference (%.12g, %.12g)", name, fast.x2, fast.y2, pose.x2, pose.y2);
+    }
+
+    //out of reach on either side gives NaN, in both
+    const double reach[] = { ARM.l1 + ARM.l2 + 1e-6, ARM.l1 + ARM.l2 + 10, ARM.l2 - ARM.l1 - 1e-6, 0 };
+    for (size_t i = 0; i < sizeof(reach) / sizeof(reach[0]); i++)
+    {
+        double rad = random_real(-PI, PI), direction = random_real(-PI, PI);
+        double x = reach[i] * cos(direction) + ARM.l3 * cos(rad), y = reach[i] * sin(direction) + ARM.l3 * sin(rad);
+        ArmSolution<double> fast = solve_arm(ARM, x, y, rad);
+        JointAngles<double> q = inverse_kinematics_3dof(ARM, x, y, rad_to_degree(rad));
+        CHECK(fast.q2 != fast.q2 && fast.x2 != fast.x2, "wrist %g from the shoulder: q2 %g", reach[i], fast.q2);
+        CHECK(q.degree2 != q.degree2, "wrist %g from the shoulder: reference q2 %g", reach[i], q.degree2);
+    }
+
+    std::vector<double> x(100), y(100), rad(100);
+    std::vector<ArmSolution<double> > batch(100);
+    for (size_t i = 0; i < x.size(); i++)
+        arm_end(random_real(-PI, PI), random_real(0.01, PI - 0.01), random_real(-PI, PI), x[i], y[i], rad[i]);
+    solve_arm_batch(ARM, x.data(), y.data(), rad.data(), x.size(), batch.data());
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        ArmSolution<double> single = solve_arm(ARM, x[i], y[i], rad[i]);
+        CHECK(batch[i].q1 == single.q1 && batch[i].q2 == single.q2 && batch[i].x2 == single.x2,
+            "batch sample %zu differs from the single sample form", i);
+    }
+}
+
+//DifferentialArmSolver along a path against solve_arm at every sample
+static void follow_path(DifferentialArmSolver<double>& solver, const std::vector<double>& x,
+    const std::vector<double>& y, const std::vector<double>& rad, const char* name)
+{
+    //the solver's wrist tolerance, the angles follow from it over the link lengths
+    const double tolerance = 1e-5;
+    int reported = 0;
+    for (size_t i = 0; i < x.size(); i++)
+    {
+        const ArmSolution<double>& fast = solver.Solve(x[i], y[i], rad[i]);
+        ArmSolution<double> reference = solve_arm(ARM, x[i], y[i], rad[i]);
+        bool reachable = reference.q2 == reference.q2;
+        //a hair out of reach the Newton steps may still land within
+        //tolerance where the closed form gives NaN
+        double endX = fast.x2 + ARM.l3 * cos(rad[i]), endY = fast.y2 + ARM.l3 * sin(rad[i]);
+        bool ok = reachable
+            ? fabs(angle_difference(fast.q1, reference.q1)) <= tolerance
+                && fabs(fast.q2 - reference.q2) <= tolerance
+                && fabs(angle_difference(fast.q3, reference.q3)) <= tolerance
+                && fabs(fast.x1 - reference.x1) <= tolerance && fabs(fast.y1 - reference.y1) <= tolerance
+                && fabs(fast.x2 - reference.x2) <= tolerance && fabs(fast.y2 - reference.y2) <= tolerance
+                && fast.q1 > -PI && fast.q1 <= PI
+            : fast.q2 != fast.q2 || hypot(endX - x[i], endY - y[i]) <= tolerance;
+        //one line per path is enough to see what went wrong
+        if (!ok && reported++ == 0)
+            CHECK(ok, "%s, sample %zu: joints %.12g %.12g %.12g wrist (%.12g, %.12g), solve_arm %.12g %.12g %.12g "
+                "(%.12g, %.12g)", name, i, fast.q1, fast.q2, fast.q3, fast.x2, fast.y2,
+                reference.q1, reference.q2, reference.q3, reference.x2, reference.y2);
+    }
+    CHECK(reported == 0, "%s: %d samples off", name, reported);
+}
+
+static void test_differential_solver()
+{
+    //smooth motion at the firmware's rate, joints turning up to a few
+    //degrees per sample and accelerating, past the reanchoring interval
+    const size_t n = 20000;
+    std::vector<double> x(n), y(n), rad(n);
+    double q1 = 0.3, q2 = 1.2, q3 = -0.5, w1 = 0, w2 = 0, w3 = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        w1 = 0.99 * w1 + random_real(-2e-3, 2e-3);
+        w2 = 0.99 * w2 + random_real(-2e-3, 2e-3);
+        w3 = 0.99 * w3 + random_real(-2e-3, 2e-3);
+        q1 += w1;
+        q2 += w2;
+        q3 += w3;
+        //keep the elbow bent, q1 wanders past +-pi
+        if (q2 < 0.2 || q2 > PI - 0.2)
+        {
+            w2 = -w2;
+            q2 += 2 * w2;
+        }
+        arm_end(q1, q2, q3, x[i], y[i], rad[i]);
+    }
+    DifferentialArmSolver<double> solver(ARM);
+    follow_path(solver, x, y, rad, "smooth path");
+    CHECK(solver.IncrementalSolves() > n * 9 / 10, "smooth path: only %llu of %zu solves incremental",
+        solver.IncrementalSolves(), n);
+
+    //the same path with jumps (clutch), an unreachable stretch and a pass
+    //through stretched, where the solver has to fall back to the closed form
+    for (size_t i = 1000; i < 1100; i++)
+    {
+        x[i] *= 3;
+        y[i] *= 3;
+    }
+    for (size_t i = 5000; i < n; i += 3000)
+        rad[i] += 1;
+    for (size_t i = 8000; i < 8400; i++)
+    {
+        double t = (i - 8000) / 400.0;
+        arm_end(0.7, 0.3 * fabs(1 - 2 * t), 0.1, x[i], y[i], rad[i]);
+    }
+    DifferentialArmSolver<double> fallback(ARM);
+    follow_path(fallback, x, y, rad, "path with jumps");
+    CHECK(fallback.ClosedFormSolves() > 100, "path with jumps: only %llu closed form solves", fallback.ClosedFormSolves());
+
+    //after Reset the next solve starts over from the closed form
+    unsigned long long before = fallback.ClosedFormSolves();
+    fallback.Reset();
+    fallback.Solve(x[0], y[0], rad[0]);
+    CHECK(fallback.ClosedFormSolves() == before + 1, "Reset: next solve not closed form");
+}
+
+struct Deltas
+{
+    std::vector<int> dx1, dy1, dx2;
+};
+
+//Hand motion: counts up to limit per sample, the two x counts close to each
+//other so the heading turns slowly
+static Deltas random_deltas(size_t count, int limit)
+{
+    Deltas d;
+    for (size_t i = 0; i < count; i++)
+    {
+        int dx = random_count(limit);
+        d.dx1.push_back(dx + random_count(limit / 8));
+        d.dy1.push_back(random_count(limit));
+        d.dx2.push_back(dx + random_count(limit / 8));
+    }
+    return d;
+}
+
+static void test_fixed_odometry()
+{
+    const size_t n = 200000;
+    Deltas d = random_deltas(n, 40);
+    MouseOdometry<double> reference(CPI, D, ARM.l1, ARM.l2 + ARM.l3);
+    FixedOdometry fixed(CPI, D, ARM.l1, ARM.l2 + ARM.l3);
+    double travelled = 0;
+    int reported = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        //a clutch now and then puts both back to the start, like Code.cpp does
+        if (i % 50000 == 25000)
+        {
+            reference.Reset(ARM.l1, ARM.l2 + ARM.l3);
+            fixed.Reset(ARM.l1, ARM.l2 + ARM.l3);
+            travelled = 0;
+        }
+        reference.Update(d.dx1[i], d.dy1[i], d.dx2[i], 0);
+        fixed.Update(d.dx1[i], d.dy1[i], d.dx2[i], 0);
+        travelled += hypot(d.dx1[i], d.dy1[i]) / CPI;
+        double error = hypot(fixed.X() - reference.X(), fixed.Y() - reference.Y());
+        double thetaError = fabs(fixed.Theta() - reference.Theta());
+        if ((error > 1e-8 * travelled + 1e-9 || thetaError > 1e-9) && reported++ == 0)
+            CHECK(false, "sample %zu: (%.12g, %.12g) %.12g, MouseOdometry (%.12g, %.12g) %.12g after %g inch", i,
+                fixed.X(), fixed.Y(), fixed.Theta(), reference.X(), reference.Y(), reference.Theta(), travelled);
+    }
+    CHECK(reported == 0, "random motion: %d samples off", reported);
+
+    //a reset to any heading, negative ones and ones of many turns included
+    const double thetas[] = { -90, 33.3, -1e5 - 0.25, 7e6 + 45 };
+    for (size_t t = 0; t < sizeof(thetas) / sizeof(thetas[0]); t++)
+    {
+        reference.Reset(1, 2, thetas[t]);
+        fixed.Reset(1, 2, thetas[t]);
+        for (size_t i = 0; i < 1000; i++)
+        {
+            reference.Update(d.dx1[i], d.dy1[i], d.dx2[i], 0);
+            fixed.Update(d.dx1[i], d.dy1[i], d.dx2[i], 0);
+        }
+        double error = hypot(fixed.X() - reference.X(), fixed.Y() - reference.Y());
+        CHECK(error <= 1e-7, "reset to %g degrees: (%.12g, %.12g), MouseOdometry (%.12g, %.12g)", thetas[t],
+            fixed.X(), fixed.Y(), reference.X(), reference.Y());
+    }
+
+    //spinning on the spot both ways until the table phase has wrapped
+    //2^64 (2^18 turns). Summed in double the heading is off by degrees by
+    //then, so every step is compared with one MouseOdometry step from the
+    //exact heading instead. The table step per count is rounded to 1 in
+    //~1e9, so the sines drift by that much of the heading in radians: 5e-4
+    //after 2^18 turns, nothing a jump at the wrap could hide in.
+    const double degreePerCount = 180 / (PI * D * CPI);
+    for (int sign = -1; sign <= 1; sign += 2)
+    {
+        const int spin = 1500 * sign;
+        FixedOdometry spinFixed(CPI, D, 0, 0);
+        const int64_t wrapHeading = (int64_t)(262144 * 360 / degreePerCount) + 4 * spin * sign;
+        double worst = 0;
+        const double stepLength = hypot(spin, spin / 3) / CPI;
+        while (spinFixed.RawHeading() * sign < wrapHeading)
+        {
+            MouseOdometry<double> step(CPI, D, 0, 0, (double)spinFixed.RawHeading() * degreePerCount);
+            double fx = spinFixed.X(), fy = spinFixed.Y();
+            step.Update(spin, spin / 3, spin, 0);
+            spinFixed.Update(spin, spin / 3, spin, 0);
+            double error = hypot(spinFixed.X() - fx - step.X(), spinFixed.Y() - fy - step.Y());
+            //the sine table interpolates to ~2e-8
+            double drift = 1e-9 * fabs(degree_to_rad(step.Theta()));
+            error /= stepLength * (2e-8 + drift);
+            if (error > worst)
+                worst = error;
+        }
+        CHECK(worst <= 1, "spinning %s: a step off by %g times the tolerance", sign > 0 ? "left" : "right", worst);
+    }
+}
+
+static void test_odometry_batch()
+{
+    //empty, shorter than a vector, one and a bit of each width, a pass of
+    //1024 samples and the blocks after it
+    const size_t lengths[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 17, 1023, 1024, 1025, 5000 };
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+    {
+        const size_t n = lengths[l];
+        Deltas d = random_deltas(n, 60);
+        std::vector<double> rx(n), ry(n), rt(n);
+        MouseOdometry<double> reference(CPI, D, 1.5, -2, 30);
+        for (size_t i = 0; i < n; i++)
+        {
+            reference.Update(d.dx1[i], d.dy1[i], d.dx2[i], 0);
+            rx[i] = reference.X();
+            ry[i] = reference.Y();
+            rt[i] = reference.Theta();
+        }
+
+        for (int level = 0; level <= (int)simd_level_best(); level++)
+        {
+            //a guard value after the end catches a kernel writing past count
+            std::vector<double> x(n + 1, 12345), y(n + 1, 12345), theta(n + 1, 12345);
+            dead_reckon_batch(d.dx1.data(), d.dy1.data(), d.dx2.data(), n, CPI, D, 1.5, -2, 30,
+                x.data(), y.data(), theta.data(), (SimdLevel)level);
+            size_t bad = n;
+            for (size_t i = 0; i < n && bad == n; i++)
+            {
+                if (fabs(x[i] - rx[i]) > 1e-9 || fabs(y[i] - ry[i]) > 1e-9 || fabs(theta[i] - rt[i]) > 1e-9)
+                    bad = i;
+            }
+            CHECK(bad == n, "%zu samples, %s: sample %zu (%.15g, %.15g) %.15g, MouseOdometry (%.15g, %.15g) %.15g",
+                n, simd_level_name((SimdLevel)level), bad, x[bad], y[bad], theta[bad], rx[bad], ry[bad], rt[bad]);
+            CHECK(x[n] == 12345 && y[n] == 12345 && theta[n] == 12345, "%zu samples, %s: wrote past the end",
+                n, simd_level_name((SimdLevel)level));
+        }
+    }
+}
+
+int main()
+{
+    test_solve_arm();
+    test_differential_solver();
+    test_fixed_odometry();
+    test_odometry_batch();
+
+    if (failures > 0)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed (%s)\n", simd_level_name(simd_level_best()));
+    return 0;
+}
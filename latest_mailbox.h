@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Single slot hand over from one producer thread to one consumer thread
+// that only ever wants the newest value (a triple buffer). Post never
+// blocks and never fails: a value the consumer has not taken yet is
+// replaced, and counted as coalesced. Take returns each posted value at
+// most once. Neither side waits for the other, both only copy T and swap
+// one index, so T has to be trivially copyable.
+template <typename T>
+class LatestMailbox
+{
+public:
+    LatestMailbox()
+        : back(0), front(1), middle(2), posted(0), coalesced(0)
+    {
+    }
+
+    //Producer side
+    void Post(const T& value)
+    {
+        slots[back] = value;
+        const unsigned previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = previous & INDEX;
+        posted.store(posted.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (previous & FRESH)
+            coalesced.store(coalesced.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    //Consumer side: newest value posted since the last Take, false if none
+    bool Take(T& value)
+    {
+        if (!HasNew())
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & INDEX;
+        value = slots[front];
+        return true;
+    }
+
+    bool HasNew() const { return (middle.load(std::memory_order_acquire) & FRESH) != 0; }
+
+    //Values posted, and values replaced before the consumer took them
+    uint64_t Posted() const { return posted.load(std::memory_order_relaxed); }
+    uint64_t Coalesced() const { return coalesced.load(std::memory_order_relaxed); }
+
+private:
+    static const unsigned INDEX = 3;
+    static const unsigned FRESH = 4;
+
+    T slots[3];
+    //slot the producer writes next, only touched by the producer
+    unsigned back;
+    //slot the consumer read last, only touched by the consumer
+    unsigned front;
+    //the slot in between, FRESH when it holds a value not taken yet
+    std::atomic<unsigned> middle;
+    std::atomic<uint64_t> posted;
+    std::atomic<uint64_t> coalesced;
+};
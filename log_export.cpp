@@ -0,0 +1,173 @@
+// Writes a stream_log.h file (rawdata/mouse.bin, myoarmband.bin,
+// motion_capture.bin) as CSV, with the columns the CSV loggers wrote (the
+// mouse log has sampleTime after them, like its CSV, then the sensor counts
+// and deviceTime), so analysis scripts keep reading what they always read.
+//
+//   g++ -O2 -std=c++17 log_export.cpp stream_log.cpp delta_codec.cpp -o log_export
+//   ./log_export file.bin [-o file.csv] [--from t] [--to t] [--header] [--raw] [--schema]
+//
+// -o        write to a file instead of stdout
+// --from/to only records with the time field in [from, to], in the unit the
+//           file stores it in (see --schema); chunks outside are not read
+// --header  first line with the field names
+// --raw     fields stored in ns as they are; by default they are written
+//           in ms like the CSV loggers did
+// --schema  print the stream name, fields, types, units and chunk time
+//           ranges instead of the records
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <charconv>
+#endif
+
+#include "stream_log.h"
+
+static char* put_integer(char* out, long long value)
+{
+#if defined(__cpp_lib_to_chars)
+    return std::to_chars(out, out + 32, value).ptr;
+#else
+    return out + snprintf(out, 32, "%lld", value);
+#endif
+}
+
+//Shortest text that reads back as the same float or double
+static char* put_real(char* out, double value, bool single)
+{
+#if defined(__cpp_lib_to_chars)
+    if (single)
+        return std::to_chars(out, out + 32, (float)value).ptr;
+    return std::to_chars(out, out + 32, value).ptr;
+#else
+    return out + snprintf(out, 32, single ? "%.9g" : "%.17g", value);
+#endif
+}
+
+static void print_schema(StreamLogReader& reader)
+{
+    const std::vector<StreamLogReader::Field>& fields = reader.Fields();
+    printf("stream %s, time field %s\n", reader.Name().c_str(), fields[reader.TimeField()].name.c_str());
+    for (size_t i = 0; i < fields.size(); i++)
+        printf("  %-14s %-6s %s\n", fields[i].name.c_str(), field_type_name(fields[i].type), fields[i].unit.c_str());
+
+    unsigned long long chunks = 0, records = 0;
+    while (reader.NextChunk())
+    {
+        printf("  chunk %llu: %zu records, time %lld .. %lld\n", chunks, reader.Records(), reader.FirstTime(), reader.LastTime());
+        chunks++;
+        records += reader.Records();
+    }
+    printf("%llu records in %llu chunks\n", records, chunks);
+}
+
+int main(int argc, char* argv[])
+{
+    const char* inPath = nullptr;
+    const char* outPath = nullptr;
+    long long from = INT64_MIN, to = INT64_MAX;
+    bool header = false, raw = false, schema = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outPath = argv[++i];
+        else if (strcmp(argv[i], "--from") == 0 && i + 1 < argc)
+            from = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc)
+            to = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--header") == 0)
+            header = true;
+        else if (strcmp(argv[i], "--raw") == 0)
+            raw = true;
+        else if (strcmp(argv[i], "--schema") == 0)
+            schema = true;
+        else
+            inPath = argv[i];
+    }
+    if (inPath == nullptr)
+    {
+        fprintf(stderr, "usage: %s file.bin [-o file.csv] [--from t] [--to t] [--header] [--raw] [--schema]\n", argv[0]);
+        return 1;
+    }
+
+    StreamLogReader reader;
+    if (!reader.Open(inPath))
+    {
+        fprintf(stderr, "%s is not a stream log\n", inPath);
+        return 1;
+    }
+    if (schema)
+    {
+        print_schema(reader);
+        return 0;
+    }
+
+    FILE* out = outPath ? fopen(outPath, "wb") : stdout;
+    if (out == nullptr)
+    {
+        fprintf(stderr, "can't write %s\n", outPath);
+        return 1;
+    }
+
+    const std::vector<StreamLogReader::Field>& fields = reader.Fields();
+    const size_t timeField = reader.TimeField();
+    std::vector<bool> nsToMs(fields.size());
+    for (size_t i = 0; i < fields.size(); i++)
+        nsToMs[i] = !raw && fields[i].unit == "ns";
+
+    if (header)
+    {
+        for (size_t i = 0; i < fields.size(); i++)
+            fprintf(out, "%s%s", i ? "," : "", fields[i].name.c_str());
+        fprintf(out, "\n");
+    }
+
+    std::vector<char> line;
+    while (reader.NextChunk(from, to))
+    {
+        for (size_t row = 0; row < reader.Records(); row++)
+        {
+            long long time = reader.Integer(timeField, row);
+            if (time < from || time > to)
+                continue;
+
+            line.resize(64);
+            size_t used = 0;
+            for (size_t i = 0; i < fields.size(); i++)
+            {
+                size_t count = 1;
+                const double* elements = nullptr;
+                if (fields[i].type == FieldType::Float64Array)
+                    elements = reader.Array(i, row, count);
+                if (line.size() < used + 33 * (count + 1))
+                    line.resize(used + 33 * (count + 1) + 64);
+
+                char* p = line.data() + used;
+                for (size_t k = 0; k < count; k++)
+                {
+                    if (i > 0 || k > 0)
+                        *p++ = ',';
+                    if (elements != nullptr)
+                        p = put_real(p, elements[k], false);
+                    else if (nsToMs[i])
+                        p = put_real(p, reader.Integer(i, row) / 1e6, false);
+                    else if (fields[i].type == FieldType::Float32 || fields[i].type == FieldType::Float64)
+                        p = put_real(p, reader.Real(i, row), fields[i].type == FieldType::Float32);
+                    else
+                        p = put_integer(p, reader.Integer(i, row));
+                }
+                used = p - line.data();
+            }
+            line[used++] = '\n';
+            fwrite(line.data(), 1, used, out);
+        }
+    }
+
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,283 @@
+#include "log_sink.h"
+
+#include <string.h>
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool FileSink::Open(const char* path)
+{
+    Close();
+    file = fopen(path, "wb");
+    if (file == nullptr)
+        return false;
+    //chunks come in 1MB at a time, a second copy through stdio's buffer buys nothing
+    setvbuf(file, nullptr, _IONBF, 0);
+    return true;
+}
+
+void FileSink::Close()
+{
+    if (file == nullptr)
+        return;
+    fclose(file);
+    file = nullptr;
+}
+
+bool FileSink::Write(const char* data, size_t size)
+{
+    return file != nullptr && fwrite(data, 1, size, file) == size;
+}
+
+bool FileSink::Flush()
+{
+    return file != nullptr && fflush(file) == 0;
+}
+
+MmapSink::MmapSink(uint64_t extentBytes, size_t windowBytes)
+    : extentBytes(extentBytes), windowBytes(windowBytes), pageBytes(1), written(0), allocated(0), windowStart(0),
+    synced(0), view(nullptr)
+{
+#ifdef _WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#else
+    file = -1;
+#endif
+}
+
+#ifdef _WIN32
+
+bool MmapSink::IsOpen() const
+{
+    return file != INVALID_HANDLE_VALUE;
+}
+
+bool MmapSink::Open(const char* path)
+{
+    Close();
+    file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    pageBytes = info.dwAllocationGranularity;
+    return Start();
+}
+
+static bool set_file_size(HANDLE file, uint64_t size)
+{
+    LARGE_INTEGER end;
+    end.QuadPart = (LONGLONG)size;
+    return SetFilePointerEx(file, end, NULL, FILE_BEGIN) && SetEndOfFile(file);
+}
+
+void MmapSink::Close()
+{
+    if (!IsOpen())
+        return;
+    UnmapWindow();
+    set_file_size(file, written);
+    CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+}
+
+bool MmapSink::Extend(uint64_t size)
+{
+    uint64_t target = allocated;
+    while (target < size)
+        target += extentBytes;
+    if (target == allocated)
+        return true;
+    if (!set_file_size(file, target))
+        return false;
+    allocated = target;
+    return true;
+}
+
+bool MmapSink::MapWindow(uint64_t offset)
+{
+    UnmapWindow();
+    uint64_t start = offset / windowBytes * windowBytes;
+    if (!Extend(start + windowBytes))
+        return false;
+    //a mapping can't outgrow the file it was created for, so one per window
+    mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, (DWORD)(allocated >> 32), (DWORD)allocated, NULL);
+    if (mapping == NULL)
+        return false;
+    view = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_WRITE, (DWORD)(start >> 32), (DWORD)start, windowBytes));
+    if (view == nullptr)
+    {
+        CloseHandle(mapping);
+        mapping = NULL;
+        return false;
+    }
+    windowStart = start;
+    synced = (size_t)(offset - start);
+    return true;
+}
+
+void MmapSink::UnmapWindow()
+{
+    if (view == nullptr)
+        return;
+    SyncWindow();
+    UnmapViewOfFile(view);
+    CloseHandle(mapping);
+    view = nullptr;
+    mapping = NULL;
+}
+
+bool MmapSink::SyncWindow()
+{
+    size_t end = (size_t)(written - windowStart);
+    if (view == nullptr || end <= synced)
+        return true;
+    //returns once the writes are queued, not when they reached the disk
+    bool ok = FlushViewOfFile(view + synced, end - synced) != 0;
+    synced = end;
+    return ok;
+}
+
+#else
+
+bool MmapSink::IsOpen() const
+{
+    return file >= 0;
+}
+
+bool MmapSink::Open(const char* path)
+{
+    Close();
+    file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (file < 0)
+        return false;
+    pageBytes = (size_t)sysconf(_SC_PAGESIZE);
+    return Start();
+}
+
+void MmapSink::Close()
+{
+    if (!IsOpen())
+        return;
+    UnmapWindow();
+    if (ftruncate(file, (off_t)written) != 0)
+        perror("MmapSink: trimming the preallocated file");
+    close(file);
+    file = -1;
+}
+
+bool MmapSink::Extend(uint64_t size)
+{
+    uint64_t target = allocated;
+    while (target < size)
+        target += extentBytes;
+    if (target == allocated)
+        return true;
+#ifdef __linux__
+    //reserves the blocks; file systems without it (some network ones) get a
+    //sparse file like everywhere else
+    if (fallocate(file, 0, (off_t)allocated, (off_t)(target - allocated)) != 0
+        && (errno != EOPNOTSUPP || ftruncate(file, (off_t)target) != 0))
+        return false;
+#else
+    if (ftruncate(file, (off_t)target) != 0)
+        return false;
+#endif
+    allocated = target;
+    return true;
+}
+
+bool MmapSink::MapWindow(uint64_t offset)
+{
+    UnmapWindow();
+    uint64_t start = offset / windowBytes * windowBytes;
+    if (!Extend(start + windowBytes))
+        return false;
+    void* p = mmap(nullptr, windowBytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, (off_t)start);
+    if (p == MAP_FAILED)
+        return false;
+    view = static_cast<char*>(p);
+    windowStart = start;
+    synced = (size_t)(offset - start);
+    return true;
+}
+
+void MmapSink::UnmapWindow()
+{
+    if (view == nullptr)
+        return;
+    SyncWindow();
+    munmap(view, windowBytes);
+    view = nullptr;
+}
+
+bool MmapSink::SyncWindow()
+{
+    size_t end = (size_t)(written - windowStart);
+    if (view == nullptr || end <= synced)
+        return true;
+    //msync wants a page aligned start
+    size_t from = synced / pageBytes * pageBytes;
+    bool ok = msync(view + from, end - from, MS_ASYNC) == 0;
+    synced = end;
+    return ok;
+}
+
+#endif
+
+//Common part of Open once the file is there
+bool MmapSink::Start()
+{
+    windowBytes = (windowBytes + pageBytes - 1) / pageBytes * pageBytes;
+    if (extentBytes < windowBytes)
+        extentBytes = windowBytes;
+    written = allocated = windowStart = 0;
+    synced = 0;
+    if (MapWindow(0))
+        return true;
+    Close();
+    return false;
+}
+
+bool MmapSink::Write(const char* data, size_t size)
+{
+    if (!IsOpen())
+        return false;
+    while (size > 0)
+    {
+        if (view == nullptr || written == windowStart + windowBytes)
+            if (!MapWindow(written))
+                return false;
+        size_t at = (size_t)(written - windowStart);
+        size_t n = size < windowBytes - at ? size : windowBytes - at;
+        memcpy(view + at, data, n);
+        data += n;
+        size -= n;
+        written += n;
+    }
+    return true;
+}
+
+bool MmapSink::Flush()
+{
+    return IsOpen() && SyncWindow();
+}
+
+std::unique_ptr<LogSink> open_log_sink(const char* path, bool mapped)
+{
+    if (mapped)
+    {
+        std::unique_ptr<MmapSink> sink(new MmapSink());
+        if (!sink->Open(path))
+            return nullptr;
+        return sink;
+    }
+    std::unique_ptr<FileSink> sink(new FileSink());
+    if (!sink->Open(path))
+        return nullptr;
+    return sink;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Where a logger's bytes end up. AsyncLogger only calls it from its
+// background thread, with large chunks, so implementations need no locking
+// and no buffering of their own.
+class LogSink
+{
+public:
+    virtual ~LogSink() {}
+
+    //All of data, false on an error
+    virtual bool Write(const char* data, size_t size) = 0;
+    //Hand what was written so far to the OS (not necessarily the disk)
+    virtual bool Flush() = 0;
+};
+
+// A plain file, written through stdio without its buffer
+class FileSink : public LogSink
+{
+public:
+    FileSink() : file(nullptr) {}
+    ~FileSink() override { Close(); }
+
+    //Truncates an existing file
+    bool Open(const char* path);
+    bool IsOpen() const { return file != nullptr; }
+    void Close();
+
+    bool Write(const char* data, size_t size) override;
+    bool Flush() override;
+
+private:
+    FILE* file;
+};
+
+// A file written through a memory mapping, for sessions of hours. The file
+// is preallocated extentBytes at a time (fallocate on Linux, so the blocks
+// are reserved in large contiguous runs and a full disk shows up as a failed
+// Write instead of a fault), and written by copying into a windowBytes view
+// that slides along it; only moving the window and growing the file are
+// syscalls. Flush starts writeback of what was copied since the last one
+// (msync MS_ASYNC, FlushViewOfFile) without waiting for it. Close (or the
+// destructor) trims the file to what was written; every log of a session is
+// closed before the process ends (session_stop.h for the Myo and Motive
+// threads). Only after a crash does the file end in zeros up to the extent,
+// which a stream_log.h reader stops at.
+class MmapSink : public LogSink
+{
+public:
+    explicit MmapSink(uint64_t extentBytes = 64 << 20, size_t windowBytes = 16 << 20);
+    ~MmapSink() override { Close(); }
+
+    //Truncates an existing file
+    bool Open(const char* path);
+    bool IsOpen() const;
+    void Close();
+
+    bool Write(const char* data, size_t size) override;
+    bool Flush() override;
+
+private:
+    //Map the window holding offset, growing the file to cover it
+    bool MapWindow(uint64_t offset);
+    void UnmapWindow();
+    //Start writeback of the window's bytes since the last call
+    bool SyncWindow();
+    bool Extend(uint64_t size);
+    bool Start();
+
+    uint64_t extentBytes;
+    size_t windowBytes;
+    //mmap offsets are multiples of this
+    size_t pageBytes;
+    //bytes written, bytes the file has, start of the window in the file
+    uint64_t written, allocated, windowStart;
+    //within the window: up to where writeback was started
+    size_t synced;
+    char* view;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#else
+    int file;
+#endif
+};
+
+//MmapSink when mapped, FileSink otherwise; nullptr if path can't be opened
+std::unique_ptr<LogSink> open_log_sink(const char* path, bool mapped);
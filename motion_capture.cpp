@@ -2,7 +2,6 @@
 // Motive API: Marker Tracking
 //======================================================================================================
 
-#include <conio.h>
 #include <thread>
 #include <mutex>
 
@@ -15,9 +14,17 @@
 
 // write .csv file
 #include <fstream>
+#include <algorithm>
 #include <string>
+#include <vector>
 
 #include "motion_capture.h"
+#include "record_format.h"
+#include "async_logger.h"
+#include "log_sink.h"
+#include "stream_log.h"
+#include "session_clock.h"
+#include "session_stop.h"
 
 
 using namespace std::chrono_literals;
@@ -32,6 +39,8 @@ const float kRadToDeg = 0.0174532925f;
 
 // write to a CSV file
 std::ofstream ofile;
+// BINARY_LOGS: frames go to this logger instead of ofile
+static AsyncLogger<MarkerFrame>* markerLog = nullptr;
 
 
 // Local class definitions
@@ -143,8 +152,6 @@ private:
 //int main( int argc, char* argv[] )
 int logMotive()
 {
-    ofile.open("rawdata/motion_capture.csv");
-
     const wchar_t* calibrationFile = L"C:\\ProgramData\\OptiTrack\\Motive\\System Calibration.cal";
     const wchar_t* profileFile = L"C:\\ProgramData\\OptiTrack\\MotiveProfile.motive";
 
@@ -180,7 +187,7 @@ int logMotive()
         TT_Update();
         std::this_thread::sleep_for( 20ms );
 
-    } while( TT_CameraCount() < cameraCount );
+    } while( TT_CameraCount() < cameraCount && !session_stop().Requested() );
 
     // List all connected cameras
     printf( "Cameras:\n" );
@@ -208,15 +215,44 @@ int logMotive()
 
     TT_FlushCameraQueues();
 
+    // The log is opened last, the ways out above have nothing to close.
+    // main waits for it to be closed before the process ends (SessionStop).
+    if( !session_stop().BeginLog() )
+    {
+        TT_DetachListener();
+        TT_Shutdown();
+        return 0;
+    }
+    std::unique_ptr<LogSink> logFile;
+    StreamLogEncoder<MarkerFrame> encoder(marker_schema());
+    std::unique_ptr<AsyncLogger<MarkerFrame> > logger;
+    if (BINARY_LOGS)
+    {
+        logFile = open_log_sink("rawdata/motion_capture.bin", MMAP_LOGS);
+        if (!logFile)
+        {
+            printf("Unable to open rawdata/motion_capture.bin\n");
+            session_stop().EndLog();
+            TT_DetachListener();
+            TT_Shutdown();
+            return 1;
+        }
+        logger.reset(new AsyncLogger<MarkerFrame>(*logFile, encoder, LOG_FLUSH_MS));
+        logger->Start();
+        markerLog = logger.get();
+    }
+    else
+        ofile.open("rawdata/motion_capture.csv");
+
     int frameCounter = 0;
-    bool running = true;
     
     //////////////////////////////////////////////////////////////////////////////
-    // CSV header
+    // CSV header, the binary log describes itself
 
-    ofile << "frame#, time, ";
+    if (!BINARY_LOGS)
+        ofile << "frame#, time, ";
 
-    for (int i = 1; i < 6; i++) {
+    for (int i = 1; i < 6 && !BINARY_LOGS; i++) {
         if (i < 5) {
             ofile << "Marker" << i << "_x, " << "Marker" << i << "_y, " << "Marker" << i << "_z, ";
         }
@@ -230,9 +266,9 @@ int logMotive()
 
 
 
-    // Process API data until the user hits a keyboard key.
+    // Process API data until main ends the session.
 
-    while( running )
+    while( !session_stop().Requested() )
     {
         // Blocks and waits for the next available frame.
         // TT_Update or TT_UpdateSingleFrame must be called in order to access the frame.
@@ -254,6 +290,13 @@ int logMotive()
         }
     }
 
+    // Rows still queued go out, the file is trimmed and closed
+    markerLog = nullptr;
+    logger.reset();
+    logFile.reset();
+    ofile.close();
+    session_stop().EndLog();
+
     // Save any changes
     CheckResult( TT_SaveProfile( profileFile ) );
     CheckResult( TT_SaveCalibration( calibrationFile ) );
@@ -266,10 +309,6 @@ int logMotive()
     CheckResult( TT_Shutdown() );
 
     printf( "=== Complete ===\n" );
-    while( !_kbhit() )
-    {
-        std::this_thread::sleep_for( 20ms );
-    }
 
     return 0;
 }
@@ -285,27 +324,45 @@ void ProcessFrame( int frameCounter )
 
     int totalMarker = TT_FrameMarkerCount();
     printf("Frame #%d: %d Markers \n", frameCounter, totalMarker);
-    ofile << frameCounter;
 
 
     ///////////////////// getTime ////////////////////////////
-    unsigned long time = GetTickCount();
-    // DWORD time = GetTickCount();
-    // printf("GetTickCount : %l", time);
-    cout << "\t timeGetTime : " << time << endl;
-    ofile << "," << time;
+    // session_clock.h time like the mouse and Myo logs (GetTickCount was
+    // ~15ms steps), and Motive's own stamp of the frame
+    long long hostNs = session_ns();
+    unsigned long time = (unsigned long)(hostNs / 1000000);
+    long long deviceMicros = (long long)(TT_FrameTimeStamp() * 1e6 + 0.5);
+    cout << "\t session time : " << time << endl;
     //////////////////////////////////////////////////////////
 
 
+    // kept across frames so the row doesn't allocate once it has grown
+    static std::vector<double> markers;
+    markers.resize(totalMarker * 3);
     for (int i = 0; i < totalMarker; i++) {
         double x = TT_FrameMarkerX(i);
         double y = TT_FrameMarkerY(i);
         double z = TT_FrameMarkerZ(i);
 
         printf("\t Marker: #%d:\t(%.2f,%.2f,%.2f)\n", i, x, y, z);
-        ofile << "," << x << "," << y << "," << z;
+        markers[i * 3] = x;
+        markers[i * 3 + 1] = y;
+        markers[i * 3 + 2] = z;
+    }
+
+    if (markerLog != nullptr)
+    {
+        static MarkerFrame record;
+        int logged = totalMarker < MAX_FRAME_MARKERS ? totalMarker : MAX_FRAME_MARKERS;
+        record.frame = frameCounter;
+        record.hostNs = hostNs;
+        record.deviceMicros = deviceMicros;
+        record.values = (uint32_t)(logged * 3);
+        std::copy(markers.begin(), markers.begin() + logged * 3, record.xyz);
+        markerLog->Push(record);
     }
-    ofile << "\n";
+    else
+        write_marker_row(ofile, frameCounter, time, markers.data(), totalMarker);
 }
 
 // CheckResult function will display errors and exit application.
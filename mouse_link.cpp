@@ -0,0 +1,219 @@
+#include "mouse_link.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+//Give the firmware time to answer before asking again, longer than its
+//1s verify window so a lost ack can't leave the two ends on different rates
+static const unsigned long REQUEST_RETRY_MS = 1200;
+static const int REQUEST_ATTEMPTS = 3;
+static const unsigned long VERIFY_RESEND_MS = 50;
+static const unsigned long VERIFY_TIMEOUT_MS = 1500;
+static const unsigned long HELLO_ASK_MS = 250;
+//Firmware with the handshake answers 'H' within a loop iteration, a report
+//later than this after the first 'H' is from firmware without it
+static const unsigned long HELLO_ANSWER_MS = 50;
+
+bool ControlLineScanner::Push(char ch)
+{
+    bool afterNewline = lineStart;
+    lineStart = ch == '\n';
+    if (ch == tag && afterNewline)
+    {
+        inLine = true;
+        length = 0;
+    }
+    if (!inLine || ch == '\r')
+        return false;
+
+    if (ch == '\n')
+    {
+        inLine = false;
+        line[length] = '\0';
+        return true;
+    }
+    //binary data, not a control line
+    if ((unsigned char)ch < ' ' || (unsigned char)ch > '~' || length + 1 >= sizeof(line))
+    {
+        inLine = false;
+        return false;
+    }
+    line[length++] = ch;
+    return false;
+}
+
+HelloHandshake::HelloHandshake(unsigned long timeoutMs)
+    : timeoutMs(timeoutMs), state(State::Waiting), asked(false), firstAskMs(0), lastAskMs(0), scanner('H'),
+    sawReport(false)
+{
+    hello.version = 0;
+    hello.binary = false;
+}
+
+const char* HelloHandshake::Poll(const char* received, int length, unsigned long nowMs)
+{
+    for (int i = 0; i < length && state == State::Waiting; i++)
+    {
+        if (!scanner.Push(received[i]))
+            continue;
+
+        char protocol[8] = "";
+        if (sscanf(scanner.Line(), "HELLO %d %7s", &hello.version, protocol) == 2)
+        {
+            hello.binary = strcmp(protocol, "binary") == 0;
+            state = State::Done;
+        }
+    }
+
+    if (state != State::Waiting)
+        return nullptr;
+    if (!sawReport && length > 0)
+        reports.Feed(received, (size_t)length, [this](const MouseRecord&) { sawReport = true; });
+    if (sawReport && asked && nowMs - firstAskMs >= HELLO_ANSWER_MS)
+    {
+        state = State::NoHello;
+        return nullptr;
+    }
+    if (nowMs >= timeoutMs)
+    {
+        state = State::TimedOut;
+        return nullptr;
+    }
+    if (!asked || nowMs - lastAskMs >= HELLO_ASK_MS)
+    {
+        if (!asked)
+            firstAskMs = nowMs;
+        asked = true;
+        lastAskMs = nowMs;
+        return "H";
+    }
+    return nullptr;
+}
+
+bool wait_for_hello(Serial& port, unsigned long timeoutMs, FirmwareHello& hello)
+{
+    HelloHandshake handshake(timeoutMs);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    char buffer[256];
+
+    while (!handshake.Finished() && port.IsConnected())
+    {
+        int n = port.ReadData(buffer, sizeof(buffer));
+        unsigned long nowMs = (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        const char* send = handshake.Poll(buffer, n, nowMs);
+        if (send != nullptr)
+            port.WriteData(send, 1);
+
+        if (n == 0)
+            port.WaitForData(10);
+    }
+
+    hello = handshake.Hello();
+    return handshake.GetState() == HelloHandshake::State::Done;
+}
+
+BaudNegotiator::BaudNegotiator(unsigned long currentRate, unsigned long targetRate)
+    : currentRate(currentRate), targetRate(targetRate), state(State::Request), attempts(0),
+    started(false), lastSendMs(0), verifyStartMs(0), requestLength(0), scanner('B')
+{
+    requestLength = (unsigned int)snprintf(request, sizeof(request), "B%lu\n", targetRate);
+}
+
+BaudNegotiator::Action BaudNegotiator::Poll(const char* received, int length, unsigned long nowMs)
+{
+    Action action = { nullptr, 0, 0 };
+
+    for (int i = 0; i < length && !Finished(); i++)
+    {
+        if (!scanner.Push(received[i]))
+            continue;
+        const char* line = scanner.Line();
+
+        if (state == State::Request && strncmp(line, request, requestLength - 1) == 0 && line[requestLength - 1] == '\0')
+        {
+            //Firmware acked and is switching now, follow it
+            state = State::Verify;
+            verifyStartMs = nowMs;
+            lastSendMs = nowMs;
+            action.setBaud = targetRate;
+            action.send = "K";
+            action.sendLength = 1;
+            return action;
+        }
+        if (state == State::Verify && strcmp(line, "BOK") == 0)
+        {
+            state = State::Done;
+            return action;
+        }
+    }
+
+    switch (state)
+    {
+    case State::Request:
+        if (!started || nowMs - lastSendMs >= REQUEST_RETRY_MS)
+        {
+            if (attempts == REQUEST_ATTEMPTS)
+            {
+                state = State::Failed;
+                break;
+            }
+            started = true;
+            attempts++;
+            lastSendMs = nowMs;
+            action.send = request;
+            action.sendLength = requestLength;
+        }
+        break;
+    case State::Verify:
+        if (nowMs - verifyStartMs >= VERIFY_TIMEOUT_MS)
+        {
+            //Firmware has given up by now as well
+            state = State::Failed;
+            action.setBaud = currentRate;
+        }
+        else if (nowMs - lastSendMs >= VERIFY_RESEND_MS)
+        {
+            lastSendMs = nowMs;
+            action.send = "K";
+            action.sendLength = 1;
+        }
+        break;
+    default:
+        break;
+    }
+    return action;
+}
+
+bool negotiate_baud(Serial& port, unsigned long currentRate, unsigned long targetRate)
+{
+    if (currentRate == targetRate)
+        return true;
+
+    BaudNegotiator negotiator(currentRate, targetRate);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    char buffer[256];
+
+    while (!negotiator.Finished() && port.IsConnected())
+    {
+        int n = port.ReadData(buffer, sizeof(buffer));
+        unsigned long nowMs = (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        BaudNegotiator::Action action = negotiator.Poll(buffer, n, nowMs);
+        if (action.setBaud != 0 && !port.SetBaudRate(action.setBaud))
+        {
+            printf("could not switch the port to %lu baud\n", action.setBaud);
+            return false;
+        }
+        if (action.send != nullptr)
+            port.WriteData(action.send, action.sendLength);
+
+        if (n == 0)
+            port.WaitForData(10);
+    }
+
+    return negotiator.GetState() == BaudNegotiator::State::Done;
+}
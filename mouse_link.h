@@ -0,0 +1,147 @@
+#ifndef MOUSE_LINK_H_INCLUDED
+#define MOUSE_LINK_H_INCLUDED
+
+// Host side of the control commands PMW3360_dualsensor.ino understands on
+// top of the report stream.
+
+#include "SerialClass.h"
+#include "mouse_parser.h"
+
+//How long to wait for the firmware's hello after opening the port. Covers a
+//bootloader run after the DTR reset plus setup(); firmware that predates the
+//handshake is told by its reports long before (HelloHandshake), this is only
+//reached when nothing sensible comes at all.
+#define HELLO_TIMEOUT_MS 4000
+
+// Collects the control lines the firmware answers with ("\nB...\n",
+// "\nH...\n") out of the report stream. A line starts with the tag right
+// after a '\n', runs to the next '\n' and holds printable characters only;
+// callers compare the whole line. ASCII reports contain neither the tags nor
+// '\n'. Binary frames (BINARY_PROTOCOL) can hold any byte, so a tag in a
+// frame is only taken for a line if a '\n' precedes it and nothing but
+// printable bytes follow up to the next '\n'.
+class ControlLineScanner
+{
+public:
+    explicit ControlLineScanner(char tag) : tag(tag), length(0), inLine(false), lineStart(true) {}
+
+    //True when ch ended a line, which is then in Line()
+    bool Push(char ch);
+    const char* Line() const { return line; }
+
+private:
+    char tag;
+    char line[32];
+    unsigned int length;
+    bool inLine;
+    //the last byte was a '\n', or nothing came yet
+    bool lineStart;
+};
+
+// Readiness handshake, instead of sleeping a fixed time after opening the port:
+//   firmware "\nHELLO <version> <ascii|binary>\n" at the end of setup()
+//   host     'H' every 250ms, the firmware answers with the hello again
+// Asking matters for boards that don't reset when the port opens (the 32u4
+// boards AdvMouse needs), whose first hello went out long ago.
+// Firmware that predates the handshake never answers but streams reports:
+// a well-formed report once the first 'H' had time to be answered ends the
+// wait (NoHello) instead of the timeout.
+struct FirmwareHello
+{
+    int version;
+    bool binary;
+};
+
+class HelloHandshake
+{
+public:
+    enum class State
+    {
+        Waiting,
+        Done,
+        //reports but no hello, firmware without the handshake
+        NoHello,
+        TimedOut
+    };
+
+    explicit HelloHandshake(unsigned long timeoutMs);
+
+    //Feed what the port returned (may be empty) and a millisecond clock.
+    //Returns a byte to write to the port, or nullptr.
+    const char* Poll(const char* received, int length, unsigned long nowMs);
+
+    State GetState() const { return state; }
+    bool Finished() const { return state != State::Waiting; }
+    const FirmwareHello& Hello() const { return hello; }
+
+private:
+    unsigned long timeoutMs;
+    State state;
+    bool asked;
+    unsigned long firstAskMs;
+    unsigned long lastAskMs;
+    ControlLineScanner scanner;
+    MouseStreamParser reports;
+    bool sawReport;
+    FirmwareHello hello;
+};
+
+//Blocking helper around HelloHandshake. Returns false if no hello came, because
+//the firmware has no handshake or nothing came within timeoutMs.
+bool wait_for_hello(Serial& port, unsigned long timeoutMs, FirmwareHello& hello);
+
+// Baud rate switch, driven by negotiate_baud() or by hand:
+//   host     "B<rate>\n"   at the old rate
+//   firmware "\nB<rate>\n" ack at the old rate, then switches
+//   host     switches, sends 'K' at the new rate until
+//   firmware "\nBOK\n"     at the new rate
+// The firmware goes back to the old rate if no 'K' shows up within 1s,
+// the host gives up after 1.5s, so a failed switch leaves both ends on the
+// old rate.
+class BaudNegotiator
+{
+public:
+    enum class State
+    {
+        Request,
+        Verify,
+        Done,
+        Failed
+    };
+
+    struct Action
+    {
+        //Bytes to write to the port, nullptr if none
+        const char* send;
+        unsigned int sendLength;
+        //Switch the port to this rate before sending, 0 to keep it
+        unsigned long setBaud;
+    };
+
+    BaudNegotiator(unsigned long currentRate, unsigned long targetRate);
+
+    //Feed what the port returned (may be empty) and a millisecond clock,
+    //then carry out the returned action
+    Action Poll(const char* received, int length, unsigned long nowMs);
+
+    State GetState() const { return state; }
+    bool Finished() const { return state == State::Done || state == State::Failed; }
+
+private:
+    unsigned long currentRate;
+    unsigned long targetRate;
+    State state;
+    int attempts;
+    bool started;
+    unsigned long lastSendMs;
+    unsigned long verifyStartMs;
+
+    char request[24];
+    unsigned int requestLength;
+    ControlLineScanner scanner;
+};
+
+//Blocking helper around BaudNegotiator. Returns true if both ends now run at targetRate.
+bool negotiate_baud(Serial& port, unsigned long currentRate, unsigned long targetRate);
+
+#endif // MOUSE_LINK_H_INCLUDED
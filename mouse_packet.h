@@ -0,0 +1,172 @@
+#ifndef MOUSE_PACKET_H_INCLUDED
+#define MOUSE_PACKET_H_INCLUDED
+
+// Binary frame for the dual PMW3360 stream.
+// Shared by the firmware (PMW3360_dualsensor.ino) and the host, so keep it
+// plain C++ without the standard library: avr-gcc has no <cstdint> or STL.
+//
+// Frame layout (16 bytes, little endian):
+//   [0]      sync byte (MOUSE_PACKET_SYNC)
+//   [1]      sequence number, wraps at 256
+//   [2..5]   device micros() timestamp
+//   [6..7]   sensor1 dx
+//   [8..9]   sensor2 dx
+//   [10..11] sensor1 dy
+//   [12..13] sensor2 dy
+//   [14]     button bitfield (MOUSE_BTN_*, MOUSE_FLAG_*)
+//   [15]     CRC-8 (poly 0x07) over bytes [1..14]
+
+#include <stdint.h>
+
+#define MOUSE_PACKET_SYNC 0xA5
+#define MOUSE_PACKET_SIZE 16
+
+#define MOUSE_BTN_LEFT     0x01
+#define MOUSE_BTN_RIGHT    0x02
+//Sensors got back on the surface ('f' in the ASCII protocol)
+#define MOUSE_FLAG_CLUTCH  0x80
+
+struct MousePacket
+{
+    uint8_t seq;
+    uint32_t timestamp;
+    //Raw sensor deltas, same values the ASCII protocol prints
+    int16_t dx1, dx2, dy1, dy2;
+    uint8_t buttons;
+};
+
+//CRC-8 of every byte value, so the CRC costs one lookup per byte instead of
+//eight shifts. On AVR it stays in flash, RAM is too small for it.
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#define MOUSE_PACKET_CRC_ENTRY(i) pgm_read_byte(&mouse_packet_crc_table[i])
+#define MOUSE_PACKET_PROGMEM PROGMEM
+#else
+#define MOUSE_PACKET_CRC_ENTRY(i) mouse_packet_crc_table[i]
+#define MOUSE_PACKET_PROGMEM
+#endif
+
+static const uint8_t mouse_packet_crc_table[256] MOUSE_PACKET_PROGMEM = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3
+};
+
+inline uint8_t mouse_packet_crc8(const uint8_t* data, uint8_t length)
+{
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < length; i++)
+        crc = MOUSE_PACKET_CRC_ENTRY(crc ^ data[i]);
+    return crc;
+}
+
+inline void mouse_packet_put16(uint8_t* out, int16_t value)
+{
+    out[0] = (uint8_t)((uint16_t)value & 0xFF);
+    out[1] = (uint8_t)((uint16_t)value >> 8);
+}
+
+inline int16_t mouse_packet_get16(const uint8_t* in)
+{
+    return (int16_t)(uint16_t)(in[0] | ((uint16_t)in[1] << 8));
+}
+
+//Write one frame into out[MOUSE_PACKET_SIZE]
+inline void mouse_packet_encode(const MousePacket& packet, uint8_t* out)
+{
+    out[0] = MOUSE_PACKET_SYNC;
+    out[1] = packet.seq;
+    out[2] = (uint8_t)(packet.timestamp);
+    out[3] = (uint8_t)(packet.timestamp >> 8);
+    out[4] = (uint8_t)(packet.timestamp >> 16);
+    out[5] = (uint8_t)(packet.timestamp >> 24);
+    mouse_packet_put16(out + 6, packet.dx1);
+    mouse_packet_put16(out + 8, packet.dx2);
+    mouse_packet_put16(out + 10, packet.dy1);
+    mouse_packet_put16(out + 12, packet.dy2);
+    out[14] = packet.buttons;
+    out[15] = mouse_packet_crc8(out + 1, MOUSE_PACKET_SIZE - 2);
+}
+
+//Check sync and CRC of one frame and unpack it, return false if it is corrupted
+inline bool mouse_packet_decode(const uint8_t* in, MousePacket& packet)
+{
+    if (in[0] != MOUSE_PACKET_SYNC || mouse_packet_crc8(in + 1, MOUSE_PACKET_SIZE - 2) != in[15])
+        return false;
+
+    packet.seq = in[1];
+    packet.timestamp = (uint32_t)in[2] | ((uint32_t)in[3] << 8) | ((uint32_t)in[4] << 16) | ((uint32_t)in[5] << 24);
+    packet.dx1 = mouse_packet_get16(in + 6);
+    packet.dx2 = mouse_packet_get16(in + 8);
+    packet.dy1 = mouse_packet_get16(in + 10);
+    packet.dy2 = mouse_packet_get16(in + 12);
+    packet.buttons = in[14];
+    return true;
+}
+
+// Streaming decoder for the host side.
+// Push whatever the serial port returned; it hunts for the sync byte, checks
+// the CRC and on a bad frame slides forward by one byte so a single corrupted
+// or dropped byte costs at most one frame.
+class MousePacketDecoder
+{
+public:
+    MousePacketDecoder() : fill(0), lastSeq(0), haveSeq(false), crcErrors(0), lostFrames(0) {}
+
+    //Feed one byte, return true when packet holds a new valid frame
+    bool Push(uint8_t byte, MousePacket& packet)
+    {
+        if (fill == 0 && byte != MOUSE_PACKET_SYNC)
+            return false;
+
+        frame[fill++] = byte;
+        if (fill < MOUSE_PACKET_SIZE)
+            return false;
+
+        if (mouse_packet_decode(frame, packet))
+        {
+            fill = 0;
+            if (haveSeq)
+                lostFrames += (uint8_t)(packet.seq - lastSeq - 1);
+            lastSeq = packet.seq;
+            haveSeq = true;
+            return true;
+        }
+
+        //Resync: restart from the next sync byte inside the rejected frame
+        crcErrors++;
+        uint8_t start = 1;
+        while (start < MOUSE_PACKET_SIZE && frame[start] != MOUSE_PACKET_SYNC)
+            start++;
+        fill = 0;
+        for (uint8_t i = start; i < MOUSE_PACKET_SIZE; i++)
+            frame[fill++] = frame[i];
+        return false;
+    }
+
+    unsigned long CrcErrors() const { return crcErrors; }
+    unsigned long LostFrames() const { return lostFrames; }
+
+private:
+    uint8_t frame[MOUSE_PACKET_SIZE];
+    uint8_t fill;
+    uint8_t lastSeq;
+    bool haveSeq;
+    unsigned long crcErrors;
+    unsigned long lostFrames;
+};
+
+#endif // MOUSE_PACKET_H_INCLUDED
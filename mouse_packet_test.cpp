@@ -0,0 +1,251 @@
+// Checks MousePacketDecoder (mouse_packet.h) against encoded frames and the
+// ways the serial line damages them: flipped bits, cut frames, stray sync
+// bytes, garbage and lost frames. Prints every failed check and returns 1 if
+// there was one.
+//
+//   g++ -O2 -std=c++14 mouse_packet_test.cpp -o mouse_packet_test
+//   ./mouse_packet_test
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include "mouse_packet.h"
+
+static int failures = 0;
+
+#define CHECK(condition, ...)                                   \
+    do                                                          \
+    {                                                           \
+        if (!(condition))                                       \
+        {                                                       \
+            failures++;                                         \
+            printf("FAILED %s:%d: %s: ", __FILE__, __LINE__, #condition); \
+            printf(__VA_ARGS__);                                \
+            printf("\n");                                       \
+        }                                                       \
+    } while (0)
+
+//Frame i of the test stream, fields chosen to cover the int16 range and
+//every byte of the timestamp
+static MousePacket test_packet(int i)
+{
+    MousePacket packet;
+    packet.seq = (uint8_t)i;
+    packet.timestamp = 4000000000u + (uint32_t)i * 7200u;
+    packet.dx1 = (int16_t)(i * 37 - 900);
+    packet.dx2 = (int16_t)(i % 2 ? 32767 : -32768);
+    packet.dy1 = (int16_t)(-i * 11);
+    packet.dy2 = (int16_t)(i * 131);
+    packet.buttons = (uint8_t)(i % 4 == 3 ? MOUSE_FLAG_CLUTCH : i % 3);
+    return packet;
+}
+
+static bool same(const MousePacket& a, const MousePacket& b)
+{
+    return a.seq == b.seq && a.timestamp == b.timestamp && a.dx1 == b.dx1 && a.dx2 == b.dx2
+        && a.dy1 == b.dy1 && a.dy2 == b.dy2 && a.buttons == b.buttons;
+}
+
+static void append_frame(std::vector<uint8_t>& stream, int i)
+{
+    uint8_t frame[MOUSE_PACKET_SIZE];
+    mouse_packet_encode(test_packet(i), frame);
+    stream.insert(stream.end(), frame, frame + MOUSE_PACKET_SIZE);
+}
+
+static std::vector<uint8_t> clean_stream(int frames)
+{
+    std::vector<uint8_t> stream;
+    for (int i = 0; i < frames; i++)
+        append_frame(stream, i);
+    return stream;
+}
+
+struct Decoded
+{
+    std::vector<MousePacket> packets;
+    unsigned long crcErrors;
+    unsigned long lostFrames;
+};
+
+//Push the stream in pieces of chunk bytes, the decoder keeps its state
+//between them like between serial reads
+static Decoded decode(const std::vector<uint8_t>& stream, size_t chunk)
+{
+    MousePacketDecoder decoder;
+    Decoded result;
+    MousePacket packet;
+    for (size_t start = 0; start < stream.size(); start += chunk)
+        for (size_t i = start; i < stream.size() && i < start + chunk; i++)
+            if (decoder.Push(stream[i], packet))
+                result.packets.push_back(packet);
+    result.crcErrors = decoder.CrcErrors();
+    result.lostFrames = decoder.LostFrames();
+    return result;
+}
+
+//The decoded frames are test_packet(i) for every i in 0..frames-1 but skip
+static bool frames_except(const Decoded& decoded, int frames, int skip)
+{
+    size_t next = 0;
+    for (int i = 0; i < frames; i++)
+    {
+        if (i == skip)
+            continue;
+        if (next >= decoded.packets.size() || !same(decoded.packets[next], test_packet(i)))
+            return false;
+        next++;
+    }
+    return next == decoded.packets.size();
+}
+
+static int sync_bytes(const uint8_t* data, size_t length)
+{
+    int count = 0;
+    for (size_t i = 0; i < length; i++)
+        count += data[i] == MOUSE_PACKET_SYNC;
+    return count;
+}
+
+static void test_crc()
+{
+    //CRC-8/SMBUS check value
+    const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    CHECK(mouse_packet_crc8(check, sizeof(check)) == 0xF4, "crc 0x%02X", mouse_packet_crc8(check, sizeof(check)));
+}
+
+static void test_round_trip()
+{
+    //more than 256 frames, the sequence number wraps
+    const int frames = 600;
+    std::vector<uint8_t> stream = clean_stream(frames);
+    const size_t chunks[] = { 1, 7, 16, 4096 };
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++)
+    {
+        Decoded decoded = decode(stream, chunks[c]);
+        CHECK(frames_except(decoded, frames, -1), "chunk %zu: %zu frames", chunks[c], decoded.packets.size());
+        CHECK(decoded.crcErrors == 0, "chunk %zu: %lu CRC errors", chunks[c], decoded.crcErrors);
+        CHECK(decoded.lostFrames == 0, "chunk %zu: %lu lost", chunks[c], decoded.lostFrames);
+    }
+}
+
+//Every single bit error in frame 5 loses exactly that frame
+static void test_bit_flips()
+{
+    const int frames = 12, bad = 5;
+    for (int byte = 0; byte < MOUSE_PACKET_SIZE; byte++)
+    {
+        for (int bit = 0; bit < 8; bit++)
+        {
+            std::vector<uint8_t> stream = clean_stream(frames);
+            uint8_t* frame = &stream[bad * MOUSE_PACKET_SIZE];
+            frame[byte] ^= (uint8_t)(1 << bit);
+            Decoded decoded = decode(stream, 5);
+
+            CHECK(frames_except(decoded, frames, bad), "byte %d bit %d: %zu frames", byte, bit, decoded.packets.size());
+            CHECK(decoded.lostFrames == 1, "byte %d bit %d: %lu lost", byte, bit, decoded.lostFrames);
+            //A broken sync byte is skipped while hunting; any other error is
+            //one CRC error, plus one for every sync byte in the rest of the
+            //frame the decoder tries to start from
+            int strays = sync_bytes(frame + 1, MOUSE_PACKET_SIZE - 1);
+            if (byte == 0)
+                CHECK(decoded.crcErrors == (unsigned long)strays, "byte 0 bit %d: %lu CRC errors", bit, decoded.crcErrors);
+            else
+                CHECK(decoded.crcErrors >= 1 && decoded.crcErrors <= 1 + (unsigned long)strays,
+                    "byte %d bit %d: %lu CRC errors", byte, bit, decoded.crcErrors);
+        }
+    }
+}
+
+//A frame cut short at either end costs that frame and no other
+static void test_truncated()
+{
+    const int frames = 12, bad = 7;
+    for (int cut = 1; cut < MOUSE_PACKET_SIZE; cut++)
+    {
+        for (int front = 0; front < 2; front++)
+        {
+            std::vector<uint8_t> stream = clean_stream(frames);
+            size_t start = bad * MOUSE_PACKET_SIZE + (front ? 0 : MOUSE_PACKET_SIZE - cut);
+            std::vector<uint8_t> kept(stream.begin() + bad * MOUSE_PACKET_SIZE, stream.begin() + (bad + 1) * MOUSE_PACKET_SIZE);
+            stream.erase(stream.begin() + start, stream.begin() + start + cut);
+            Decoded decoded = decode(stream, 3);
+
+            CHECK(frames_except(decoded, frames, bad), "%s %d bytes: %zu frames", front ? "front" : "back", cut,
+                decoded.packets.size());
+            CHECK(decoded.lostFrames == 1, "%s %d bytes: %lu lost", front ? "front" : "back", cut, decoded.lostFrames);
+            //whatever is left of the frame and starts with a sync byte is one
+            //failed frame, the next real frame is found again in it
+            const uint8_t* left = kept.data() + (front ? cut : 0);
+            unsigned long starts = (unsigned long)sync_bytes(left, MOUSE_PACKET_SIZE - cut);
+            CHECK(decoded.crcErrors == starts, "%s %d bytes: %lu CRC errors, %lu expected", front ? "front" : "back", cut,
+                decoded.crcErrors, starts);
+        }
+    }
+}
+
+//Sync bytes and noise between frames lose nothing
+static void test_stray_bytes()
+{
+    const int frames = 10;
+    for (int strays = 1; strays <= 3; strays++)
+    {
+        std::vector<uint8_t> stream;
+        for (int i = 0; i < frames; i++)
+        {
+            append_frame(stream, i);
+            if (i == 4)
+                stream.insert(stream.end(), strays, MOUSE_PACKET_SYNC);
+        }
+        Decoded decoded = decode(stream, 16);
+        CHECK(frames_except(decoded, frames, -1), "%d sync bytes: %zu frames", strays, decoded.packets.size());
+        CHECK(decoded.lostFrames == 0, "%d sync bytes: %lu lost", strays, decoded.lostFrames);
+        //each stray starts a frame that fails and resyncs to the next one
+        CHECK(decoded.crcErrors == (unsigned long)strays, "%d sync bytes: %lu CRC errors", strays, decoded.crcErrors);
+    }
+
+    //no sync byte in the noise, it is skipped without a CRC error
+    std::vector<uint8_t> stream;
+    const uint8_t noise[] = { 0x00, 0xFF, 'x', 'a', '1', '\n', 0x5A };
+    for (int i = 0; i < 6; i++)
+    {
+        stream.insert(stream.end(), noise, noise + sizeof(noise));
+        append_frame(stream, i);
+    }
+    Decoded decoded = decode(stream, 4);
+    CHECK(frames_except(decoded, 6, -1), "noise: %zu frames", decoded.packets.size());
+    CHECK(decoded.crcErrors == 0 && decoded.lostFrames == 0, "noise: %lu CRC errors, %lu lost", decoded.crcErrors,
+        decoded.lostFrames);
+}
+
+//Whole frames missing show up only in the sequence numbers
+static void test_lost_frames()
+{
+    std::vector<uint8_t> stream;
+    for (int i = 0; i < 300; i++)
+        if (i != 10 && i != 255 && i != 256 && (i < 100 || i >= 105))
+            append_frame(stream, i);
+    Decoded decoded = decode(stream, 64);
+    CHECK(decoded.packets.size() == 292, "%zu frames", decoded.packets.size());
+    CHECK(decoded.crcErrors == 0, "%lu CRC errors", decoded.crcErrors);
+    CHECK(decoded.lostFrames == 8, "%lu lost", decoded.lostFrames);
+}
+
+int main()
+{
+    test_crc();
+    test_round_trip();
+    test_bit_flips();
+    test_truncated();
+    test_stray_bytes();
+    test_lost_frames();
+
+    if (failures > 0)
+    {
+        printf("%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
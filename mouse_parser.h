@@ -0,0 +1,280 @@
+#ifndef MOUSE_PARSER_H_INCLUDED
+#define MOUSE_PARSER_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "mouse_packet.h"
+
+// One report of the dual sensor mouse, already in the sign convention that
+// theta_converter expects.
+struct MouseRecord
+{
+    int dx1, dx2, dy1, dy2;
+    int button[2];
+    //Sensors got back on the surface, deltas and buttons are not valid
+    bool clutch;
+    //Firmware micros() when the sensors were read, see ClockSync. Firmware
+    //that doesn't stamp its reports leaves hasDeviceTime false.
+    bool hasDeviceTime;
+    uint32_t deviceMicros;
+};
+
+//Convert a binary frame into the same record the ASCII parser produces
+inline MouseRecord mouse_record_from_packet(const MousePacket& packet)
+{
+    MouseRecord record;
+    record.dx1 = packet.dx1;
+    record.dx2 = -packet.dx2;
+    record.dy1 = -packet.dy1;
+    record.dy2 = -packet.dy2;
+    record.button[0] = (packet.buttons & MOUSE_BTN_LEFT) ? 1 : 0;
+    record.button[1] = (packet.buttons & MOUSE_BTN_RIGHT) ? 1 : 0;
+    record.clutch = (packet.buttons & MOUSE_FLAG_CLUTCH) != 0;
+    record.hasDeviceTime = true;
+    record.deviceMicros = packet.timestamp;
+    return record;
+}
+
+// Parser for the ASCII firmware output "t<us>xa<n>xb<n>ya<n>yb<n>ca<n>cb<n>" and 'f'.
+// The "t<us>" device stamp is optional, older firmware doesn't send it.
+// Works on whole buffers, keeps its state between calls, never allocates.
+// Every byte goes through a 256 entry class table and a switch on the class,
+// fields are accumulated as integers instead of strings.
+class MouseStreamParser
+{
+public:
+    MouseStreamParser() : field(-1), tag(0), value(0), negative(false), digits(0), expected(0),
+        hasStamp(false), stamp(0), records(0), errors(0) {}
+
+    //Parse length bytes, call onRecord(const MouseRecord&) for every complete report
+    template <typename Callback>
+    void Feed(const char* data, size_t length, Callback&& onRecord)
+    {
+        const uint8_t* classes = ClassTable();
+
+        for (size_t i = 0; i < length; i++)
+        {
+            const uint8_t ch = static_cast<uint8_t>(data[i]);
+
+            switch (classes[ch])
+            {
+            case kDigit:
+                if (field < 0)
+                {
+                    //'t' only starts the stamp when a digit follows right away
+                    if (tag != kTagT)
+                    {
+                        hasStamp = false;
+                        break;
+                    }
+                    StartStamp();
+                }
+                if (digits >= MaxDigits(field))
+                {
+                    DropRecord();
+                    break;
+                }
+                value = value * 10 + (ch - '0');
+                digits++;
+                //Buttons are printed as a single 0/1, no need to wait for the next tag
+                if (MaxDigits(field) == 1 && CommitField())
+                    onRecord(record);
+                break;
+            case kMinus:
+                //only the deltas are signed
+                if (field < 0 || field >= 4 || digits != 0 || negative)
+                    DropRecord();
+                else
+                    negative = true;
+                break;
+            case kTagX:
+            case kTagY:
+            case kTagC:
+            case kTagT:
+                //a stamp has to be followed by its report's "xa"
+                if (field < 0 && expected == 0)
+                    hasStamp = false;
+                else if (field >= 0 && CommitField())
+                    onRecord(record);
+                tag = classes[ch];
+                break;
+            case kSuffixA:
+            case kSuffixB:
+                if (tag == 0)
+                {
+                    if (field >= 0 && CommitField())
+                        onRecord(record);
+                    hasStamp = false;
+                    break;
+                }
+                StartField((tag - kTagX) * 2 + (classes[ch] - kSuffixA));
+                break;
+            case kClutch:
+                if (field >= 0)
+                    DropRecord();
+                expected = 0;
+                tag = 0;
+                hasStamp = false;
+                {
+                    MouseRecord clutch = {};
+                    clutch.clutch = true;
+                    onRecord(clutch);
+                }
+                break;
+            default:
+                if (field >= 0 && CommitField())
+                    onRecord(record);
+                tag = 0;
+                hasStamp = false;
+                break;
+            }
+        }
+    }
+
+    unsigned long Records() const { return records; }
+    //Reports dropped because of out of order tags, missing or oversized values
+    unsigned long Errors() const { return errors; }
+
+private:
+    enum CharClass
+    {
+        kOther = 0, kDigit, kMinus, kTagX, kTagY, kTagC, kSuffixA, kSuffixB, kClutch, kTagT
+    };
+
+    //Field order on the wire: xa xb ya yb ca cb, the stamp goes in front
+    //of xa and isn't counted in expected
+    static const int kFieldCount = 6;
+    static const int kStampField = kFieldCount;
+
+    //Deltas fit in an int16, buttons are a single digit, stamps an uint32
+    static int MaxDigits(int index) { return index < 4 ? 5 : (index == kStampField ? 10 : 1); }
+
+    static const uint8_t* ClassTable()
+    {
+        struct Table
+        {
+            uint8_t classes[256];
+            Table()
+            {
+                for (int i = 0; i < 256; i++)
+                    classes[i] = kOther;
+                for (int i = '0'; i <= '9'; i++)
+                    classes[i] = kDigit;
+                classes['-'] = kMinus;
+                classes['x'] = kTagX;
+                classes['y'] = kTagY;
+                classes['c'] = kTagC;
+                classes['a'] = kSuffixA;
+                classes['b'] = kSuffixB;
+                classes['f'] = kClutch;
+                classes['t'] = kTagT;
+            }
+        };
+        static const Table table;
+        return table.classes;
+    }
+
+    void StartField(int index)
+    {
+        tag = 0;
+        if (index != expected)
+        {
+            //Lost bytes in the middle of a report, wait for the next "xa"
+            hasStamp = false;
+            if (expected != 0)
+                errors++;
+            expected = 0;
+            if (index != 0)
+            {
+                field = -1;
+                return;
+            }
+        }
+        field = index;
+        value = 0;
+        negative = false;
+        digits = 0;
+    }
+
+    void StartStamp()
+    {
+        tag = 0;
+        //Stamp in the middle of a report, the rest of it got lost
+        if (expected != 0)
+            errors++;
+        expected = 0;
+        field = kStampField;
+        value = 0;
+        negative = false;
+        digits = 0;
+    }
+
+    //Store the current value, return true when it completed a report
+    bool CommitField()
+    {
+        if (digits == 0)
+        {
+            DropRecord();
+            return false;
+        }
+        if (field == kStampField)
+        {
+            //10 digits can hold more than micros() ever returns
+            if (value > 0xFFFFFFFFLL)
+            {
+                DropRecord();
+                return false;
+            }
+            stamp = (uint32_t)value;
+            hasStamp = true;
+            field = -1;
+            return false;
+        }
+
+        raw[field] = (int32_t)(negative ? -value : value);
+        field = -1;
+        if (++expected < kFieldCount)
+            return false;
+
+        expected = 0;
+        record.dx1 = raw[0];
+        record.dx2 = -raw[1];
+        record.dy1 = -raw[2];
+        record.dy2 = -raw[3];
+        record.button[0] = raw[4];
+        record.button[1] = raw[5];
+        record.clutch = false;
+        record.hasDeviceTime = hasStamp;
+        record.deviceMicros = hasStamp ? stamp : 0;
+        hasStamp = false;
+        records++;
+        return true;
+    }
+
+    void DropRecord()
+    {
+        errors++;
+        field = -1;
+        tag = 0;
+        expected = 0;
+        hasStamp = false;
+    }
+
+    int field;
+    int tag;
+    //Wide enough for a 10 digit stamp
+    int64_t value;
+    bool negative;
+    int digits;
+    int expected;
+    int32_t raw[kFieldCount];
+    bool hasStamp;
+    uint32_t stamp;
+    MouseRecord record;
+
+    unsigned long records;
+    unsigned long errors;
+};
+
+#endif // MOUSE_PARSER_H_INCLUDED
@@ -0,0 +1,437 @@
+// Fuzzes MouseStreamParser (mouse_parser.h) with generator streams
+// (append_ascii_report), the same streams with random damage, and random
+// token soup, fed in random pieces. Every record is checked against a plain
+// reference parser of the report grammar and against the value limits.
+// Linux, built with the sanitizers so any out of bounds access or overflow
+// stops the run.
+//
+//   g++ -O1 -g -std=c++14 -fsanitize=address,undefined -fno-sanitize-recover=all
+//       mouse_parser_fuzz.cpp byte_source.cpp -o mouse_parser_fuzz
+//   ./mouse_parser_fuzz [iterations] [--seed n] [--corpus dir]
+//
+// --seed    start of the random sequence (default 1), a failure prints the
+//           seed of its case so it can be run again on its own
+// --corpus  also feed every file in dir, whole and in random pieces, and
+//           write each failing case there as fail-<seed>.txt
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "mouse_parser.h"
+#include "byte_source.h"
+
+//Deltas are printed in at most 5 digits, buttons in 1, see MaxDigits
+static const long MAX_DELTA = 99999;
+
+struct Rng
+{
+    uint64_t state;
+
+    explicit Rng(uint64_t seed) : state(seed * 0x9E3779B97F4A7C15ull + 1) {}
+
+    uint64_t Next()
+    {
+        //splitmix64
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    //0 .. n-1
+    size_t Below(size_t n) { return (size_t)(Next() % n); }
+    bool Chance(int percent) { return (int)Below(100) < percent; }
+};
+
+static bool same(const MouseRecord& a, const MouseRecord& b)
+{
+    return a.dx1 == b.dx1 && a.dx2 == b.dx2 && a.dy1 == b.dy1 && a.dy2 == b.dy2 && a.button[0] == b.button[0]
+        && a.button[1] == b.button[1] && a.clutch == b.clutch && a.hasDeviceTime == b.hasDeviceTime
+        && (!a.hasDeviceTime || a.deviceMicros == b.deviceMicros);
+}
+
+static std::string describe(const MouseRecord& r)
+{
+    char text[160];
+    snprintf(text, sizeof(text), "%s t%s%lu dx1 %d dx2 %d dy1 %d dy2 %d buttons %d %d", r.clutch ? "clutch" : "report",
+        r.hasDeviceTime ? "" : "(none) ", (unsigned long)r.deviceMicros, r.dx1, r.dx2, r.dy1, r.dy2, r.button[0], r.button[1]);
+    return text;
+}
+
+static bool is_digit(char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+//Reads literal and an integer of 1..maxDigits digits at p, with a leading
+//'-' if signed_
+static bool match_field(const std::string& s, size_t& p, const char* literal, int maxDigits, bool signed_, long& value)
+{
+    size_t length = strlen(literal);
+    if (s.compare(p, length, literal) != 0)
+        return false;
+    size_t q = p + length;
+    bool negative = signed_ && q < s.size() && s[q] == '-';
+    if (negative)
+        q++;
+    int digits = 0;
+    value = 0;
+    while (q < s.size() && is_digit(s[q]) && digits < maxDigits)
+    {
+        value = value * 10 + (s[q++] - '0');
+        digits++;
+    }
+    //the parser drops a value with too many digits; a single digit field
+    //ends after its digit, whatever follows
+    if (digits == 0 || (maxDigits > 1 && q < s.size() && is_digit(s[q])))
+        return false;
+    if (negative)
+        value = -value;
+    p = q;
+    return true;
+}
+
+//A complete report "[t<us>]xa<n>xb<n>ya<n>yb<n>ca<d>cb<d>" starting at p
+static bool match_report(const std::string& s, size_t p, MouseRecord& record, size_t& end)
+{
+    record = MouseRecord();
+    long value = 0;
+    if (s.compare(p, 1, "t") == 0 && p + 1 < s.size() && is_digit(s[p + 1]))
+    {
+        //a stamp that doesn't fit uint32 is dropped with its report
+        if (!match_field(s, p, "t", 10, false, value) || value > (long)UINT32_MAX)
+            return false;
+        record.hasDeviceTime = true;
+        record.deviceMicros = (uint32_t)value;
+    }
+    long raw[4];
+    const char* tags[4] = { "xa", "xb", "ya", "yb" };
+    for (int i = 0; i < 4; i++)
+        if (!match_field(s, p, tags[i], 5, true, raw[i]))
+            return false;
+    long buttons[2];
+    if (!match_field(s, p, "ca", 1, false, buttons[0]) || !match_field(s, p, "cb", 1, false, buttons[1]))
+        return false;
+
+    record.dx1 = (int)raw[0];
+    record.dx2 = (int)-raw[1];
+    record.dy1 = (int)-raw[2];
+    record.dy2 = (int)-raw[3];
+    record.button[0] = (int)buttons[0];
+    record.button[1] = (int)buttons[1];
+    end = p;
+    return true;
+}
+
+//Every report the strict grammar finds, left to right; the parser is more
+//lenient, so these have to be a subsequence of what it reports
+static std::vector<MouseRecord> reference_parse(const std::string& s)
+{
+    std::vector<MouseRecord> records;
+    for (size_t p = 0; p < s.size();)
+    {
+        MouseRecord record;
+        size_t end;
+        if ((s[p] == 't' || s[p] == 'x') && match_report(s, p, record, end))
+        {
+            records.push_back(record);
+            p = end;
+        }
+        else if (s[p] == 'f')
+        {
+            MouseRecord clutch = {};
+            clutch.clutch = true;
+            records.push_back(clutch);
+            p++;
+        }
+        else
+            p++;
+    }
+    return records;
+}
+
+struct Outcome
+{
+    std::vector<MouseRecord> records;
+    unsigned long reports;
+};
+
+static Outcome parse_in_pieces(const std::string& s, Rng& rng)
+{
+    MouseStreamParser parser;
+    Outcome outcome;
+    size_t p = 0;
+    while (p < s.size())
+    {
+        size_t piece = rng.Chance(20) ? 1 : 1 + rng.Below(rng.Chance(50) ? 16 : 512);
+        if (piece > s.size() - p)
+            piece = s.size() - p;
+        //a copy of exactly the piece, so reading past it is caught
+        std::vector<char> buffer(s.begin() + p, s.begin() + p + piece);
+        parser.Feed(buffer.data(), buffer.size(), [&](const MouseRecord& record) {
+            outcome.records.push_back(record);
+        });
+        p += piece;
+    }
+    outcome.reports = parser.Records();
+    return outcome;
+}
+
+//A generator stream of reports and the records it has to give, with the
+//stamp left out now and then like older firmware and a clutch between reports
+static std::string generator_stream(Rng& rng, std::vector<MouseRecord>& expected)
+{
+    std::string s;
+    long first = (long)rng.Below(100000);
+    long count = 1 + (long)rng.Below(200);
+    for (long i = first; i < first + count; i++)
+    {
+        int raw[4];
+        synthetic_report(i, raw);
+        if (rng.Chance(10))
+            for (int k = 0; k < 4; k++)
+                raw[k] = (int)rng.Below(2 * MAX_DELTA + 1) - (int)MAX_DELTA;
+        int buttons[2] = { (int)rng.Below(2), (int)rng.Below(2) };
+        uint32_t stamp = rng.Chance(5) ? (uint32_t)rng.Next() : (uint32_t)(i * SYNTHETIC_INTERVAL_US);
+
+        size_t start = s.size();
+        append_ascii_report(s, stamp, raw, buttons[0], buttons[1]);
+        bool stamped = rng.Chance(80);
+        if (!stamped)
+            s.erase(start, s.find('x', start) - start);
+
+        MouseRecord record = MouseRecord();
+        record.dx1 = raw[0];
+        record.dx2 = -raw[1];
+        record.dy1 = -raw[2];
+        record.dy2 = -raw[3];
+        record.button[0] = buttons[0];
+        record.button[1] = buttons[1];
+        record.hasDeviceTime = stamped;
+        record.deviceMicros = stamped ? stamp : 0;
+        expected.push_back(record);
+
+        if (rng.Chance(3))
+        {
+            s += 'f';
+            MouseRecord clutch = {};
+            clutch.clutch = true;
+            expected.push_back(clutch);
+        }
+    }
+    return s;
+}
+
+static const char ALPHABET[] = "txyabcf-0123456789\n\r ";
+
+static char random_byte(Rng& rng)
+{
+    return rng.Chance(80) ? ALPHABET[rng.Below(sizeof(ALPHABET) - 1)] : (char)rng.Below(256);
+}
+
+//Flipped, inserted, dropped and repeated bytes and runs of digits
+static void damage(std::string& s, Rng& rng)
+{
+    int edits = 1 + (int)rng.Below(8);
+    for (int e = 0; e < edits && !s.empty(); e++)
+    {
+        size_t p = rng.Below(s.size());
+        switch (rng.Below(6))
+        {
+        case 0:
+            s[p] = random_byte(rng);
+            break;
+        case 1:
+            s.insert(s.begin() + p, random_byte(rng));
+            break;
+        case 2:
+            s.erase(p, 1 + rng.Below(20));
+            break;
+        case 3:
+            s.insert(p, s.substr(p, 1 + rng.Below(40)));
+            break;
+        case 4:
+            s.insert(p, std::string(1 + rng.Below(24), (char)('0' + rng.Below(10))));
+            break;
+        default:
+            s.insert(p, rng.Chance(50) ? "-" : "--");
+            break;
+        }
+    }
+}
+
+//Pieces of the grammar in random order: tags, signs, numbers of any length
+static std::string token_soup(Rng& rng)
+{
+    static const char* const tokens[] = { "t", "xa", "xb", "ya", "yb", "ca", "cb", "f", "-", "\n", "x", "y", "c", "a", "b" };
+    std::string s;
+    int count = 1 + (int)rng.Below(400);
+    for (int i = 0; i < count; i++)
+    {
+        if (rng.Chance(40))
+        {
+            int digits = rng.Chance(90) ? 1 + (int)rng.Below(6) : 1 + (int)rng.Below(24);
+            for (int d = 0; d < digits; d++)
+                s += (char)('0' + rng.Below(10));
+        }
+        else if (rng.Chance(5))
+            s += (char)rng.Below(256);
+        else
+            s += tokens[rng.Below(sizeof(tokens) / sizeof(tokens[0]))];
+    }
+    return s;
+}
+
+static std::vector<std::string> read_corpus(const char* dir)
+{
+    std::vector<std::string> files;
+    DIR* d = opendir(dir);
+    if (d == nullptr)
+        return files;
+    while (struct dirent* entry = readdir(d))
+    {
+        if (entry->d_name[0] == '.')
+            continue;
+        std::string path = std::string(dir) + "/" + entry->d_name;
+        FILE* f = fopen(path.c_str(), "rb");
+        if (f == nullptr)
+            continue;
+        std::string data;
+        char buffer[4096];
+        size_t n;
+        while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+            data.append(buffer, n);
+        fclose(f);
+        files.push_back(data);
+    }
+    closedir(d);
+    return files;
+}
+
+//Limits of what a report can hold, then the reference records in order
+static bool check(const std::string& s, const Outcome& outcome, const std::vector<MouseRecord>* exact, std::string& why)
+{
+    unsigned long reports = 0;
+    for (size_t i = 0; i < outcome.records.size(); i++)
+    {
+        const MouseRecord& r = outcome.records[i];
+        if (r.clutch)
+            continue;
+        reports++;
+        const int deltas[4] = { r.dx1, r.dx2, r.dy1, r.dy2 };
+        for (int k = 0; k < 4; k++)
+            if (deltas[k] < -MAX_DELTA || deltas[k] > MAX_DELTA)
+                why = "delta out of range: " + describe(r);
+        if (r.button[0] < 0 || r.button[0] > 9 || r.button[1] < 0 || r.button[1] > 9)
+            why = "button out of range: " + describe(r);
+        if (!why.empty())
+            return false;
+    }
+    if (reports != outcome.reports)
+    {
+        why = "Records() is " + std::to_string(outcome.reports) + ", " + std::to_string(reports) + " reported";
+        return false;
+    }
+
+    if (exact != nullptr)
+    {
+        for (size_t i = 0; i < exact->size() || i < outcome.records.size(); i++)
+        {
+            if (i >= exact->size() || i >= outcome.records.size() || !same((*exact)[i], outcome.records[i]))
+            {
+                why = "record " + std::to_string(i) + ": " +
+                    (i < outcome.records.size() ? describe(outcome.records[i]) : "missing") + ", expected " +
+                    (i < exact->size() ? describe((*exact)[i]) : "none");
+                return false;
+            }
+        }
+    }
+
+    std::vector<MouseRecord> reference = reference_parse(s);
+    size_t next = 0;
+    for (size_t i = 0; i < outcome.records.size() && next < reference.size(); i++)
+        if (same(outcome.records[i], reference[next]))
+            next++;
+    if (next < reference.size())
+    {
+        why = "reference record " + std::to_string(next) + " not reported: " + describe(reference[next]);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    long iterations = 100000;
+    uint64_t seed = 1;
+    const char* corpus = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--corpus") == 0 && i + 1 < argc)
+            corpus = argv[++i];
+        else
+            iterations = atol(argv[i]);
+    }
+
+    long failures = 0;
+    unsigned long long bytes = 0, records = 0;
+    const char* kinds[3] = { "generator", "damaged", "soup" };
+
+    std::vector<std::string> files;
+    if (corpus != nullptr)
+        files = read_corpus(corpus);
+    for (size_t f = 0; f < files.size(); f++)
+    {
+        Rng rng(seed + f);
+        Outcome outcome = parse_in_pieces(files[f], rng);
+        std::string why;
+        if (!check(files[f], outcome, nullptr, why))
+        {
+            printf("corpus file %zu: %s\n", f, why.c_str());
+            failures++;
+        }
+    }
+
+    for (long i = 0; i < iterations; i++)
+    {
+        uint64_t caseSeed = seed + (uint64_t)i;
+        Rng rng(caseSeed);
+        int kind = (int)rng.Below(3);
+        std::vector<MouseRecord> expected;
+        std::string s = kind == 2 ? token_soup(rng) : generator_stream(rng, expected);
+        if (kind == 1)
+            damage(s, rng);
+
+        Outcome outcome = parse_in_pieces(s, rng);
+        bytes += s.size();
+        records += outcome.records.size();
+        std::string why;
+        if (check(s, outcome, kind == 0 ? &expected : nullptr, why))
+            continue;
+
+        failures++;
+        printf("seed %llu (%s, %zu bytes): %s\n", (unsigned long long)caseSeed, kinds[kind], s.size(), why.c_str());
+        if (corpus != nullptr)
+        {
+            std::string path = std::string(corpus) + "/fail-" + std::to_string(caseSeed) + ".txt";
+            if (FILE* out = fopen(path.c_str(), "wb"))
+            {
+                fwrite(s.data(), 1, s.size(), out);
+                fclose(out);
+            }
+        }
+        if (failures >= 20)
+            break;
+    }
+
+    printf("%ld cases, %zu corpus files, %.1f MB, %llu records, %ld failed\n", iterations, files.size(), bytes / 1e6,
+        records, failures);
+    return failures > 0 ? 1 : 0;
+}
@@ -2,21 +2,19 @@
 //#include "eyetracker.h"
 #include "stdafx.h"
 #include "myologger.h"
+#include "record_format.h"
+#include "async_logger.h"
+#include "log_sink.h"
+#include "stream_log.h"
+#include "session_clock.h"
+#include "session_stop.h"
 #include <fstream>
 #include <sstream>
 
-#include <chrono>
-typedef std::chrono::high_resolution_clock clock_;
-typedef std::chrono::milliseconds ms_;
-std::chrono::time_point<clock_> begin_time = clock_::now();
-
-unsigned int elapsed()
-{
-	return std::chrono::duration_cast<ms_>(clock_::now() - begin_time).count();
-}
-
 // �ϴ� �� ���丮�� �־�� ������ ������ �� �ִ�.
 static std::ofstream outFile;
+//BINARY_LOGS: rows go to this logger instead of outFile
+static AsyncLogger<MyoRow>* myoLog = nullptr;
 //extern std::chrono::time_point<clock_> begin_time;
 
 // Classes that inherit from myo::DeviceListener can be used to receive events from Myo devices. DeviceListener
@@ -25,7 +23,8 @@ static std::ofstream outFile;
 class DataCollector : public myo::DeviceListener {
 public:
 	DataCollector()
-		: onArm(false), isUnlocked(false), roll(0), pitch(0), yaw(0), accl_x(0), accl_y(0), accl_z(0), gyro_x(0), gyro_y(0), gyro_z(0), currentPose(), emgSamples()
+		: onArm(false), isUnlocked(false), roll(0), pitch(0), yaw(0), accl_x(0), accl_y(0), accl_z(0), gyro_x(0), gyro_y(0), gyro_z(0), currentPose(), emgSamples(),
+		emgMicros(0), imuMicros(0)
 	{
 	}
 
@@ -45,6 +44,7 @@ public:
 	// onEmgData() is called whenever a paired Myo has provided new EMG data, and EMG streaming is enabled.
 	void onEmgData(myo::Myo* myo, uint64_t timestamp, const int8_t* emg)
 	{
+		emgMicros = timestamp;
 		for (int i = 0; i < 8; i++) {
 			emgSamples[i] = emg[i];
 		}
@@ -54,6 +54,7 @@ public:
 	// as a unit quaternion.
 	void onOrientationData(myo::Myo* myo, uint64_t timestamp, const myo::Quaternion<float>& quat)
 	{
+		imuMicros = timestamp;
 		using std::atan2;
 		using std::asin;
 		using std::sqrt;
@@ -148,7 +149,8 @@ public:
 		gyro_z = gyro.z();
 	}
 	
-	void log_data(unsigned int dt)
+	//hostNs: session_clock.h time of the row
+	void log_data(long long hostNs)
 	{
 		//timer = time(NULL); // 1970�� 1�� 1�� 0�� 0�� 0�ʺ��� �����Ͽ� ��������� ��
 		//t = localtime(&timer); // �������� ���� ����ü�� �ֱ�
@@ -158,26 +160,28 @@ public:
 		////auto dt = 123; //tmr.elapsed(); //MilliSecFromEpoch();
 		//unsigned int dt = elapsed();
 
-		outFile << dt << ", ";
-
-		// Data is valid only when onArm.
-		outFile << onArm << ", " << isUnlocked << ", " << (whichArm == myo::armLeft ? 1 : 0) << ", ";
-		outFile << roll << ", " << pitch << ", " << yaw << ", ";
-		outFile << accl_x << ", " << accl_y << ", " << accl_z << ", ";
-		outFile << gyro_x << ", " << gyro_y << ", " << gyro_z << ", ";
-
-		// Print out the EMG data.
-		for (size_t i = 0; i < emgSamples.size(); i++) {
-			std::ostringstream oss;
-			oss << static_cast<int>(emgSamples[i]);
-			std::string emgString = oss.str();
-			if (i != 0)
-				outFile << ", ";
-			outFile << emgString;
+		if (myoLog != nullptr)
+		{
+			MyoRow row = { hostNs, emgMicros, imuMicros, sample() };
+			myoLog->Push(row);
 		}
-		outFile << std::flush;
+		else
+			write_myo_row(outFile, (unsigned int)(hostNs / 1000000), sample());
+	}
 
-		outFile << std::endl;
+	// Snapshot of the values log_data writes
+	MyoSample sample() const
+	{
+		MyoSample s;
+		s.onArm = onArm;
+		s.isUnlocked = isUnlocked;
+		s.leftArm = whichArm == myo::armLeft;
+		s.roll = roll; s.pitch = pitch; s.yaw = yaw;
+		s.accl[0] = accl_x; s.accl[1] = accl_y; s.accl[2] = accl_z;
+		s.gyro[0] = gyro_x; s.gyro[1] = gyro_y; s.gyro[2] = gyro_z;
+		for (int i = 0; i < 8; i++)
+			s.emg[i] = emgSamples[i];
+		return s;
 	}
 
 	// We define this function to print the current values that were updated by the on...() functions above.
@@ -227,6 +231,9 @@ public:
 	// The values of this array is set by onEmgData() above.
 	std::array<int8_t, 8> emgSamples;
 
+	// Myo SDK timestamps (microseconds) of the newest EMG and orientation data.
+	uint64_t emgMicros, imuMicros;
+
 	//for timer
 	time_t timer;
 	struct tm* t;
@@ -234,7 +241,8 @@ public:
 
 int LogMyoArmband(std::string file_name)
 {
-
+	//the log is open, main waits for EndLog before the process ends
+	bool logging = false;
 
 	// We catch any exceptions that might occur below -- see the catch statement for more details.
 	try {
@@ -272,9 +280,26 @@ int LogMyoArmband(std::string file_name)
 		// Hub::run() to send events to all registered device listeners.
 		hub.addListener(&collector);
 		
+		if (!session_stop().BeginLog())
+			return 0;
+		logging = true;
 
 		// define an ofstream for log
-		outFile = std::ofstream("rawdata/" + file_name + ".csv");
+		const std::string logPath = "rawdata/" + file_name + (BINARY_LOGS ? ".bin" : ".csv");
+		std::unique_ptr<LogSink> logFile;
+		StreamLogEncoder<MyoRow> encoder(myo_schema());
+		std::unique_ptr<AsyncLogger<MyoRow> > logger;
+		if (BINARY_LOGS)
+		{
+			logFile = open_log_sink(logPath.c_str(), MMAP_LOGS);
+			if (!logFile)
+				throw std::runtime_error("Unable to open " + logPath);
+			logger.reset(new AsyncLogger<MyoRow>(*logFile, encoder, LOG_FLUSH_MS));
+			logger->Start();
+			myoLog = logger.get();
+		}
+		else
+			outFile = std::ofstream(logPath);
 		//tmr.write_epoch_time(outFile);
 
 
@@ -291,11 +316,11 @@ int LogMyoArmband(std::string file_name)
 
 		bool recordingStarted = false;
 
-		unsigned int last = elapsed();
-		unsigned int now;
+		long long last = session_ns();
+		long long now;
 
 		// Finally we enter our main loop.
-		while (1) {
+		while (!session_stop().Requested()) {
 			// In each iteration of our main loop, we run the Myo event loop for a set number of milliseconds.
 			// In this case, we wish to update our display 20 times a second, so we run for 1000/20 milliseconds. -> hub.run(1000 / 20);
 			// EMG(5ms), IMU(20ms)�ε� �츮�� ���� ª�� interval�� 5ms�� �����ϵ��� �Ѵ�.
@@ -307,29 +332,41 @@ int LogMyoArmband(std::string file_name)
 			
 			if (collector.onArm) { //(RECORDING) {
 				if (!recordingStarted) {
-					std::cout << "MyoArmband : Logging Start (saved at rawdata/" + file_name + ".csv)" << std::endl;
+					std::cout << "MyoArmband : Logging Start (saved at " + logPath + ")" << std::endl;
 					recordingStarted = true;
 				}
-				now = elapsed();
-				if (now - last >= 20)
+				now = session_ns();
+				if (now - last >= 20000000)
 				{
 					collector.log_data(now);
-					collector.print(now);
+					collector.print((unsigned int)(now / 1000000));
 					last = now;
 				}
 			}
 			// if _sleep, kill thread and flush logFile
 			else { //(UDP_DEFINED && recordingStarted) {
-				//tmr.write_finish_time(outFile);
-				outFile.close();
 				std::cout << "MyoArmband : Finished by LoggerSlate" << std::endl;
-				return 0;
+				break;
 			}
 		}
 
+		//off the arm or main ends the session: rows still queued go out, the file is trimmed and closed
+		//tmr.write_finish_time(outFile);
+		outFile.close();
+		myoLog = nullptr;
+		logger.reset();
+		logFile.reset();
+		session_stop().EndLog();
+		return 0;
+
 		// If a standard exception occurred, we print out its message and exit.
 	}
 	catch (const std::exception& e) {
+		//the logger and its file went with the try block
+		myoLog = nullptr;
+		outFile.close();
+		if (logging)
+			session_stop().EndLog();
 		//std::cout << "MyoArmband : Error! " << e.what() << std::endl;
 		std::cerr << "MyoArmband : Error! " << e.what() << std::endl;
 		std::cerr << "MyoArmband : Press any key to exit...";
@@ -19,6 +19,4 @@
 //std::mutex global_mutex;
 
 
-unsigned int elapsed();
-
 int LogMyoArmband(std::string file_name);
\ No newline at end of file
@@ -0,0 +1,368 @@
+#include "odometry_batch.h"
+
+#include <math.h>
+#include <algorithm>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#define ODOMETRY_X86
+#define TARGET_SSE2
+#define TARGET_AVX2
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ODOMETRY_X86
+//Only these functions use the instructions, the rest of the build stays generic
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+static const double PI = 3.14159265358979323846;
+//Samples per pass, the three passes over a block stay in cache
+static const size_t BLOCK = 1024;
+
+//Cephes sin/cos polynomials on [-pi/4, pi/4]
+static const double SIN_C0 = 1.58962301576546568060e-10;
+static const double SIN_C1 = -2.50507477628578072866e-8;
+static const double SIN_C2 = 2.75573136213857245213e-6;
+static const double SIN_C3 = -1.98412698295895385996e-4;
+static const double SIN_C4 = 8.33333333332211858878e-3;
+static const double SIN_C5 = -1.66666666666666307295e-1;
+static const double COS_C0 = -1.13585365213876817300e-11;
+static const double COS_C1 = 2.08757008419747316778e-9;
+static const double COS_C2 = -2.75573141792967388112e-7;
+static const double COS_C3 = 2.48015872888517045348e-5;
+static const double COS_C4 = -1.38888888888730564116e-3;
+static const double COS_C5 = 4.16666666666665929218e-2;
+//pi/2 in three parts for the Cody-Waite reduction, the first two have
+//enough trailing zero bits that q * part is exact
+static const double PIO2_1 = 1.57079625129699707031e+00;
+static const double PIO2_2 = 7.54978941586159635336e-08;
+static const double PIO2_3 = 5.39030285815811905290e-15;
+static const double TWO_OVER_PI = 0.63661977236758134308;
+//Adding 1.5 * 2^52 rounds to an integer and leaves it in the low mantissa bits
+static const double ROUND_MAGIC = 6755399441055744.0;
+
+struct ReckonParams
+{
+    double radPerCount;
+    double invCpi;
+};
+
+struct ReckonState
+{
+    double heading;
+    double x, y;
+};
+
+//Rotated, arc corrected step of one sample, also used for the tails of the SIMD blocks
+static inline void reckon_step(double d, double mid, double fx, double fy, double invCpi, double& stepX, double& stepY)
+{
+    double c = cos(mid);
+    double s = sin(mid);
+    double h = 0.5 * d;
+    double arc = h == 0 ? 1.0 : h / sin(h);
+    stepX = arc * (c * fx + s * fy) * invCpi;
+    stepY = arc * (c * fy - s * fx) * invCpi;
+}
+
+static void reckon_block_scalar(const int* dx1, const int* dy1, const int* dx2, size_t n,
+    const ReckonParams& p, ReckonState& st, double* x, double* y, double* theta)
+{
+    double heading = st.heading;
+    for (size_t i = 0; i < n; i++)
+    {
+        heading += (dx1[i] + dx2[i]) * p.radPerCount;
+        theta[i] = heading;
+    }
+    st.heading = heading;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        double d = (dx1[i] + dx2[i]) * p.radPerCount;
+        reckon_step(d, theta[i] - 0.5 * d, dx1[i], dy1[i], p.invCpi, x[i], y[i]);
+        theta[i] *= 180 / PI;
+    }
+
+    double px = st.x, py = st.y;
+    for (size_t i = 0; i < n; i++)
+    {
+        px += x[i];
+        py += y[i];
+        x[i] = px;
+        y[i] = py;
+    }
+    st.x = px;
+    st.y = py;
+}
+
+#ifdef ODOMETRY_X86
+
+TARGET_SSE2 static inline void sincos_sse2(__m128d x, __m128d& s, __m128d& c)
+{
+    const __m128d magic = _mm_set1_pd(ROUND_MAGIC);
+    __m128d qm = _mm_add_pd(_mm_mul_pd(x, _mm_set1_pd(TWO_OVER_PI)), magic);
+    __m128d q = _mm_sub_pd(qm, magic);
+    __m128d r = _mm_sub_pd(x, _mm_mul_pd(q, _mm_set1_pd(PIO2_1)));
+    r = _mm_sub_pd(r, _mm_mul_pd(q, _mm_set1_pd(PIO2_2)));
+    r = _mm_sub_pd(r, _mm_mul_pd(q, _mm_set1_pd(PIO2_3)));
+    __m128d z = _mm_mul_pd(r, r);
+
+    __m128d ps = _mm_set1_pd(SIN_C0);
+    ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(SIN_C1));
+    ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(SIN_C2));
+    ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(SIN_C3));
+    ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(SIN_C4));
+    ps = _mm_add_pd(_mm_mul_pd(ps, z), _mm_set1_pd(SIN_C5));
+    __m128d sr = _mm_add_pd(r, _mm_mul_pd(_mm_mul_pd(r, z), ps));
+
+    __m128d pc = _mm_set1_pd(COS_C0);
+    pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(COS_C1));
+    pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(COS_C2));
+    pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(COS_C3));
+    pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(COS_C4));
+    pc = _mm_add_pd(_mm_mul_pd(pc, z), _mm_set1_pd(COS_C5));
+    __m128d cr = _mm_add_pd(_mm_sub_pd(_mm_set1_pd(1.0), _mm_mul_pd(_mm_set1_pd(0.5), z)), _mm_mul_pd(_mm_mul_pd(z, z), pc));
+
+    //Quadrant q mod 4: odd swaps sin and cos, then the signs follow q and q + 1
+    __m128i qi = _mm_castpd_si128(qm);
+    __m128i one = _mm_set1_epi64x(1);
+    __m128i two = _mm_set1_epi64x(2);
+    __m128d swap = _mm_castsi128_pd(_mm_sub_epi64(_mm_setzero_si128(), _mm_and_si128(qi, one)));
+    __m128d sinSign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(qi, two), 62));
+    __m128d cosSign = _mm_castsi128_pd(_mm_slli_epi64(_mm_and_si128(_mm_add_epi64(qi, one), two), 62));
+    s = _mm_xor_pd(_mm_or_pd(_mm_and_pd(swap, cr), _mm_andnot_pd(swap, sr)), sinSign);
+    c = _mm_xor_pd(_mm_or_pd(_mm_and_pd(swap, sr), _mm_andnot_pd(swap, cr)), cosSign);
+}
+
+//Inclusive prefix sum of v, plus everything before it in carry
+TARGET_SSE2 static inline __m128d scan_sse2(__m128d v, __m128d& carry)
+{
+    __m128d t = _mm_add_pd(v, _mm_castsi128_pd(_mm_slli_si128(_mm_castpd_si128(v), 8)));
+    t = _mm_add_pd(t, carry);
+    carry = _mm_unpackhi_pd(t, t);
+    return t;
+}
+
+TARGET_SSE2 static inline __m128d rotation_sse2(const int* dx1, const int* dx2, __m128d radPerCount)
+{
+    __m128i sum = _mm_add_epi32(_mm_loadl_epi64((const __m128i*)dx1), _mm_loadl_epi64((const __m128i*)dx2));
+    return _mm_mul_pd(_mm_cvtepi32_pd(sum), radPerCount);
+}
+
+TARGET_SSE2 static void reckon_block_sse2(const int* dx1, const int* dy1, const int* dx2, size_t n,
+    const ReckonParams& p, ReckonState& st, double* x, double* y, double* theta)
+{
+    const __m128d radPerCount = _mm_set1_pd(p.radPerCount);
+    size_t vn = n & ~(size_t)1;
+
+    __m128d carry = _mm_set1_pd(st.heading);
+    for (size_t i = 0; i < vn; i += 2)
+        _mm_storeu_pd(theta + i, scan_sse2(rotation_sse2(dx1 + i, dx2 + i, radPerCount), carry));
+    double heading = _mm_cvtsd_f64(carry);
+    for (size_t i = vn; i < n; i++)
+    {
+        heading += (dx1[i] + dx2[i]) * p.radPerCount;
+        theta[i] = heading;
+    }
+    st.heading = heading;
+
+    const __m128d half = _mm_set1_pd(0.5);
+    const __m128d oneD = _mm_set1_pd(1.0);
+    const __m128d invCpi = _mm_set1_pd(p.invCpi);
+    const __m128d toDegree = _mm_set1_pd(180 / PI);
+    for (size_t i = 0; i < vn; i += 2)
+    {
+        __m128d d = rotation_sse2(dx1 + i, dx2 + i, radPerCount);
+        __m128d th = _mm_loadu_pd(theta + i);
+        __m128d h = _mm_mul_pd(half, d);
+        __m128d s, c, sh, ch;
+        sincos_sse2(_mm_sub_pd(th, h), s, c);
+        sincos_sse2(h, sh, ch);
+        __m128d still = _mm_cmpeq_pd(h, _mm_setzero_pd());
+        __m128d arc = _mm_or_pd(_mm_and_pd(still, oneD), _mm_andnot_pd(still, _mm_div_pd(h, sh)));
+        arc = _mm_mul_pd(arc, invCpi);
+
+        __m128d fx = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(dx1 + i)));
+        __m128d fy = _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i*)(dy1 + i)));
+        _mm_storeu_pd(x + i, _mm_mul_pd(arc, _mm_add_pd(_mm_mul_pd(c, fx), _mm_mul_pd(s, fy))));
+        _mm_storeu_pd(y + i, _mm_mul_pd(arc, _mm_sub_pd(_mm_mul_pd(c, fy), _mm_mul_pd(s, fx))));
+        _mm_storeu_pd(theta + i, _mm_mul_pd(th, toDegree));
+    }
+    for (size_t i = vn; i < n; i++)
+    {
+        double d = (dx1[i] + dx2[i]) * p.radPerCount;
+        reckon_step(d, theta[i] - 0.5 * d, dx1[i], dy1[i], p.invCpi, x[i], y[i]);
+        theta[i] *= 180 / PI;
+    }
+
+    __m128d carryX = _mm_set1_pd(st.x);
+    __m128d carryY = _mm_set1_pd(st.y);
+    for (size_t i = 0; i < vn; i += 2)
+    {
+        _mm_storeu_pd(x + i, scan_sse2(_mm_loadu_pd(x + i), carryX));
+        _mm_storeu_pd(y + i, scan_sse2(_mm_loadu_pd(y + i), carryY));
+    }
+    double px = _mm_cvtsd_f64(carryX), py = _mm_cvtsd_f64(carryY);
+    for (size_t i = vn; i < n; i++)
+    {
+        px += x[i];
+        py += y[i];
+        x[i] = px;
+        y[i] = py;
+    }
+    st.x = px;
+    st.y = py;
+}
+
+TARGET_AVX2 static inline void sincos_avx2(__m256d x, __m256d& s, __m256d& c)
+{
+    const __m256d magic = _mm256_set1_pd(ROUND_MAGIC);
+    __m256d qm = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(TWO_OVER_PI)), magic);
+    __m256d q = _mm256_sub_pd(qm, magic);
+    __m256d r = _mm256_sub_pd(x, _mm256_mul_pd(q, _mm256_set1_pd(PIO2_1)));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(q, _mm256_set1_pd(PIO2_2)));
+    r = _mm256_sub_pd(r, _mm256_mul_pd(q, _mm256_set1_pd(PIO2_3)));
+    __m256d z = _mm256_mul_pd(r, r);
+
+    __m256d ps = _mm256_set1_pd(SIN_C0);
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(SIN_C1));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(SIN_C2));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(SIN_C3));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(SIN_C4));
+    ps = _mm256_add_pd(_mm256_mul_pd(ps, z), _mm256_set1_pd(SIN_C5));
+    __m256d sr = _mm256_add_pd(r, _mm256_mul_pd(_mm256_mul_pd(r, z), ps));
+
+    __m256d pc = _mm256_set1_pd(COS_C0);
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(COS_C1));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(COS_C2));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(COS_C3));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(COS_C4));
+    pc = _mm256_add_pd(_mm256_mul_pd(pc, z), _mm256_set1_pd(COS_C5));
+    __m256d cr = _mm256_add_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), _mm256_mul_pd(_mm256_set1_pd(0.5), z)),
+        _mm256_mul_pd(_mm256_mul_pd(z, z), pc));
+
+    __m256i qi = _mm256_castpd_si256(qm);
+    __m256i one = _mm256_set1_epi64x(1);
+    __m256i two = _mm256_set1_epi64x(2);
+    __m256d swap = _mm256_castsi256_pd(_mm256_sub_epi64(_mm256_setzero_si256(), _mm256_and_si256(qi, one)));
+    __m256d sinSign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(qi, two), 62));
+    __m256d cosSign = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_and_si256(_mm256_add_epi64(qi, one), two), 62));
+    s = _mm256_xor_pd(_mm256_blendv_pd(sr, cr, swap), sinSign);
+    c = _mm256_xor_pd(_mm256_blendv_pd(cr, sr, swap), cosSign);
+}
+
+TARGET_AVX2 static inline __m256d scan_avx2(__m256d v, __m256d& carry)
+{
+    //[v0, v0+v1, v1+v2, v2+v3], then add the lower half onto the upper one
+    __m256d t = _mm256_add_pd(v, _mm256_blend_pd(_mm256_permute4x64_pd(v, _MM_SHUFFLE(2, 1, 0, 0)), _mm256_setzero_pd(), 1));
+    t = _mm256_add_pd(t, _mm256_permute2f128_pd(t, t, 0x08));
+    t = _mm256_add_pd(t, carry);
+    carry = _mm256_permute4x64_pd(t, _MM_SHUFFLE(3, 3, 3, 3));
+    return t;
+}
+
+TARGET_AVX2 static inline __m256d rotation_avx2(const int* dx1, const int* dx2, __m256d radPerCount)
+{
+    __m128i sum = _mm_add_epi32(_mm_loadu_si128((const __m128i*)dx1), _mm_loadu_si128((const __m128i*)dx2));
+    return _mm256_mul_pd(_mm256_cvtepi32_pd(sum), radPerCount);
+}
+
+TARGET_AVX2 static void reckon_block_avx2(const int* dx1, const int* dy1, const int* dx2, size_t n,
+    const ReckonParams& p, ReckonState& st, double* x, double* y, double* theta)
+{
+    const __m256d radPerCount = _mm256_set1_pd(p.radPerCount);
+    size_t vn = n & ~(size_t)3;
+
+    __m256d carry = _mm256_set1_pd(st.heading);
+    for (size_t i = 0; i < vn; i += 4)
+        _mm256_storeu_pd(theta + i, scan_avx2(rotation_avx2(dx1 + i, dx2 + i, radPerCount), carry));
+    double heading = _mm256_cvtsd_f64(carry);
+    for (size_t i = vn; i < n; i++)
+    {
+        heading += (dx1[i] + dx2[i]) * p.radPerCount;
+        theta[i] = heading;
+    }
+    st.heading = heading;
+
+    const __m256d half = _mm256_set1_pd(0.5);
+    const __m256d oneD = _mm256_set1_pd(1.0);
+    const __m256d invCpi = _mm256_set1_pd(p.invCpi);
+    const __m256d toDegree = _mm256_set1_pd(180 / PI);
+    for (size_t i = 0; i < vn; i += 4)
+    {
+        __m256d d = rotation_avx2(dx1 + i, dx2 + i, radPerCount);
+        __m256d th = _mm256_loadu_pd(theta + i);
+        __m256d h = _mm256_mul_pd(half, d);
+        __m256d s, c, sh, ch;
+        sincos_avx2(_mm256_sub_pd(th, h), s, c);
+        sincos_avx2(h, sh, ch);
+        __m256d still = _mm256_cmp_pd(h, _mm256_setzero_pd(), _CMP_EQ_OQ);
+        __m256d arc = _mm256_mul_pd(_mm256_blendv_pd(_mm256_div_pd(h, sh), oneD, still), invCpi);
+
+        __m256d fx = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(dx1 + i)));
+        __m256d fy = _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i*)(dy1 + i)));
+        _mm256_storeu_pd(x + i, _mm256_mul_pd(arc, _mm256_add_pd(_mm256_mul_pd(c, fx), _mm256_mul_pd(s, fy))));
+        _mm256_storeu_pd(y + i, _mm256_mul_pd(arc, _mm256_sub_pd(_mm256_mul_pd(c, fy), _mm256_mul_pd(s, fx))));
+        _mm256_storeu_pd(theta + i, _mm256_mul_pd(th, toDegree));
+    }
+    for (size_t i = vn; i < n; i++)
+    {
+        double d = (dx1[i] + dx2[i]) * p.radPerCount;
+        reckon_step(d, theta[i] - 0.5 * d, dx1[i], dy1[i], p.invCpi, x[i], y[i]);
+        theta[i] *= 180 / PI;
+    }
+
+    __m256d carryX = _mm256_set1_pd(st.x);
+    __m256d carryY = _mm256_set1_pd(st.y);
+    for (size_t i = 0; i < vn; i += 4)
+    {
+        _mm256_storeu_pd(x + i, scan_avx2(_mm256_loadu_pd(x + i), carryX));
+        _mm256_storeu_pd(y + i, scan_avx2(_mm256_loadu_pd(y + i), carryY));
+    }
+    double px = _mm256_cvtsd_f64(carryX), py = _mm256_cvtsd_f64(carryY);
+    for (size_t i = vn; i < n; i++)
+    {
+        px += x[i];
+        py += y[i];
+        x[i] = px;
+        y[i] = py;
+    }
+    st.x = px;
+    st.y = py;
+}
+
+#endif // ODOMETRY_X86
+
+void dead_reckon_batch(const int* dx1, const int* dy1, const int* dx2, size_t count,
+    double cpi, double sensorDistance, double x0, double y0, double theta0,
+    double* x, double* y, double* theta, SimdLevel level)
+{
+    //Never run code the CPU can't execute
+    if ((int)level > (int)simd_level_best())
+        level = simd_level_best();
+
+    ReckonParams p;
+    //MouseOdometry's degrees per count, in radians
+    p.radPerCount = 1.0 / (sensorDistance * cpi);
+    p.invCpi = 1.0 / cpi;
+    ReckonState st = { theta0 * PI / 180, x0, y0 };
+
+    for (size_t start = 0; start < count; start += BLOCK)
+    {
+        size_t n = std::min(BLOCK, count - start);
+        switch (level)
+        {
+#ifdef ODOMETRY_X86
+        case SimdLevel::Avx2:
+            reckon_block_avx2(dx1 + start, dy1 + start, dx2 + start, n, p, st, x + start, y + start, theta + start);
+            break;
+        case SimdLevel::Sse2:
+            reckon_block_sse2(dx1 + start, dy1 + start, dx2 + start, n, p, st, x + start, y + start, theta + start);
+            break;
+#endif
+        default:
+            reckon_block_scalar(dx1 + start, dy1 + start, dx2 + start, n, p, st, x + start, y + start, theta + start);
+            break;
+        }
+    }
+}
@@ -0,0 +1,181 @@
+#ifndef POSE_HISTORY_H_INCLUDED
+#define POSE_HISTORY_H_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+
+// One tracked sample: mouse pose on the pad and the arm's joint angles
+struct PoseSample
+{
+    //Position in the history, counts up from 0 with every Push
+    uint64_t seq;
+    //Sample time in the byte source's timebase (Code.cpp sampleNs)
+    long long timeNs;
+    double x, y, theta;
+    double degree1, degree2, degree3;
+};
+
+// The last depth samples of the tracking loop, for threads other than the
+// loop (publisher, logger, drift correction) to read without a lock.
+//
+// One writer thread calls Push, any number of readers call Latest, Snapshot
+// or ReadFrom. The columns are separate arrays (struct of arrays) and every
+// slot carries a sequence word the writer makes odd while it rewrites the
+// slot, a seqlock per slot. Readers never block the writer, they retry or
+// skip a slot the writer lapped them on, so every sample they return is
+// consistent, and the writer never waits for anyone.
+class PoseHistory
+{
+public:
+    //depth is rounded up to a power of two
+    explicit PoseHistory(size_t minDepth)
+        : depth(RoundUp(minDepth)), mask(depth - 1), stamp(new std::atomic<uint64_t>[depth]),
+        timeNs(new std::atomic<long long>[depth]), x(new std::atomic<double>[depth]), y(new std::atomic<double>[depth]),
+        theta(new std::atomic<double>[depth]), degree1(new std::atomic<double>[depth]),
+        degree2(new std::atomic<double>[depth]), degree3(new std::atomic<double>[depth]), count(0), continuousFrom(0)
+    {
+        for (size_t i = 0; i < depth; i++)
+            stamp[i].store(0, std::memory_order_relaxed);
+    }
+
+    //Writer side, returns the sequence number the sample got (sample.seq is ignored)
+    uint64_t Push(const PoseSample& sample)
+    {
+        const uint64_t seq = count.load(std::memory_order_relaxed);
+        const size_t slot = (size_t)seq & mask;
+
+        //odd while the slot is rewritten, 2 * (seq + 1) once it holds sample seq
+        stamp[slot].store(2 * seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        timeNs[slot].store(sample.timeNs, std::memory_order_relaxed);
+        x[slot].store(sample.x, std::memory_order_relaxed);
+        y[slot].store(sample.y, std::memory_order_relaxed);
+        theta[slot].store(sample.theta, std::memory_order_relaxed);
+        degree1[slot].store(sample.degree1, std::memory_order_relaxed);
+        degree2[slot].store(sample.degree2, std::memory_order_relaxed);
+        degree3[slot].store(sample.degree3, std::memory_order_relaxed);
+        stamp[slot].store(2 * seq + 2, std::memory_order_release);
+
+        count.store(seq + 1, std::memory_order_release);
+        return seq;
+    }
+
+    //Writer side: the samples pushed from now on do not continue the ones
+    //before (the pose jumped, e.g. the clutch reset the odometry)
+    void MarkDiscontinuity() { continuousFrom.store(count.load(std::memory_order_relaxed), std::memory_order_release); }
+
+    //Samples pushed so far, the next one gets this sequence number
+    uint64_t Count() const { return count.load(std::memory_order_acquire); }
+    //First sequence number after the last MarkDiscontinuity, 0 if there was none.
+    //Read it after the samples: a newer value only drops more of them.
+    uint64_t ContinuousFrom() const { return continuousFrom.load(std::memory_order_acquire); }
+    size_t Depth() const { return depth; }
+
+    //Newest sample, false while there is none
+    bool Latest(PoseSample& sample) const
+    {
+        for (;;)
+        {
+            const uint64_t end = Count();
+            if (end == 0)
+                return false;
+            if (Read(end - 1, sample))
+                return true;
+            //lapped by a whole ring between the two loads, try the new newest
+        }
+    }
+
+    //Up to maxCount of the newest samples into out, oldest first. Returns how
+    //many; fewer than asked when the history is shorter or the writer
+    //overwrote the oldest ones while they were copied.
+    size_t Snapshot(PoseSample* out, size_t maxCount) const
+    {
+        const uint64_t end = Count();
+        uint64_t begin = end - Available(end, maxCount);
+        return Copy(begin, end, out);
+    }
+
+    //Incremental reading for a consumer that wants every sample: copies up
+    //to maxCount samples from next on and advances next past them. A reader
+    //that fell more than Depth() behind continues at the oldest sample still
+    //there; next - the first returned seq is how many it missed.
+    size_t ReadFrom(uint64_t& next, PoseSample* out, size_t maxCount) const
+    {
+        const uint64_t end = Count();
+        if (next > end)
+            next = end;
+        const uint64_t oldest = end - Available(end, depth);
+        if (next < oldest)
+            next = oldest;
+        uint64_t stop = end - next > maxCount ? next + maxCount : end;
+
+        size_t n = Copy(next, stop, out);
+        next = n ? out[n - 1].seq + 1 : stop;
+        return n;
+    }
+
+private:
+    static size_t RoundUp(size_t value)
+    {
+        size_t result = 1;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    size_t Available(uint64_t end, size_t maxCount) const
+    {
+        uint64_t n = end < depth ? end : depth;
+        return n < maxCount ? (size_t)n : maxCount;
+    }
+
+    //One consistent sample seq, false if it's being written or already overwritten
+    bool Read(uint64_t seq, PoseSample& sample) const
+    {
+        const size_t slot = (size_t)seq & mask;
+        const uint64_t expected = 2 * seq + 2;
+        if (stamp[slot].load(std::memory_order_acquire) != expected)
+            return false;
+
+        sample.seq = seq;
+        sample.timeNs = timeNs[slot].load(std::memory_order_relaxed);
+        sample.x = x[slot].load(std::memory_order_relaxed);
+        sample.y = y[slot].load(std::memory_order_relaxed);
+        sample.theta = theta[slot].load(std::memory_order_relaxed);
+        sample.degree1 = degree1[slot].load(std::memory_order_relaxed);
+        sample.degree2 = degree2[slot].load(std::memory_order_relaxed);
+        sample.degree3 = degree3[slot].load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return stamp[slot].load(std::memory_order_relaxed) == expected;
+    }
+
+    //Samples [begin, end) into out. A sample that fails means the writer has
+    //lapped everything before it as well, so what was copied so far is
+    //dropped and the copy goes on after it.
+    size_t Copy(uint64_t begin, uint64_t end, PoseSample* out) const
+    {
+        size_t n = 0;
+        for (uint64_t seq = begin; seq < end; seq++)
+        {
+            if (Read(seq, out[n]))
+                n++;
+            else
+                n = 0;
+        }
+        return n;
+    }
+
+    const size_t depth;
+    const size_t mask;
+    std::unique_ptr<std::atomic<uint64_t>[]> stamp;
+    std::unique_ptr<std::atomic<long long>[]> timeNs;
+    std::unique_ptr<std::atomic<double>[]> x, y, theta;
+    std::unique_ptr<std::atomic<double>[]> degree1, degree2, degree3;
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> continuousFrom;
+};
+
+#endif // POSE_HISTORY_H_INCLUDED
@@ -0,0 +1,73 @@
+#ifndef POSE_PACKET_H_INCLUDED
+#define POSE_PACKET_H_INCLUDED
+
+// Binary UDP datagram with one tracked pose, Code.cpp -> visual.py.
+// Replaces the "%lf %lf ... \n" text, which is still there as an option.
+//
+// Datagram layout, version 1 (104 bytes, little endian, doubles IEEE 754):
+//   [0..3]    magic "PMWP"
+//   [4..5]    version (POSE_PACKET_VERSION)
+//   [6..7]    flags (POSE_FLAG_*)
+//   [8..11]   sequence number, +1 per datagram, wraps at 2^32
+//   [12..15]  device micros() of the report, valid with POSE_FLAG_DEVICE_TIME
+//   [16..23]  sample time, host ns (Code.cpp sampleNs)
+//   [24..103] x1, y1, x2, y2, x, y, degree1, degree2, degree3, theta
+// The ten doubles are the fields of the text format, in the same order.
+// A receiver checks the magic and version and must not assume the size:
+// later versions only append fields.
+
+#include <stdint.h>
+#include <string.h>
+
+#define POSE_PACKET_MAGIC "PMWP"
+#define POSE_PACKET_VERSION 1
+#define POSE_PACKET_SIZE 104
+
+//deviceMicros is valid (firmware stamps its reports)
+#define POSE_FLAG_DEVICE_TIME 0x0001
+//pose was extrapolated to the display time (PosePredictor)
+#define POSE_FLAG_PREDICTED   0x0002
+
+struct PosePacket
+{
+    uint16_t flags;
+    uint32_t seq;
+    uint32_t deviceMicros;
+    int64_t hostNs;
+    double x1, y1, x2, y2;
+    double x, y;
+    double degree1, degree2, degree3;
+    double theta;
+};
+
+inline void pose_packet_put(uint8_t* out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        out[i] = (uint8_t)(value >> (8 * i));
+}
+
+inline void pose_packet_put_double(uint8_t* out, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    pose_packet_put(out, bits, 8);
+}
+
+//Write one datagram into out[POSE_PACKET_SIZE], returns POSE_PACKET_SIZE
+inline int pose_packet_encode(const PosePacket& packet, uint8_t* out)
+{
+    memcpy(out, POSE_PACKET_MAGIC, 4);
+    pose_packet_put(out + 4, POSE_PACKET_VERSION, 2);
+    pose_packet_put(out + 6, packet.flags, 2);
+    pose_packet_put(out + 8, packet.seq, 4);
+    pose_packet_put(out + 12, packet.deviceMicros, 4);
+    pose_packet_put(out + 16, (uint64_t)packet.hostNs, 8);
+
+    const double fields[10] = { packet.x1, packet.y1, packet.x2, packet.y2, packet.x, packet.y,
+        packet.degree1, packet.degree2, packet.degree3, packet.theta };
+    for (int i = 0; i < 10; i++)
+        pose_packet_put_double(out + 24 + 8 * i, fields[i]);
+    return POSE_PACKET_SIZE;
+}
+
+#endif // POSE_PACKET_H_INCLUDED
@@ -0,0 +1,154 @@
+#include "pose_predictor.h"
+
+#include <math.h>
+
+PosePredictor::PosePredictor(size_t window, long long maxLeadNs)
+    : window(window < 2 ? 2 : window), maxLeadNs(maxLeadNs), recent(this->window)
+{
+}
+
+bool PosePredictor::Predict(const PoseHistory& history, long long targetNs, PoseSample& out)
+{
+    size_t n = history.Snapshot(recent.data(), window);
+    //a fit across a discontinuity would read the jump as velocity
+    const uint64_t from = history.ContinuousFrom();
+    size_t skip = 0;
+    while (skip < n && recent[skip].seq < from)
+        skip++;
+    const PoseSample* samples = recent.data() + skip;
+    n -= skip;
+    if (n == 0)
+        return false;
+
+    const PoseSample& newest = samples[n - 1];
+    out = newest;
+
+    //least squares slopes over the window, times relative to the newest sample
+    double meanT = 0, meanX = 0, meanY = 0, meanTheta = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        meanT += (double)(samples[i].timeNs - newest.timeNs);
+        meanX += samples[i].x;
+        meanY += samples[i].y;
+        meanTheta += samples[i].theta;
+    }
+    meanT /= n;
+    meanX /= n;
+    meanY /= n;
+    meanTheta /= n;
+
+    double stt = 0, stx = 0, sty = 0, stTheta = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        double t = (double)(samples[i].timeNs - newest.timeNs) - meanT;
+        stt += t * t;
+        stx += t * (samples[i].x - meanX);
+        sty += t * (samples[i].y - meanY);
+        stTheta += t * (samples[i].theta - meanTheta);
+    }
+    if (stt <= 0)
+        return true;
+
+    long long lead = targetNs - newest.timeNs;
+    if (lead > maxLeadNs)
+        lead = maxLeadNs;
+    if (lead < 0)
+        lead = 0;
+
+    //extrapolate from the fitted line rather than the newest sample, which
+    //carries the full noise of one report
+    double t = (double)lead - meanT;
+    out.x = meanX + stx / stt * t;
+    out.y = meanY + sty / stt * t;
+    out.theta = meanTheta + stTheta / stt * t;
+    out.timeNs = newest.timeNs + lead;
+    return true;
+}
+
+void PredictionStats::Error::Add(double value)
+{
+    count++;
+    sum += value;
+    sumSquares += value * value;
+    if (value > max)
+        max = value;
+}
+
+PredictionStats::PredictionStats()
+    : pending(256), first(0), size(0), overflow(0), haveLast(false)
+{
+    Error zero = { 0, 0, 0, 0 };
+    predictedPosition = predictedTheta = stalePosition = staleTheta = zero;
+}
+
+void PredictionStats::Expect(long long targetNs, const PoseSample& predicted, const PoseSample& newest)
+{
+    if (size == pending.size())
+    {
+        first = (first + 1) % pending.size();
+        size--;
+        overflow++;
+    }
+    Pending& p = pending[(first + size) % pending.size()];
+    p.targetNs = targetNs;
+    p.predictedX = predicted.x;
+    p.predictedY = predicted.y;
+    p.predictedTheta = predicted.theta;
+    p.staleX = newest.x;
+    p.staleY = newest.y;
+    p.staleTheta = newest.theta;
+    size++;
+}
+
+void PredictionStats::Actual(const PoseSample& sample)
+{
+    while (size > 0)
+    {
+        const Pending& p = pending[first];
+        if (p.targetNs > sample.timeNs)
+            break;
+
+        //where the mouse was at the target time
+        double x = sample.x, y = sample.y, theta = sample.theta;
+        if (haveLast && p.targetNs > last.timeNs && sample.timeNs > last.timeNs)
+        {
+            double f = (double)(p.targetNs - last.timeNs) / (double)(sample.timeNs - last.timeNs);
+            x = last.x + (sample.x - last.x) * f;
+            y = last.y + (sample.y - last.y) * f;
+            theta = last.theta + (sample.theta - last.theta) * f;
+        }
+        predictedPosition.Add(hypot(p.predictedX - x, p.predictedY - y));
+        predictedTheta.Add(fabs(p.predictedTheta - theta));
+        stalePosition.Add(hypot(p.staleX - x, p.staleY - y));
+        staleTheta.Add(fabs(p.staleTheta - theta));
+
+        first = (first + 1) % pending.size();
+        size--;
+    }
+    last = sample;
+    haveLast = true;
+}
+
+void PredictionStats::Discontinuity()
+{
+    first = 0;
+    size = 0;
+    haveLast = false;
+}
+
+void PredictionStats::Report(FILE* out) const
+{
+    if (predictedPosition.count == 0)
+        return;
+
+    const Error* rows[4] = { &predictedPosition, &stalePosition, &predictedTheta, &staleTheta };
+    const char* names[4] = { "predicted position (in) ", "newest sample position  ", "predicted theta (deg)   ", "newest sample theta     " };
+    fprintf(out, "pose prediction over %llu samples:\n", predictedPosition.count);
+    for (int i = 0; i < 4; i++)
+    {
+        const Error& e = *rows[i];
+        fprintf(out, "  %s mean %.5f  rms %.5f  max %.5f\n", names[i], e.sum / e.count, sqrt(e.sumSquares / e.count), e.max);
+    }
+    if (overflow)
+        fprintf(out, "  %llu predictions dropped unchecked\n", overflow);
+}
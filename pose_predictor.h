@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdio.h>
+#include <vector>
+
+#include "pose_history.h"
+
+// Pose the visualiser should draw when it gets to draw it. By the time a
+// sample is sent it is already old by the serial link, parsing and the
+// render loop of visual.py; PosePredictor fits linear and angular velocity
+// over the newest samples of a PoseHistory and extrapolates the mouse pose
+// to a target time. Joint angles are not extrapolated, solve the predicted
+// pose again (solve_arm) so the arm reaches it.
+class PosePredictor
+{
+public:
+    //window: samples in the velocity fit, maxLeadNs: never extrapolate further
+    explicit PosePredictor(size_t window = 8, long long maxLeadNs = 100000000);
+
+    //Newest sample of history moved to targetNs (sample timebase). Fits
+    //only the samples since the history's last discontinuity. False, and
+    //out untouched, while there are none; with one sample or samples all
+    //at the same time out is that sample.
+    bool Predict(const PoseHistory& history, long long targetNs, PoseSample& out);
+
+private:
+    size_t window;
+    long long maxLeadNs;
+    std::vector<PoseSample> recent;
+};
+
+// How far off the predicted poses were, against where the mouse actually
+// was at the target time (interpolated between the samples around it), and
+// for comparison how far off the plain newest sample would have been.
+// Run a capture through --replay to get numbers for a session.
+class PredictionStats
+{
+public:
+    PredictionStats();
+
+    //A pose sent for targetNs: predicted, and the sample it was predicted from
+    void Expect(long long targetNs, const PoseSample& predicted, const PoseSample& newest);
+    //Every sample, in order; resolves the predictions it has passed
+    void Actual(const PoseSample& sample);
+    //The pose jumped (clutch): the open predictions can't be scored against
+    //where the mouse is after the jump, they are dropped
+    void Discontinuity();
+
+    void Report(FILE* out) const;
+
+private:
+    struct Pending
+    {
+        long long targetNs;
+        double predictedX, predictedY, predictedTheta;
+        double staleX, staleY, staleTheta;
+    };
+
+    struct Error
+    {
+        unsigned long long count;
+        double sum, sumSquares, max;
+        void Add(double value);
+    };
+
+    std::vector<Pending> pending;
+    size_t first;
+    size_t size;
+    unsigned long long overflow;
+    bool haveLast;
+    PoseSample last;
+
+    Error predictedPosition, predictedTheta;
+    Error stalePosition, staleTheta;
+};
@@ -0,0 +1,159 @@
+#include "pose_publisher.h"
+
+#include <chrono>
+
+#include "kinematics.hpp"
+#include "record_format.h"
+#include "session_clock.h"
+
+LatencyStats::LatencyStats()
+    : count(0), sumNs(0), maxNs(0), buckets(BUCKETS, 0)
+{
+}
+
+void LatencyStats::Add(long long ns)
+{
+    count++;
+    sumNs += (double)ns;
+    if (ns > maxNs)
+        maxNs = ns;
+    size_t bucket = ns < 0 ? 0 : (size_t)(ns / BUCKET_NS);
+    buckets[bucket < BUCKETS ? bucket : BUCKETS - 1]++;
+}
+
+void LatencyStats::Report(FILE* out, const char* name) const
+{
+    if (count == 0)
+        return;
+    //upper edge of the bucket the fraction of samples falls in
+    double percentile[2] = { 0.5, 0.99 };
+    double ms[2] = { 0, 0 };
+    for (int p = 0; p < 2; p++)
+    {
+        unsigned long long rank = (unsigned long long)(percentile[p] * (count - 1)) + 1, seen = 0;
+        size_t i = 0;
+        while (i < BUCKETS - 1 && (seen += buckets[i]) < rank)
+            i++;
+        ms[p] = (i + 1) * BUCKET_NS / 1e6;
+    }
+    fprintf(out, "  %s mean %.3f ms  p50 %.1f ms  p99 %.1f ms  max %.3f ms\n", name, sumNs / count / 1e6, ms[0], ms[1],
+        maxNs / 1e6);
+}
+
+PosePublisher::PosePublisher(SendFunction send, bool binary, long long intervalNs)
+    : send(send), binary(binary), intervalNs(intervalNs), running(false), consumerWaiting(false),
+    seq(0), sent(0), dropped(0)
+{
+}
+
+PosePublisher::~PosePublisher()
+{
+    Stop();
+}
+
+void PosePublisher::Start()
+{
+    if (running)
+        return;
+    running = true;
+    thread = std::thread(&PosePublisher::Run, this);
+}
+
+void PosePublisher::Stop()
+{
+    if (!running)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        running = false;
+        wake.notify_one();
+    }
+    if (thread.joinable())
+        thread.join();
+}
+
+void PosePublisher::Post(const PosePacket& packet, long long sampleNs, long long arrivalNs)
+{
+    Outgoing pose = { packet, sampleNs, arrivalNs };
+    mailbox.Post(pose);
+
+    //Only pay for the mutex when the thread is actually asleep on new poses
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumerWaiting)
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wake.notify_one();
+    }
+}
+
+void PosePublisher::Run()
+{
+    typedef std::chrono::steady_clock clock;
+    const std::chrono::nanoseconds interval(intervalNs);
+    clock::time_point next = clock::now();
+    Outgoing pose;
+
+    while (running)
+    {
+        if (intervalNs > 0)
+        {
+            next += interval;
+            //after a stall start over instead of sending a burst to catch up
+            clock::time_point now = clock::now();
+            if (next < now)
+                next = now;
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait_until(lock, next, [this] { return !running; });
+        }
+        else if (!mailbox.HasNew())
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            consumerWaiting = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            wake.wait(lock, [this] { return mailbox.HasNew() || !running; });
+            consumerWaiting = false;
+        }
+
+        if (mailbox.Take(pose))
+            Send(pose);
+    }
+
+    //the visualiser should end where the arm did
+    if (mailbox.Take(pose))
+        Send(pose);
+}
+
+void PosePublisher::Send(Outgoing& pose)
+{
+    PosePacket& packet = pose.packet;
+    char buffer[POSE_TEXT_BUFFER];
+    int length;
+    packet.seq = seq;
+    if (binary)
+        length = pose_packet_encode(packet, reinterpret_cast<uint8_t*>(buffer));
+    else
+    {
+        ArmPose<double> arm = { packet.x1, packet.y1, packet.x2, packet.y2 };
+        JointAngles<double> q = { packet.degree1, packet.degree2, packet.degree3 };
+        length = format_pose_text(buffer, sizeof(buffer), arm, packet.x, packet.y, q, packet.theta);
+        //%lf of a huge value runs past any buffer, a cut line would parse as wrong numbers
+        if (length < 0 || length >= (int)sizeof(buffer))
+        {
+            dropped++;
+            return;
+        }
+    }
+
+    if (send(buffer, length))
+    {
+        seq++;
+        sent++;
+        long long now = session_ns();
+        if (pose.sampleNs >= 0)
+            sampleLatency.Add(now - pose.sampleNs);
+        if (pose.arrivalNs >= 0)
+            hostLatency.Add(now - pose.arrivalNs);
+    }
+    else
+        dropped++;
+}
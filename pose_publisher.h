@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "latest_mailbox.h"
+#include "pose_packet.h"
+
+// Distribution of one latency over the poses that went out: mean, median,
+// 99th percentile and max. The percentiles come from 0.1 ms buckets, the
+// last one collects everything from 100 ms on.
+class LatencyStats
+{
+public:
+    LatencyStats();
+
+    void Add(long long ns);
+    unsigned long long Count() const { return count; }
+    void Report(FILE* out, const char* name) const;
+
+private:
+    static const long long BUCKET_NS = 100000;
+    static const size_t BUCKETS = 1000;
+
+    unsigned long long count;
+    double sumNs;
+    long long maxNs;
+    std::vector<unsigned long long> buckets;
+};
+
+// Sends the tracked pose to visual.py from its own thread, so the serial
+// loop never waits for the network stack: it posts every pose into a
+// LatestMailbox and goes on with the next report.
+//
+// The thread either sends each new pose as soon as it is posted
+// (intervalNs = 0), or wakes every intervalNs, e.g. once per display
+// refresh, and sends the newest pose if there is one it has not sent.
+// Poses the thread never got to send are counted as coalesced, poses it
+// took but could not send (send failed, text line too long) as dropped.
+class PosePublisher
+{
+public:
+    //Puts one datagram on the wire, true if all of it went out
+    typedef std::function<bool(const char* data, int length)> SendFunction;
+
+    //binary: pose_packet.h datagrams, else the old text lines
+    PosePublisher(SendFunction send, bool binary, long long intervalNs = 0);
+    ~PosePublisher();
+
+    void Start();
+    //Sends the pose still in the mailbox, then stops the thread
+    void Stop();
+
+    //Tracking loop side, never blocks. packet.seq is set by the publisher
+    //when the datagram goes out. sampleNs, arrivalNs: when the sensors were
+    //read and when the report reached the host, on the session clock, -1
+    //if not known; they only feed the latency stats.
+    void Post(const PosePacket& packet, long long sampleNs = -1, long long arrivalNs = -1);
+
+    uint64_t Posted() const { return mailbox.Posted(); }
+    uint64_t Coalesced() const { return mailbox.Coalesced(); }
+    uint64_t Sent() const { return sent; }
+    uint64_t Dropped() const { return dropped; }
+    //Sensor read to sendto and report arrival to sendto of the sent poses,
+    //read them after Stop
+    const LatencyStats& SampleLatency() const { return sampleLatency; }
+    const LatencyStats& HostLatency() const { return hostLatency; }
+
+private:
+    struct Outgoing
+    {
+        PosePacket packet;
+        long long sampleNs;
+        long long arrivalNs;
+    };
+
+    void Run();
+    void Send(Outgoing& pose);
+
+    SendFunction send;
+    bool binary;
+    long long intervalNs;
+
+    LatestMailbox<Outgoing> mailbox;
+    std::thread thread;
+    std::atomic<bool> running;
+    //Lets the thread sleep until a pose is posted or Stop is called
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::atomic<bool> consumerWaiting;
+
+    uint32_t seq;
+    std::atomic<uint64_t> sent;
+    std::atomic<uint64_t> dropped;
+    LatencyStats sampleLatency;
+    LatencyStats hostLatency;
+};
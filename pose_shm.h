@@ -0,0 +1,69 @@
+#ifndef POSE_SHM_H_INCLUDED
+#define POSE_SHM_H_INCLUDED
+
+/* Shared memory pose channel, Code.cpp -> local consumers (visual.py --shm).
+ * Plain C layout, so any process on the machine can map the segment and
+ * read the newest pose without a syscall; remote consumers stay on UDP.
+ *
+ * Segment name: POSE_SHM_NAME, shm_open("/pmw_pose") on POSIX (the file
+ * /dev/shm/pmw_pose on Linux), the mapping "Local\pmw_pose" on Windows.
+ * Size sizeof(PoseShm), little endian, all offsets fixed:
+ *   [0..63]     header: magic, version, ring size, slot size, count, closed
+ *   [64..175]   latest: the newest pose
+ *   [192..]     ring:   the last POSE_SHM_RING_SIZE poses, pose seq in
+ *                       ring[seq % POSE_SHM_RING_SIZE]
+ *
+ * Every slot is a seqlock. The writer makes stamp 2 * seq + 1 while it
+ * rewrites the record and 2 * seq + 2 when it holds pose seq. A reader
+ * loads stamp, copies the record, loads stamp again (acquire ordering
+ * around the copy) and keeps the copy only if both loads returned the same
+ * even value; otherwise it retries, or for the ring, knows it was lapped.
+ * count is stored after both slots, as the number of poses written. The
+ * writer sets closed to 1 when the program ends, where UDP sends "END".
+ */
+
+#include <stdint.h>
+
+#define POSE_SHM_NAME "pmw_pose"
+#define POSE_SHM_MAGIC 0x53574D50u /* "PMWS" */
+#define POSE_SHM_VERSION 1
+#define POSE_SHM_RING_SIZE 256
+
+/* Same fields and flags (POSE_FLAG_*) as the pose_packet.h datagram */
+typedef struct PoseShmRecord
+{
+    uint64_t seq;
+    int64_t hostNs;
+    uint32_t deviceMicros;
+    uint16_t flags;
+    uint16_t reserved;
+    double x1, y1, x2, y2;
+    double x, y;
+    double degree1, degree2, degree3;
+    double theta;
+} PoseShmRecord;
+
+typedef struct PoseShmSlot
+{
+    uint64_t stamp;
+    PoseShmRecord record;
+} PoseShmSlot;
+
+typedef struct PoseShm
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved0;
+    uint32_t ringSize;
+    uint32_t slotSize;
+    uint64_t count;
+    uint64_t closed;
+    uint8_t reserved1[32];
+
+    PoseShmSlot latest;
+    uint8_t reserved2[16];
+
+    PoseShmSlot ring[POSE_SHM_RING_SIZE];
+} PoseShm;
+
+#endif /* POSE_SHM_H_INCLUDED */
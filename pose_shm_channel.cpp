@@ -0,0 +1,277 @@
+#include "pose_shm_channel.h"
+
+#include <atomic>
+#include <stddef.h>
+#include <string.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(offsetof(PoseShm, latest) == 64, "pose_shm.h layout changed");
+static_assert(offsetof(PoseShm, ring) == 192, "pose_shm.h layout changed");
+static_assert(sizeof(PoseShmSlot) == 112, "pose_shm.h layout changed");
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t), "no lock-free 64-bit atomics");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "no lock-free 32-bit atomics");
+
+//The segment is plain C, the seqlock protocol needs atomic 64-bit loads and
+//stores on it. Records are copied word by word as well so the copy a reader
+//throws away is a clean race, not undefined behaviour.
+template <typename T>
+static std::atomic<T>& word(const T& value)
+{
+    return *reinterpret_cast<std::atomic<T>*>(const_cast<T*>(&value));
+}
+
+static const size_t RECORD_WORDS = sizeof(PoseShmRecord) / sizeof(uint64_t);
+
+static void write_slot(PoseShmSlot& slot, const PoseShmRecord& record)
+{
+    word(slot.stamp).store(2 * record.seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    const uint64_t* in = reinterpret_cast<const uint64_t*>(&record);
+    uint64_t* out = reinterpret_cast<uint64_t*>(&slot.record);
+    for (size_t i = 0; i < RECORD_WORDS; i++)
+        word(out[i]).store(in[i], std::memory_order_relaxed);
+    word(slot.stamp).store(2 * record.seq + 2, std::memory_order_release);
+}
+
+//Copy of a slot's record, true if stamp (0: never written) was even and
+//did not change during the copy
+static bool read_slot(const PoseShmSlot& slot, PoseShmRecord& record, uint64_t& stamp)
+{
+    stamp = word(slot.stamp).load(std::memory_order_acquire);
+    if (stamp & 1)
+        return false;
+    uint64_t* out = reinterpret_cast<uint64_t*>(&record);
+    const uint64_t* in = reinterpret_cast<const uint64_t*>(&slot.record);
+    for (size_t i = 0; i < RECORD_WORDS; i++)
+        out[i] = word(in[i]).load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return word(slot.stamp).load(std::memory_order_relaxed) == stamp;
+}
+
+#ifdef _WIN32
+static std::string mapping_name(const char* name)
+{
+    return std::string("Local\\") + name;
+}
+#else
+static std::string mapping_name(const char* name)
+{
+    return std::string("/") + name;
+}
+#endif
+
+PoseShmWriter::PoseShmWriter()
+    : shm(nullptr), count(0)
+{
+#ifdef _WIN32
+    mapping = NULL;
+#endif
+}
+
+PoseShmWriter::~PoseShmWriter()
+{
+    Close();
+}
+
+bool PoseShmWriter::Open(const char* name)
+{
+    Close();
+    this->name = mapping_name(name);
+#ifdef _WIN32
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, (DWORD)sizeof(PoseShm), this->name.c_str());
+    if (mapping == NULL)
+        return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(PoseShm));
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        mapping = NULL;
+        return false;
+    }
+#else
+    int fd = shm_open(this->name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+        return false;
+    void* view = MAP_FAILED;
+    if (ftruncate(fd, sizeof(PoseShm)) == 0)
+        view = mmap(nullptr, sizeof(PoseShm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+    {
+        shm_unlink(this->name.c_str());
+        return false;
+    }
+#endif
+
+    //readers check the magic last, after the rest of the header is there
+    shm = static_cast<PoseShm*>(view);
+    word(shm->magic).store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memset(reinterpret_cast<char*>(shm) + sizeof(shm->magic), 0, sizeof(PoseShm) - sizeof(shm->magic));
+    shm->version = POSE_SHM_VERSION;
+    shm->ringSize = POSE_SHM_RING_SIZE;
+    shm->slotSize = sizeof(PoseShmSlot);
+    count = 0;
+    word(shm->magic).store(POSE_SHM_MAGIC, std::memory_order_release);
+    return true;
+}
+
+void PoseShmWriter::Close()
+{
+    if (shm == nullptr)
+        return;
+    word(shm->closed).store(1, std::memory_order_release);
+#ifdef _WIN32
+    UnmapViewOfFile(shm);
+    CloseHandle(mapping);
+    mapping = NULL;
+#else
+    munmap(shm, sizeof(PoseShm));
+    shm_unlink(name.c_str());
+#endif
+    shm = nullptr;
+}
+
+void PoseShmWriter::Publish(const PosePacket& packet)
+{
+    if (shm == nullptr)
+        return;
+
+    PoseShmRecord record;
+    record.seq = count;
+    record.hostNs = packet.hostNs;
+    record.deviceMicros = packet.deviceMicros;
+    record.flags = packet.flags;
+    record.reserved = 0;
+    record.x1 = packet.x1;
+    record.y1 = packet.y1;
+    record.x2 = packet.x2;
+    record.y2 = packet.y2;
+    record.x = packet.x;
+    record.y = packet.y;
+    record.degree1 = packet.degree1;
+    record.degree2 = packet.degree2;
+    record.degree3 = packet.degree3;
+    record.theta = packet.theta;
+
+    write_slot(shm->latest, record);
+    write_slot(shm->ring[count % POSE_SHM_RING_SIZE], record);
+    count++;
+    word(shm->count).store(count, std::memory_order_release);
+}
+
+PoseShmReader::PoseShmReader()
+    : shm(nullptr)
+{
+#ifdef _WIN32
+    mapping = NULL;
+#endif
+}
+
+PoseShmReader::~PoseShmReader()
+{
+    Close();
+}
+
+bool PoseShmReader::Open(const char* name)
+{
+    Close();
+    const std::string path = mapping_name(name);
+#ifdef _WIN32
+    mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+    if (mapping == NULL)
+        return false;
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, sizeof(PoseShm));
+    if (view == NULL)
+    {
+        CloseHandle(mapping);
+        mapping = NULL;
+        return false;
+    }
+#else
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    const void* view = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(PoseShm))
+        view = mmap(nullptr, sizeof(PoseShm), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return false;
+#endif
+
+    shm = static_cast<const PoseShm*>(view);
+    if (word(shm->magic).load(std::memory_order_acquire) != POSE_SHM_MAGIC || shm->version != POSE_SHM_VERSION
+        || shm->ringSize != POSE_SHM_RING_SIZE || shm->slotSize != sizeof(PoseShmSlot))
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void PoseShmReader::Close()
+{
+    if (shm == nullptr)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile(shm);
+    CloseHandle(mapping);
+    mapping = NULL;
+#else
+    munmap(const_cast<PoseShm*>(shm), sizeof(PoseShm));
+#endif
+    shm = nullptr;
+}
+
+uint64_t PoseShmReader::Count() const
+{
+    return shm ? word(shm->count).load(std::memory_order_acquire) : 0;
+}
+
+bool PoseShmReader::Closed() const
+{
+    return shm == nullptr || word(shm->closed).load(std::memory_order_acquire) != 0;
+}
+
+bool PoseShmReader::Latest(PoseShmRecord& record) const
+{
+    if (shm == nullptr)
+        return false;
+    for (int attempt = 0; attempt < POSE_SHM_READ_RETRIES; attempt++)
+    {
+        uint64_t stamp;
+        if (read_slot(shm->latest, record, stamp))
+            return stamp != 0;
+        //the writer was in the middle of the record, it's done in a few ns
+    }
+    return false;
+}
+
+size_t PoseShmReader::ReadFrom(uint64_t& next, PoseShmRecord* out, size_t maxCount) const
+{
+    const uint64_t end = Count();
+    const uint64_t oldest = end > POSE_SHM_RING_SIZE ? end - POSE_SHM_RING_SIZE : 0;
+    if (next > end)
+        next = end;
+    if (next < oldest)
+        next = oldest;
+
+    //a pose that fails was overwritten, so everything before it was as well
+    size_t n = 0;
+    for (; next < end && n < maxCount; next++)
+    {
+        uint64_t stamp;
+        if (read_slot(shm->ring[next % POSE_SHM_RING_SIZE], out[n], stamp) && stamp == 2 * next + 2)
+            n++;
+        else
+            n = 0;
+    }
+    return n;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "pose_packet.h"
+#include "pose_shm.h"
+
+// Writer and reader for the pose_shm.h segment. One process writes (Code.cpp
+// next to PosePublisher); readers in other processes map the same name.
+// Publish and every read are plain loads and stores into the mapping, the
+// only syscalls are in Open and Close.
+
+//Tries at a record the writer is rewriting before a read gives up. The
+//writer takes a few ns per record, so only a writer that died halfway
+//through one uses them up.
+const int POSE_SHM_READ_RETRIES = 1000;
+
+class PoseShmWriter
+{
+public:
+    PoseShmWriter();
+    ~PoseShmWriter();
+
+    //Create the segment, or take over one a previous run left behind
+    bool Open(const char* name = POSE_SHM_NAME);
+    bool IsOpen() const { return shm != nullptr; }
+    //Mark the segment closed for the readers and unmap it; on POSIX the
+    //name is removed, readers that have it mapped keep their mapping
+    void Close();
+
+    //Newest pose into latest and the ring. packet.seq is ignored, the
+    //record gets the number of poses published before it.
+    void Publish(const PosePacket& packet);
+
+private:
+    PoseShm* shm;
+    uint64_t count;
+    std::string name;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+};
+
+class PoseShmReader
+{
+public:
+    PoseShmReader();
+    ~PoseShmReader();
+
+    //False while no writer has created the segment, or it has another layout
+    bool Open(const char* name = POSE_SHM_NAME);
+    bool IsOpen() const { return shm != nullptr; }
+    void Close();
+
+    //Poses published so far, and whether the writer has finished
+    uint64_t Count() const;
+    bool Closed() const;
+
+    //Newest pose, false while there is none or the writer stopped in the
+    //middle of writing it
+    bool Latest(PoseShmRecord& record) const;
+    //Like PoseHistory::ReadFrom: up to maxCount poses from next on, next is
+    //advanced past them; a reader more than POSE_SHM_RING_SIZE behind
+    //continues at the oldest pose still in the ring.
+    size_t ReadFrom(uint64_t& next, PoseShmRecord* out, size_t maxCount) const;
+
+private:
+    const PoseShm* shm;
+#ifdef _WIN32
+    HANDLE mapping;
+#endif
+};
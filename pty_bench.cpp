@@ -0,0 +1,345 @@
+// Streams synthetic PMW3360_dualsensor.ino output through a pseudo terminal pair
+// into Serial (SerialPosix.cpp) and MouseStreamParser, checks that every report
+// arrives intact and prints the throughput. Linux only.
+//
+//   g++ -O2 -std=c++14 -pthread pty_bench.cpp Serial.cpp SerialPosix.cpp wait_strategy.cpp mouse_link.cpp byte_source.cpp session_clock.cpp -o pty_bench
+//   ./pty_bench [reports] [--direct] [--wait spin|yield|block] [--interval us] [--negotiate rate] [--hello ms]
+//
+// --direct    reads the port from the main loop instead of the reader thread
+// --wait      what the loop does when ReadData returns nothing (default spin)
+// --interval  pace the reports like the firmware does (7200us) instead of
+//             streaming at full speed, and measure the real report latency
+// --negotiate run the 'B' baud switch against a simulated firmware first:
+//             once with a firmware that never confirms, which has to leave
+//             both ends at 9600, then once with a lost ack and a retry
+// --hello     run the readiness handshake against a simulated firmware that
+//             boots for ms milliseconds first, then against firmware without
+//             the handshake, whose reports have to end the wait well before
+//             HELLO_TIMEOUT_MS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+
+#include "SerialClass.h"
+#include "mouse_parser.h"
+#include "wait_strategy.h"
+#include "mouse_link.h"
+#include "byte_source.h"
+
+typedef std::chrono::steady_clock bench_clock;
+
+//Rate the firmware starts at, SERIAL_BAUD in Code.cpp and the sketch
+static const unsigned long SERIAL_BAUD = 9600;
+
+//How the simulated firmware handles the 'B' command
+enum class BaudSwitchSim
+{
+    //the first ack gets lost on the wire, the retry works
+    DropFirstAck,
+    //acks and switches but never sees the host's 'K', so it goes back to
+    //the old rate after 1s and never answers "BOK"
+    NoConfirm
+};
+
+//Firmware side of the 'B' command (change_baud in the sketch), on the pty
+//master. rate is the rate the firmware runs at.
+static void simulate_baud_switch(int master, BaudSwitchSim mode, std::atomic<unsigned long>& rate)
+{
+    std::string command;
+    char ch;
+    bool dropAck = mode == BaudSwitchSim::DropFirstAck;
+
+    while (read(master, &ch, 1) == 1)
+    {
+        if (ch == 'B')
+            command.clear();
+        command += ch;
+        if (ch != '\n' || command[0] != 'B')
+            continue;
+
+        if (!dropAck)
+        {
+            std::string ack = "\n" + command;
+            if (write(master, ack.data(), ack.size()) < 0)
+                return;
+        }
+        unsigned long oldRate = rate;
+        rate = strtoul(command.c_str() + 1, nullptr, 10);
+
+        //wait for 'K' at the new rate
+        bench_clock::time_point start = bench_clock::now();
+        while (bench_clock::now() - start < std::chrono::seconds(1))
+        {
+            struct pollfd pfd = { master, POLLIN, 0 };
+            if (poll(&pfd, 1, 10) <= 0)
+                continue;
+            if (read(master, &ch, 1) == 1 && ch == 'K' && mode != BaudSwitchSim::NoConfirm)
+            {
+                if (write(master, "\nBOK\n", 5) < 0)
+                    return;
+                return;
+            }
+        }
+        rate = oldRate;
+        if (mode == BaudSwitchSim::NoConfirm)
+            return;
+        dropAck = false;
+        command.clear();
+    }
+}
+
+//Firmware side of the hello handshake for a board that was already running:
+//nothing until bootMs has passed, then a hello for the next 'H'
+static void simulate_hello(int master, long bootMs)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(bootMs));
+    tcflush(master, TCIFLUSH);
+    char ch;
+    while (read(master, &ch, 1) == 1)
+    {
+        if (ch != 'H')
+            continue;
+        const char hello[] = "\nHELLO 4 ascii\n";
+        if (write(master, hello, sizeof(hello) - 1) < 0)
+            return;
+        return;
+    }
+}
+
+//Firmware from before the handshake: ignores 'H', sends a report every
+//SYNTHETIC_INTERVAL_US until stop is set
+static void simulate_no_hello(int master, const std::atomic<bool>& stop)
+{
+    for (long i = 0; !stop; i++)
+    {
+        int raw[4];
+        synthetic_report(i, raw);
+        std::string report;
+        append_ascii_report(report, (uint32_t)(i * SYNTHETIC_INTERVAL_US), raw, 0, 0);
+        if (write(master, report.data(), report.size()) < 0)
+            return;
+        std::this_thread::sleep_for(std::chrono::microseconds(SYNTHETIC_INTERVAL_US));
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    long reports = 1000000;
+    bool direct = false;
+    WaitMode waitMode = WaitMode::Spin;
+    long intervalUs = 0;
+    unsigned long negotiateRate = 0;
+    long helloBootMs = -1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--direct") == 0)
+            direct = true;
+        else if (strcmp(argv[i], "--wait") == 0 && i + 1 < argc)
+        {
+            if (!parse_wait_mode(argv[++i], waitMode))
+            {
+                printf("unknown wait mode %s\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+            intervalUs = atol(argv[++i]);
+        else if (strcmp(argv[i], "--negotiate") == 0 && i + 1 < argc)
+            negotiateRate = strtoul(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--hello") == 0 && i + 1 < argc)
+            helloBootMs = atol(argv[++i]);
+        else
+            reports = atol(argv[i]);
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+    {
+        printf("could not create a pseudo terminal\n");
+        return 1;
+    }
+
+    //Synthetic motion, sums are compared with what the parser reports
+    std::string stream;
+    std::vector<size_t> reportEnd;
+    long long expectedSum = 0;
+    for (long i = 0; i < reports; i++)
+    {
+        int raw[4];
+        synthetic_report(i, raw);
+        append_ascii_report(stream, (uint32_t)(i * SYNTHETIC_INTERVAL_US), raw, 0, 0);
+        reportEnd.push_back(stream.size());
+        //host sign convention, see mouse_record_from_packet
+        expectedSum += raw[0] - 2LL * raw[1] - 3LL * raw[2] - 4LL * raw[3];
+    }
+
+    Serial port(ptsname(master), SERIAL_BAUD);
+    if (!port.IsConnected())
+        return 1;
+    if (!direct)
+        port.StartReader(1 << 20);
+
+    if (helloBootMs >= 0)
+    {
+        std::thread firmware(simulate_hello, master, helloBootMs);
+        bench_clock::time_point helloStart = bench_clock::now();
+        FirmwareHello hello;
+        bool ready = wait_for_hello(port, HELLO_TIMEOUT_MS, hello);
+        firmware.join();
+        printf("hello       : %s after %.0f ms\n", ready ? "ready" : "TIMED OUT",
+            std::chrono::duration<double, std::milli>(bench_clock::now() - helloStart).count());
+        if (!ready)
+            return 1;
+
+        std::atomic<bool> stop(false);
+        std::thread oldFirmware(simulate_no_hello, master, std::cref(stop));
+        helloStart = bench_clock::now();
+        ready = wait_for_hello(port, HELLO_TIMEOUT_MS, hello);
+        double waitedMs = std::chrono::duration<double, std::milli>(bench_clock::now() - helloStart).count();
+        stop = true;
+        oldFirmware.join();
+        //its reports and the 'H's must not reach the benchmark below
+        tcflush(master, TCIFLUSH);
+        char drain[4096];
+        do
+            while (port.ReadData(drain, sizeof(drain)) > 0) {}
+        while (port.WaitForData(20));
+        bool fellBack = !ready && waitedMs < HELLO_TIMEOUT_MS / 4;
+        printf("no hello    : %s after %.0f ms\n", fellBack ? "reports, carrying on" : "FAILED", waitedMs);
+        if (!fellBack)
+            return 1;
+    }
+
+    if (negotiateRate != 0)
+    {
+        std::atomic<unsigned long> firmwareRate(SERIAL_BAUD);
+
+        //No "BOK": the host gives up after 1.5s and both ends go back
+        std::thread silent(simulate_baud_switch, master, BaudSwitchSim::NoConfirm, std::ref(firmwareRate));
+        bench_clock::time_point negotiateStart = bench_clock::now();
+        bool switched = negotiate_baud(port, SERIAL_BAUD, negotiateRate);
+        silent.join();
+        bool fellBack = !switched && port.GetBaudRate() == SERIAL_BAUD && firmwareRate == SERIAL_BAUD;
+        printf("no confirm  : %s, host %lu firmware %lu baud after %.0f ms\n", fellBack ? "fell back" : "FAILED",
+            port.GetBaudRate(), firmwareRate.load(),
+            std::chrono::duration<double, std::milli>(bench_clock::now() - negotiateStart).count());
+        if (!fellBack)
+            return 1;
+
+        //First request's ack gets lost, so the retry path runs too
+        std::thread firmware(simulate_baud_switch, master, BaudSwitchSim::DropFirstAck, std::ref(firmwareRate));
+        negotiateStart = bench_clock::now();
+        switched = negotiate_baud(port, SERIAL_BAUD, negotiateRate) && port.GetBaudRate() == negotiateRate;
+        firmware.join();
+        switched = switched && firmwareRate == negotiateRate;
+        printf("negotiate   : %s to %lu baud in %.0f ms\n", switched ? "switched" : "FAILED", negotiateRate,
+            std::chrono::duration<double, std::milli>(bench_clock::now() - negotiateStart).count());
+        if (!switched)
+            return 1;
+    }
+
+    bench_clock::time_point start = bench_clock::now();
+    //When each report was handed to the pty, only filled in paced mode
+    std::vector<std::atomic<long long> > sentAt(intervalUs > 0 ? reports : 0);
+
+    //Firmware side: push the whole stream as fast as the pty takes it,
+    //or one report per interval
+    std::thread firmware([&]() {
+        size_t done = 0;
+        for (long i = 0; i < reports && done < stream.size(); i++)
+        {
+            size_t end = stream.size();
+            if (intervalUs > 0)
+            {
+                std::this_thread::sleep_until(start + std::chrono::microseconds(intervalUs * i));
+                end = reportEnd[i];
+                sentAt[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now() - start).count();
+            }
+            while (done < end)
+            {
+                ssize_t written = write(master, stream.data() + done, std::min<size_t>(end - done, 4096));
+                if (written <= 0)
+                    return;
+                done += (size_t)written;
+            }
+        }
+    });
+
+    SerialSource source(port);
+    WaitStrategy waiter(waitMode);
+    WaitStats waitStats;
+    std::vector<double> latencyMs;
+
+    MouseStreamParser parser;
+    long received = 0;
+    long long sum = 0;
+    long reads = 0;
+    char buffer[4096];
+    bench_clock::time_point lastData = bench_clock::now();
+
+    while (received < reports && port.IsConnected())
+    {
+        int n = port.ReadData(buffer, sizeof(buffer));
+        waitStats.Record(n);
+        if (n > 0)
+        {
+            waiter.Reset();
+            reads++;
+            lastData = bench_clock::now();
+            parser.Feed(buffer, n, [&](const MouseRecord& record) {
+                if (intervalUs > 0)
+                {
+                    long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(lastData - start).count();
+                    latencyMs.push_back((now - sentAt[received]) * 1e-6);
+                }
+                received++;
+                sum += record.dx1 + 2LL * record.dx2 + 3LL * record.dy1 + 4LL * record.dy2;
+            });
+        }
+        else if (bench_clock::now() - lastData > std::chrono::seconds(2) + std::chrono::microseconds(intervalUs))
+        {
+            break;
+        }
+        else
+        {
+            waiter.Idle(source);
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    firmware.join();
+    close(master);
+
+    printf("mode        : %s\n", direct ? "direct ReadData" : "reader thread");
+    printf("reports     : %ld / %ld (parse errors %lu, dropped bytes %lu)\n",
+        received, reports, parser.Errors(), port.DroppedBytes());
+    printf("checksum    : %s\n", sum == expectedSum ? "ok" : "MISMATCH");
+    printf("time        : %.3f s, %.0f reports/s, %.1f MB/s\n",
+        seconds, received / seconds, stream.size() / seconds / 1e6);
+    printf("bytes/read  : %.1f\n", reads ? (double)stream.size() / reads : 0.0);
+    if (!latencyMs.empty())
+    {
+        std::sort(latencyMs.begin(), latencyMs.end());
+        double mean = 0;
+        for (size_t i = 0; i < latencyMs.size(); i++)
+            mean += latencyMs[i];
+        mean /= latencyMs.size();
+        printf("latency     : mean %.3f ms, p99 %.3f ms, max %.3f ms\n",
+            mean, latencyMs[latencyMs.size() * 99 / 100], latencyMs.back());
+    }
+    waitStats.Report(stdout, waitMode, port.GetBaudRate());
+
+    return (received == reports && sum == expectedSum) ? 0 : 1;
+}
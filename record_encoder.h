@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <vector>
+
+#include "log_sink.h"
+
+// Turns a stream of Records into the bytes of a log file. The encoder keeps
+// what it has not written yet and decides when a piece is complete (a full
+// text buffer, a full chunk); AsyncLogger calls Add per record and Finish
+// once per flush interval and at the end, a thread writing its own log
+// synchronously does the same. Both return false when the sink failed.
+template <typename Record>
+class RecordEncoder
+{
+public:
+    virtual ~RecordEncoder() {}
+
+    virtual bool Add(const Record& record, LogSink& sink) = 0;
+    //Write out everything added so far
+    virtual bool Finish(LogSink& sink) = 0;
+};
+
+// One line of text per record. format writes a record into out, at most
+// maxRecordBytes, and returns how many bytes that was; lines are collected
+// into a large buffer that goes to the sink in one piece.
+template <typename Record>
+class TextEncoder : public RecordEncoder<Record>
+{
+public:
+    typedef size_t (*Formatter)(const Record& record, char* out);
+
+    TextEncoder(Formatter format, size_t maxRecordBytes, size_t bufferBytes = 1 << 20)
+        : format(format), maxRecordBytes(maxRecordBytes),
+        buffer(bufferBytes < 2 * maxRecordBytes ? 2 * maxRecordBytes : bufferBytes), used(0)
+    {
+    }
+
+    bool Add(const Record& record, LogSink& sink) override
+    {
+        bool ok = true;
+        if (buffer.size() - used < maxRecordBytes)
+            ok = Finish(sink);
+        used += format(record, buffer.data() + used);
+        return ok;
+    }
+
+    bool Finish(LogSink& sink) override
+    {
+        if (used == 0)
+            return true;
+        bool ok = sink.Write(buffer.data(), used);
+        used = 0;
+        return ok;
+    }
+
+private:
+    Formatter format;
+    size_t maxRecordBytes;
+    std::vector<char> buffer;
+    size_t used;
+};
@@ -0,0 +1,149 @@
+#include "record_format.h"
+
+#include <stdio.h>
+#include <sstream>
+#include <string>
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <charconv>
+#endif
+
+//One number into out (32 bytes room), returns the end. std::to_chars gives
+//the shortest text that reads back exactly, without locale or allocation;
+//compilers without floating point to_chars get the same round trip from %.17g.
+static char* put_number(char* out, double value)
+{
+#if defined(__cpp_lib_to_chars)
+    return std::to_chars(out, out + 32, value).ptr;
+#else
+    return out + snprintf(out, 32, "%.17g", value);
+#endif
+}
+
+static char* put_number(char* out, unsigned int value)
+{
+#if defined(__cpp_lib_to_chars)
+    return std::to_chars(out, out + 32, value).ptr;
+#else
+    return out + snprintf(out, 32, "%u", value);
+#endif
+}
+
+const StreamSchema& mouse_schema()
+{
+    static const StreamSchema schema = { "mouse", {
+        { "hostTime", "ns", FieldType::Int64, offsetof(MouseRow, hostNs), 0 },
+        { "x", "in", FieldType::Float64, offsetof(MouseRow, x), 0 },
+        { "y", "in", FieldType::Float64, offsetof(MouseRow, y), 0 },
+        { "x1", "in", FieldType::Float64, offsetof(MouseRow, x1), 0 },
+        { "y1", "in", FieldType::Float64, offsetof(MouseRow, y1), 0 },
+        { "x2", "in", FieldType::Float64, offsetof(MouseRow, x2), 0 },
+        { "y2", "in", FieldType::Float64, offsetof(MouseRow, y2), 0 },
+        { "theta", "deg", FieldType::Float64, offsetof(MouseRow, theta), 0 },
+        { "degree1", "deg", FieldType::Float64, offsetof(MouseRow, degree1), 0 },
+        { "degree2", "deg", FieldType::Float64, offsetof(MouseRow, degree2), 0 },
+        { "degree3", "deg", FieldType::Float64, offsetof(MouseRow, degree3), 0 },
+        //after the columns the mouse log always had, like in the CSV
+        { "sampleTime", "ns", FieldType::Int64, offsetof(MouseRow, sampleNs), 0 },
+        { "dx1", "count", FieldType::Int32, offsetof(MouseRow, dx1), 0 },
+        { "dy1", "count", FieldType::Int32, offsetof(MouseRow, dy1), 0 },
+        { "dx2", "count", FieldType::Int32, offsetof(MouseRow, dx2), 0 },
+        { "dy2", "count", FieldType::Int32, offsetof(MouseRow, dy2), 0 },
+        { "deviceTime", "us", FieldType::Int64, offsetof(MouseRow, deviceMicros), 0 } }, 11 };
+    return schema;
+}
+
+size_t format_mouse_row(const MouseRow& row, char* out)
+{
+    const double fields[11] = { row.x, row.y, row.x1, row.y1, row.x2, row.y2,
+        row.theta, row.degree1, row.degree2, row.degree3, row.sampleNs / 1e6 };
+    char* p = put_number(out, (unsigned int)(row.hostNs / 1000000));
+    for (int i = 0; i < 11; i++)
+    {
+        *p++ = ',';
+        p = put_number(p, fields[i]);
+    }
+    *p++ = '\n';
+    return (size_t)(p - out);
+}
+
+int format_pose_text(char* buffer, size_t size, const ArmPose<double>& arm, double x, double y,
+    const JointAngles<double>& q, double theta)
+{
+    return snprintf(buffer, size, "%lf %lf %lf %lf %lf %lf %lf %lf %lf %lf \n",
+        arm.x1, arm.y1, arm.x2, arm.y2, x, y, q.degree1, q.degree2, q.degree3, theta);
+}
+
+void write_myo_row(std::ostream& out, unsigned int hostMs, const MyoSample& sample)
+{
+    out << hostMs << ", ";
+
+    // Data is valid only when onArm.
+    out << sample.onArm << ", " << sample.isUnlocked << ", " << (sample.leftArm ? 1 : 0) << ", ";
+    out << sample.roll << ", " << sample.pitch << ", " << sample.yaw << ", ";
+    out << sample.accl[0] << ", " << sample.accl[1] << ", " << sample.accl[2] << ", ";
+    out << sample.gyro[0] << ", " << sample.gyro[1] << ", " << sample.gyro[2] << ", ";
+
+    for (size_t i = 0; i < 8; i++) {
+        std::ostringstream oss;
+        oss << static_cast<int>(sample.emg[i]);
+        std::string emgString = oss.str();
+        if (i != 0)
+            out << ", ";
+        out << emgString;
+    }
+    out << std::flush;
+
+    out << std::endl;
+}
+
+static_assert(sizeof(bool) == 1, "MyoSample flags are logged as u8");
+
+const StreamSchema& myo_schema()
+{
+    const size_t s = offsetof(MyoRow, sample);
+    static const StreamSchema schema = { "myoarmband", {
+        { "hostTime", "ns", FieldType::Int64, offsetof(MyoRow, hostNs), 0 },
+        { "onArm", "", FieldType::UInt8, s + offsetof(MyoSample, onArm), 0 },
+        { "isUnlocked", "", FieldType::UInt8, s + offsetof(MyoSample, isUnlocked), 0 },
+        { "leftArm", "", FieldType::UInt8, s + offsetof(MyoSample, leftArm), 0 },
+        { "roll", "rad", FieldType::Float32, s + offsetof(MyoSample, roll), 0 },
+        { "pitch", "rad", FieldType::Float32, s + offsetof(MyoSample, pitch), 0 },
+        { "yaw", "rad", FieldType::Float32, s + offsetof(MyoSample, yaw), 0 },
+        { "accl_x", "g", FieldType::Float32, s + offsetof(MyoSample, accl), 0 },
+        { "accl_y", "g", FieldType::Float32, s + offsetof(MyoSample, accl) + 4, 0 },
+        { "accl_z", "g", FieldType::Float32, s + offsetof(MyoSample, accl) + 8, 0 },
+        { "gyro_x", "deg/s", FieldType::Float32, s + offsetof(MyoSample, gyro), 0 },
+        { "gyro_y", "deg/s", FieldType::Float32, s + offsetof(MyoSample, gyro) + 4, 0 },
+        { "gyro_z", "deg/s", FieldType::Float32, s + offsetof(MyoSample, gyro) + 8, 0 },
+        { "emg0", "", FieldType::Int8, s + offsetof(MyoSample, emg), 0 },
+        { "emg1", "", FieldType::Int8, s + offsetof(MyoSample, emg) + 1, 0 },
+        { "emg2", "", FieldType::Int8, s + offsetof(MyoSample, emg) + 2, 0 },
+        { "emg3", "", FieldType::Int8, s + offsetof(MyoSample, emg) + 3, 0 },
+        { "emg4", "", FieldType::Int8, s + offsetof(MyoSample, emg) + 4, 0 },
+        { "emg5", "", FieldType::Int8, s + offsetof(MyoSample, emg) + 5, 0 },
+        { "emg6", "", FieldType::Int8, s + offsetof(MyoSample, emg) + 6, 0 },
+        { "emg7", "", FieldType::Int8, s + offsetof(MyoSample, emg) + 7, 0 },
+        { "emgDeviceTime", "us", FieldType::UInt64, offsetof(MyoRow, emgMicros), 0 },
+        { "imuDeviceTime", "us", FieldType::UInt64, offsetof(MyoRow, imuMicros), 0 } }, 0 };
+    return schema;
+}
+
+const StreamSchema& marker_schema()
+{
+    static const StreamSchema schema = { "motion_capture", {
+        { "frame", "", FieldType::Int32, offsetof(MarkerFrame, frame), 0 },
+        { "hostTime", "ns", FieldType::Int64, offsetof(MarkerFrame, hostNs), 0 },
+        { "deviceTime", "us", FieldType::Int64, offsetof(MarkerFrame, deviceMicros), 0 },
+        //last, a CSV row ends with however many markers the frame had
+        { "markers_xyz", "m", FieldType::Float64Array, offsetof(MarkerFrame, values), offsetof(MarkerFrame, xyz) } }, 1 };
+    return schema;
+}
+
+void write_marker_row(std::ostream& out, int frame, unsigned long hostMs, const double* xyz, int markers)
+{
+    out << frame;
+    out << "," << hostMs;
+    for (int i = 0; i < markers; i++)
+        out << "," << xyz[i * 3] << "," << xyz[i * 3 + 1] << "," << xyz[i * 3 + 2];
+    out << "\n";
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ostream>
+
+#include "kinematics.hpp"
+#include "stream_log.h"
+
+// What the trackers write per sample, kept apart from the SDK code around it
+// so the benchmark can time exactly what runs live:
+//   format_mouse_row  rawdata CSV of the mouse loop (AsyncLogger, Code.cpp)
+//   format_pose_text  UDP datagram for visual.py (PosePublisher::Send)
+//   write_myo_row     DataCollector::log_data (myologger.cpp)
+//   write_marker_row  ProcessFrame (motion_capture.cpp)
+// and the records and stream_log.h schemas of the binary logs.
+
+//rawdata/mouse, myoarmband and motion_capture as stream_log.h files (.bin,
+//log_export turns them into the CSV), or CSV directly (.csv)
+const bool BINARY_LOGS = true;
+//the logger threads hand what they have to the OS this often
+const long long LOG_FLUSH_MS = 1000;
+//write the logs through MmapSink (preallocated, memory mapped) instead of
+//FileSink, for sessions of hours
+const bool MMAP_LOGS = true;
+
+// One row of rawdata/mouse.csv, pushed into the mouse AsyncLogger. Times
+// are session_clock.h ns: hostNs when the report's bytes arrived,
+// sampleNs when the sensors were read (the device stamp through ClockSync).
+struct MouseRow
+{
+    long long hostNs;
+    long long sampleNs;
+    //the firmware's micros() stamp as sent, -1 for firmware without one
+    long long deviceMicros;
+    double x, y;
+    double x1, y1, x2, y2;
+    double theta;
+    double degree1, degree2, degree3;
+    //sensor counts of the sample, binary log only: dead_reckon_batch can
+    //replay a session from them with another CPI or sensor distance
+    int32_t dx1, dy1, dx2, dy2;
+};
+
+//Longest text format_mouse_row writes
+const size_t MOUSE_ROW_MAX_CHARS = 12 * 32;
+
+//hostMs,x,y,x1,y1,x2,y2,theta,degree1,degree2,degree3,sampleMs and a newline:
+//the columns rawdata/mouse.csv always had with sampleMs appended, so existing
+//scripts read the same columns. hostMs in whole milliseconds as before, the
+//doubles in the shortest form that reads back to the same value.
+//Returns the length, nothing is terminated. An AsyncLogger Formatter.
+size_t format_mouse_row(const MouseRow& row, char* out);
+
+//Fields of MouseRow, chunk time range from sampleNs
+const StreamSchema& mouse_schema();
+
+//Buffer PosePublisher formats the text datagram into
+const size_t POSE_TEXT_BUFFER = 512;
+
+//snprintf semantics: the text length, the buffer always ends up terminated
+int format_pose_text(char* buffer, size_t size, const ArmPose<double>& arm, double x, double y,
+    const JointAngles<double>& q, double theta);
+
+// What DataCollector logs of a Myo, without the SDK types
+struct MyoSample
+{
+    bool onArm;
+    bool isUnlocked;
+    bool leftArm;
+    float roll, pitch, yaw;
+    float accl[3];
+    float gyro[3];
+    int8_t emg[8];
+};
+
+void write_myo_row(std::ostream& out, unsigned int hostMs, const MyoSample& sample);
+
+// One row of the Myo log, what write_myo_row writes. hostNs is session
+// time, the device stamps are the Myo SDK's (microseconds) of the newest
+// EMG and orientation sample in it.
+struct MyoRow
+{
+    long long hostNs;
+    uint64_t emgMicros;
+    uint64_t imuMicros;
+    MyoSample sample;
+};
+
+const StreamSchema& myo_schema();
+
+//xyz: markers * 3 coordinates
+void write_marker_row(std::ostream& out, int frame, unsigned long hostMs, const double* xyz, int markers);
+
+//Markers of a frame a MarkerFrame holds, further ones are not logged
+const int MAX_FRAME_MARKERS = 64;
+
+// One Motive frame, what write_marker_row writes. Only the first values
+// doubles of xyz go to the log, out of line of the fixed columns. hostNs
+// is session time, deviceMicros Motive's frame timestamp.
+struct MarkerFrame
+{
+    int32_t frame;
+    uint32_t values;
+    long long hostNs;
+    long long deviceMicros;
+    double xyz[MAX_FRAME_MARKERS * 3];
+};
+
+const StreamSchema& marker_schema();
@@ -0,0 +1,123 @@
+#include "session_clock.h"
+
+#include <stdint.h>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CLOCK_X86
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <x86intrin.h>
+#define CLOCK_X86
+#endif
+
+typedef std::chrono::steady_clock steady;
+
+struct SessionClock
+{
+    steady::time_point epoch;
+    bool tsc;
+    //session ns = baseNs + (rdtsc - baseTicks) * nsPerTick
+    uint64_t baseTicks;
+    long long baseNs;
+    double nsPerTick;
+
+    SessionClock();
+};
+
+static bool invariant_tsc()
+{
+#if defined(CLOCK_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if ((unsigned)info[0] < 0x80000007)
+        return false;
+    __cpuid(info, 0x80000007);
+    return (info[3] & (1 << 8)) != 0;
+#elif defined(CLOCK_X86)
+    unsigned a, b, c, d;
+    if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007 || !__get_cpuid(0x80000007, &a, &b, &c, &d))
+        return false;
+    return (d & (1 << 8)) != 0;
+#else
+    return false;
+#endif
+}
+
+#ifdef CLOCK_X86
+static inline uint64_t read_tsc()
+{
+    return __rdtsc();
+}
+
+//A TSC reading and the steady_clock time taken between two of them, the
+//pair out of a few tries with the least time in between
+static void tsc_pair(uint64_t& ticks, steady::time_point& time)
+{
+    uint64_t best = ~(uint64_t)0;
+    for (int i = 0; i < 8; i++)
+    {
+        uint64_t before = read_tsc();
+        steady::time_point t = steady::now();
+        uint64_t after = read_tsc();
+        if (after - before < best)
+        {
+            best = after - before;
+            ticks = before + best / 2;
+            time = t;
+        }
+    }
+}
+#endif
+
+SessionClock::SessionClock()
+    : epoch(steady::now()), tsc(false), baseTicks(0), baseNs(0), nsPerTick(0)
+{
+#ifdef CLOCK_X86
+    if (!SESSION_CLOCK_TSC || !invariant_tsc())
+        return;
+
+    uint64_t ticks0 = 0, ticks1 = 0;
+    steady::time_point time0, time1;
+    tsc_pair(ticks0, time0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(SESSION_CLOCK_CALIBRATION_MS));
+    tsc_pair(ticks1, time1);
+
+    double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(time1 - time0).count();
+    //0.1 to 100 GHz, anything else is a broken measurement
+    if (ticks1 <= ticks0 || ns / (ticks1 - ticks0) < 0.01 || ns / (ticks1 - ticks0) > 10)
+        return;
+    nsPerTick = ns / (ticks1 - ticks0);
+    baseTicks = ticks1;
+    baseNs = std::chrono::duration_cast<std::chrono::nanoseconds>(time1 - epoch).count();
+    tsc = true;
+#endif
+}
+
+//Constructed by the first caller, thread safe
+static const SessionClock& session_clock()
+{
+    static const SessionClock clock;
+    return clock;
+}
+
+void session_clock_start()
+{
+    session_clock();
+}
+
+long long session_ns()
+{
+    const SessionClock& clock = session_clock();
+#ifdef CLOCK_X86
+    if (clock.tsc)
+        return clock.baseNs + (long long)((double)(int64_t)(read_tsc() - clock.baseTicks) * clock.nsPerTick);
+#endif
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(steady::now() - clock.epoch).count();
+}
+
+bool session_clock_tsc()
+{
+    return session_clock().tsc;
+}
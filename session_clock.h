@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+
+// The timebase every acquisition thread stamps with: nanoseconds since one
+// session epoch, monotonic, the same in the mouse loop, the Myo and the
+// Motive thread, so their logs line up without resampling.
+//
+// It is steady_clock (clock_gettime(CLOCK_MONOTONIC), QueryPerformanceCounter)
+// unless the CPU has an invariant TSC; then session_ns is one rdtsc and a
+// multiply, scaled by a calibration against steady_clock when the clock
+// starts. The TSC rate is measured over SESSION_CLOCK_CALIBRATION_MS, a
+// few ppm off at worst, which is the same for every stream.
+
+//use the TSC when the CPU has an invariant one
+const bool SESSION_CLOCK_TSC = true;
+//how long session_clock_start measures the TSC rate for
+const int SESSION_CLOCK_CALIBRATION_MS = 50;
+
+//Sets the epoch and calibrates the TSC. Call it at startup before the
+//acquisition threads, the first session_ns does it otherwise (and blocks
+//for the calibration); later calls do nothing.
+void session_clock_start();
+
+//Nanoseconds since the epoch
+long long session_ns();
+
+//Milliseconds since the epoch, what the CSV logs write as their time
+inline unsigned int session_ms()
+{
+    return (unsigned int)(session_ns() / 1000000);
+}
+
+//Whether session_ns reads the TSC
+bool session_clock_tsc();
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+// End of a session for the acquisition threads (Myo, Motive). They run
+// detached and log through loggers of their own, so main can't just return:
+// the rows still queued would be lost and an MmapSink would stay padded to
+// its extent. main calls StopAndWait once the tracking loop is done; every
+// thread that began a log leaves its loop, stops its logger, closes the file
+// and calls EndLog, and main returns after the last one did.
+class SessionStop
+{
+public:
+    SessionStop() : stopping(false), openLogs(0) {}
+
+    //Acquisition thread, before it opens its log. False once the session is
+    //stopping: the thread should not open it any more.
+    bool BeginLog()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping)
+            return false;
+        openLogs++;
+        return true;
+    }
+
+    //Acquisition thread, after its logger is stopped and the file closed
+    void EndLog()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        openLogs--;
+        closed.notify_all();
+    }
+
+    //Polled by the acquisition loops
+    bool Requested()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return stopping;
+    }
+
+    //main: ask the threads to stop and wait for their logs, at most
+    //timeoutMs for a thread stuck in its SDK. False if it timed out.
+    bool StopAndWait(unsigned int timeoutMs)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        stopping = true;
+        return closed.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return openLogs == 0; });
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable closed;
+    bool stopping;
+    int openLogs;
+};
+
+//The one every thread of the process uses
+inline SessionStop& session_stop()
+{
+    static SessionStop stop;
+    return stop;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// Instruction sets the batch kernels (odometry_batch.h) have
+// versions for. Every kernel takes the level to run at so the benchmark can
+// compare them; simd_level_best is what the CPU running this supports.
+
+enum class SimdLevel
+{
+    Scalar,
+    Sse2,
+    Avx2
+};
+
+const char* simd_level_name(SimdLevel level);
+//Best level this CPU and build support
+SimdLevel simd_level_best();
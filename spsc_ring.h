@@ -0,0 +1,93 @@
+#ifndef SPSC_RING_H_INCLUDED
+#define SPSC_RING_H_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <stddef.h>
+#include <string.h>
+
+// Lock-free ring for exactly one producer thread and one consumer thread.
+// Capacity is rounded up to a power of two. Push and Pop move whole blocks
+// with at most two memcpy calls, so T has to be trivially copyable.
+template <typename T>
+class SpscRing
+{
+public:
+    explicit SpscRing(size_t minCapacity)
+        : capacity(RoundUp(minCapacity)), mask(capacity - 1), data(new T[capacity]), head(0), tail(0)
+    {
+    }
+
+    //Producer side: copy up to count items, return how many fit
+    size_t Push(const T* items, size_t count)
+    {
+        const size_t writePos = head.load(std::memory_order_relaxed);
+        const size_t readPos = tail.load(std::memory_order_acquire);
+        const size_t space = capacity - (writePos - readPos);
+        if (count > space)
+            count = space;
+
+        CopyIn(writePos, items, count);
+        head.store(writePos + count, std::memory_order_release);
+        return count;
+    }
+
+    //Consumer side: copy up to count items out, return how many were available
+    size_t Pop(T* items, size_t count)
+    {
+        const size_t readPos = tail.load(std::memory_order_relaxed);
+        const size_t writePos = head.load(std::memory_order_acquire);
+        const size_t available = writePos - readPos;
+        if (count > available)
+            count = available;
+
+        CopyOut(readPos, items, count);
+        tail.store(readPos + count, std::memory_order_release);
+        return count;
+    }
+
+    //Approximate when called from a third thread
+    size_t Size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    size_t Capacity() const { return capacity; }
+
+private:
+    static size_t RoundUp(size_t value)
+    {
+        size_t result = 1;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    void CopyIn(size_t position, const T* items, size_t count)
+    {
+        const size_t start = position & mask;
+        const size_t first = count < capacity - start ? count : capacity - start;
+        memcpy(data.get() + start, items, first * sizeof(T));
+        memcpy(data.get(), items + first, (count - first) * sizeof(T));
+    }
+
+    void CopyOut(size_t position, T* items, size_t count) const
+    {
+        const size_t start = position & mask;
+        const size_t first = count < capacity - start ? count : capacity - start;
+        memcpy(items, data.get() + start, first * sizeof(T));
+        memcpy(items + first, data.get(), (count - first) * sizeof(T));
+    }
+
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<T[]> data;
+
+    //Keep the two indices on separate cache lines so the threads don't share one
+    char padding0[64];
+    std::atomic<size_t> head;
+    char padding1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;
+};
+
+#endif // SPSC_RING_H_INCLUDED
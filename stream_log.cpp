@@ -0,0 +1,369 @@
+#include "stream_log.h"
+
+#include <string.h>
+
+#include "delta_codec.h"
+
+size_t field_type_size(FieldType type)
+{
+    switch (type)
+    {
+    case FieldType::Int8: case FieldType::UInt8: return 1;
+    case FieldType::Int16: case FieldType::UInt16: return 2;
+    case FieldType::Int32: case FieldType::UInt32: case FieldType::Float32: case FieldType::Float64Array: return 4;
+    case FieldType::Int64: case FieldType::UInt64: case FieldType::Float64: return 8;
+    }
+    return 0;
+}
+
+const char* field_type_name(FieldType type)
+{
+    switch (type)
+    {
+    case FieldType::Int8: return "i8";
+    case FieldType::UInt8: return "u8";
+    case FieldType::Int16: return "i16";
+    case FieldType::UInt16: return "u16";
+    case FieldType::Int32: return "i32";
+    case FieldType::UInt32: return "u32";
+    case FieldType::Int64: return "i64";
+    case FieldType::UInt64: return "u64";
+    case FieldType::Float32: return "f32";
+    case FieldType::Float64: return "f64";
+    case FieldType::Float64Array: return "f64[]";
+    }
+    return nullptr;
+}
+
+//Columns of these are delta_codec.h coded
+static bool is_integer(FieldType type)
+{
+    return type != FieldType::Float32 && type != FieldType::Float64;
+}
+
+//Integer field value at p, values are stored as they are in memory
+static long long load_integer(FieldType type, const uint8_t* p)
+{
+    switch (type)
+    {
+    case FieldType::Int8: { int8_t v; memcpy(&v, p, 1); return v; }
+    case FieldType::UInt8: return *p;
+    case FieldType::Int16: { int16_t v; memcpy(&v, p, 2); return v; }
+    case FieldType::UInt16: { uint16_t v; memcpy(&v, p, 2); return v; }
+    case FieldType::Int32: { int32_t v; memcpy(&v, p, 4); return v; }
+    case FieldType::UInt32: case FieldType::Float64Array: { uint32_t v; memcpy(&v, p, 4); return v; }
+    case FieldType::Int64: { int64_t v; memcpy(&v, p, 8); return v; }
+    case FieldType::UInt64: { uint64_t v; memcpy(&v, p, 8); return (long long)v; }
+    case FieldType::Float32: { float v; memcpy(&v, p, 4); return (long long)v; }
+    case FieldType::Float64: { double v; memcpy(&v, p, 8); return (long long)v; }
+    }
+    return 0;
+}
+
+static void put(std::vector<uint8_t>& out, uint64_t value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        out.push_back((uint8_t)(value >> (8 * i)));
+}
+
+static void put_text(std::vector<uint8_t>& out, const char* text)
+{
+    size_t length = strlen(text);
+    put(out, length, 2);
+    out.insert(out.end(), text, text + length);
+}
+
+StreamLogWriter::StreamLogWriter(const StreamSchema& schema, size_t chunkRecords)
+    : schema(schema), chunkRecords(chunkRecords), records(0), firstTime(0), lastTime(0), headerWritten(false),
+    columns(schema.fields.size()), arrays(schema.fields.size())
+{
+    for (size_t i = 0; i < schema.fields.size(); i++)
+        columns[i].reserve(chunkRecords * field_type_size(schema.fields[i].type));
+}
+
+void StreamLogWriter::Add(const void* record)
+{
+    const uint8_t* base = static_cast<const uint8_t*>(record);
+    for (size_t i = 0; i < schema.fields.size(); i++)
+    {
+        const FieldSpec& field = schema.fields[i];
+        const uint8_t* value = base + field.offset;
+        columns[i].insert(columns[i].end(), value, value + field_type_size(field.type));
+        if (field.type == FieldType::Float64Array)
+        {
+            uint32_t count;
+            memcpy(&count, value, sizeof(count));
+            const double* elements = reinterpret_cast<const double*>(base + field.arrayOffset);
+            arrays[i].insert(arrays[i].end(), elements, elements + count);
+        }
+    }
+
+    const FieldSpec& timeField = schema.fields[schema.timeField];
+    long long time = load_integer(timeField.type, base + timeField.offset);
+    if (records == 0 || time < firstTime)
+        firstTime = time;
+    if (records == 0 || time > lastTime)
+        lastTime = time;
+    records++;
+}
+
+void StreamLogWriter::WriteHeader()
+{
+    out.insert(out.end(), STREAM_LOG_MAGIC, STREAM_LOG_MAGIC + 4);
+    put(out, STREAM_LOG_VERSION, 2);
+    put(out, schema.fields.size(), 2);
+    put(out, schema.timeField, 2);
+    put_text(out, schema.name);
+    for (size_t i = 0; i < schema.fields.size(); i++)
+    {
+        put(out, (uint8_t)schema.fields[i].type, 1);
+        put_text(out, schema.fields[i].name);
+        put_text(out, schema.fields[i].unit);
+    }
+}
+
+bool StreamLogWriter::WriteChunk(LogSink& sink)
+{
+    out.clear();
+    if (!headerWritten)
+    {
+        WriteHeader();
+        headerWritten = true;
+    }
+
+    if (records > 0)
+    {
+        out.insert(out.end(), STREAM_LOG_CHUNK_MAGIC, STREAM_LOG_CHUNK_MAGIC + 4);
+        put(out, records, 4);
+        put(out, (uint64_t)firstTime, 8);
+        put(out, (uint64_t)lastTime, 8);
+        //bytes of the rest, filled in below
+        const size_t bytesAt = out.size();
+        put(out, 0, 8);
+
+        for (size_t i = 0; i < columns.size(); i++)
+        {
+            FieldType type = schema.fields[i].type;
+            if (is_integer(type))
+            {
+                const size_t size = field_type_size(type);
+                values.resize(records);
+                for (size_t row = 0; row < records; row++)
+                    values[row] = load_integer(type, columns[i].data() + row * size);
+                coded.resize(delta_encode_bound(records));
+                size_t codedBytes = delta_encode(values.data(), records, coded.data());
+                put(out, codedBytes, 4);
+                out.insert(out.end(), coded.begin(), coded.begin() + codedBytes);
+            }
+            else
+                out.insert(out.end(), columns[i].begin(), columns[i].end());
+            columns[i].clear();
+        }
+        for (size_t i = 0; i < arrays.size(); i++)
+        {
+            const uint8_t* elements = reinterpret_cast<const uint8_t*>(arrays[i].data());
+            out.insert(out.end(), elements, elements + arrays[i].size() * sizeof(double));
+            arrays[i].clear();
+        }
+
+        uint64_t bytes = out.size() - bytesAt - 8;
+        for (int b = 0; b < 8; b++)
+            out[bytesAt + b] = (uint8_t)(bytes >> (8 * b));
+        records = 0;
+    }
+
+    return out.empty() || sink.Write(reinterpret_cast<const char*>(out.data()), out.size());
+}
+
+StreamLogReader::StreamLogReader()
+    : file(nullptr), timeField(0), records(0), firstTime(0), lastTime(0)
+{
+}
+
+StreamLogReader::~StreamLogReader()
+{
+    Close();
+}
+
+void StreamLogReader::Close()
+{
+    if (file != nullptr)
+        fclose(file);
+    file = nullptr;
+    fields.clear();
+    records = 0;
+}
+
+static bool read_bytes(FILE* file, void* out, size_t size)
+{
+    return fread(out, 1, size, file) == size;
+}
+
+static bool read_number(FILE* file, uint64_t& value, int bytes)
+{
+    uint8_t raw[8];
+    if (!read_bytes(file, raw, bytes))
+        return false;
+    value = 0;
+    for (int i = 0; i < bytes; i++)
+        value |= (uint64_t)raw[i] << (8 * i);
+    return true;
+}
+
+static bool read_text(FILE* file, std::string& text)
+{
+    uint64_t length;
+    if (!read_number(file, length, 2))
+        return false;
+    text.resize((size_t)length);
+    return length == 0 || read_bytes(file, &text[0], (size_t)length);
+}
+
+bool StreamLogReader::Open(const char* path)
+{
+    Close();
+    file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    char magic[4];
+    uint64_t fileVersion, fieldCount, time;
+    if (!read_bytes(file, magic, 4) || memcmp(magic, STREAM_LOG_MAGIC, 4) != 0 || !read_number(file, fileVersion, 2)
+        || fileVersion != STREAM_LOG_VERSION || !read_number(file, fieldCount, 2)
+        || !read_number(file, time, 2) || !read_text(file, name) || time >= fieldCount)
+    {
+        Close();
+        return false;
+    }
+    timeField = (size_t)time;
+
+    fields.resize((size_t)fieldCount);
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+        uint64_t type;
+        if (!read_number(file, type, 1) || field_type_name((FieldType)type) == nullptr
+            || !read_text(file, fields[i].name) || !read_text(file, fields[i].unit))
+        {
+            Close();
+            return false;
+        }
+        fields[i].type = (FieldType)type;
+    }
+    columns.resize(fields.size());
+    integers.resize(fields.size());
+    arrays.resize(fields.size());
+    arrayStarts.resize(fields.size());
+    return true;
+}
+
+bool StreamLogReader::NextChunk(long long from, long long to)
+{
+    records = 0;
+    if (file == nullptr)
+        return false;
+
+    for (;;)
+    {
+        char magic[4];
+        uint64_t count, first, last, bytes;
+        if (!read_bytes(file, magic, 4) || memcmp(magic, STREAM_LOG_CHUNK_MAGIC, 4) != 0
+            || !read_number(file, count, 4) || !read_number(file, first, 8) || !read_number(file, last, 8)
+            || !read_number(file, bytes, 8))
+            return false;
+
+        if ((long long)last < from || (long long)first > to)
+        {
+            if (fseek(file, (long)bytes, SEEK_CUR) != 0)
+                return false;
+            continue;
+        }
+
+        chunk.resize((size_t)bytes);
+        if (!read_bytes(file, chunk.data(), chunk.size()))
+            return false;
+
+        //columns, then the elements of the array fields. Integer columns
+        //(u32 bytes, then the code) are decoded into integers.
+        size_t offset = 0;
+        for (size_t i = 0; i < fields.size(); i++)
+        {
+            FieldType type = fields[i].type;
+            if (!is_integer(type))
+            {
+                columns[i] = chunk.data() + offset;
+                offset += (size_t)count * field_type_size(type);
+                continue;
+            }
+
+            integers[i].resize((size_t)count);
+            uint64_t codedBytes = 0;
+            for (int b = 0; b < 4 && offset + b < chunk.size(); b++)
+                codedBytes |= (uint64_t)chunk[offset + b] << (8 * b);
+            offset += 4;
+            if (offset > chunk.size() || codedBytes > chunk.size() - offset
+                || !delta_decode(chunk.data() + offset, (size_t)codedBytes, (size_t)count, integers[i].data()))
+                return false;
+            offset += (size_t)codedBytes;
+        }
+        for (size_t i = 0; i < fields.size(); i++)
+        {
+            if (fields[i].type != FieldType::Float64Array)
+                continue;
+            arrayStarts[i].resize((size_t)count + 1);
+            size_t total = 0;
+            for (size_t row = 0; row < count; row++)
+            {
+                arrayStarts[i][row] = total;
+                uint64_t elements = (uint64_t)integers[i][row];
+                if (elements > chunk.size())
+                    return false;
+                total += (size_t)elements;
+            }
+            arrayStarts[i][(size_t)count] = total;
+            if (offset + total * sizeof(double) > chunk.size())
+                return false;
+            arrays[i].resize(total);
+            memcpy(arrays[i].data(), chunk.data() + offset, total * sizeof(double));
+            offset += total * sizeof(double);
+        }
+        if (offset != chunk.size())
+            return false;
+
+        records = (size_t)count;
+        firstTime = (long long)first;
+        lastTime = (long long)last;
+        return true;
+    }
+}
+
+long long StreamLogReader::Integer(size_t field, size_t row) const
+{
+    if (is_integer(fields[field].type))
+        return integers[field][row];
+    return load_integer(fields[field].type, columns[field] + row * field_type_size(fields[field].type));
+}
+
+double StreamLogReader::Real(size_t field, size_t row) const
+{
+    const uint8_t* p = columns[field] + row * field_type_size(fields[field].type);
+    if (fields[field].type == FieldType::Float32)
+    {
+        float v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+    if (fields[field].type == FieldType::Float64)
+    {
+        double v;
+        memcpy(&v, p, 8);
+        return v;
+    }
+    return (double)integers[field][row];
+}
+
+const double* StreamLogReader::Array(size_t field, size_t row, size_t& count) const
+{
+    const std::vector<size_t>& starts = arrayStarts[field];
+    count = starts[row + 1] - starts[row];
+    return arrays[field].data() + starts[row];
+}
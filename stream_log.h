@@ -0,0 +1,180 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "log_sink.h"
+#include "record_encoder.h"
+
+// Binary log of one stream (mouse, Myo, Motive), written instead of CSV.
+// The file describes itself: a header with the stream name and the name,
+// type and unit of every field, then chunks of up to 4096 records stored
+// column by column, each chunk with the time range it covers so a reader
+// can skip to the part of a session it wants. Integer columns (times, frame
+// numbers, EMG, sensor counts) are delta_codec.h coded, floats are stored as
+// they are. Variable length data (the markers of a Motive frame) is stored
+// after the columns, the column only holds the element count. log_export
+// turns a file back into CSV.
+//
+// Layout, little endian:
+//   header  "PMWL", u16 version, u16 field count, u16 time field,
+//           u16 length + stream name,
+//           per field: u8 FieldType, u16 length + name, u16 length + unit
+//   chunk   "CHNK", u32 records, i64 first time, i64 last time (lowest and
+//           highest value of the time field), u64 bytes of the rest:
+//           per field its column: integer types (arrays: the u32 counts)
+//           u32 bytes + delta_encode of the values, floats records values,
+//           then per array field the f64 elements of all its records
+// Chunks follow each other to the end of the file. Only files of
+// STREAM_LOG_VERSION read.
+
+#define STREAM_LOG_MAGIC "PMWL"
+#define STREAM_LOG_CHUNK_MAGIC "CHNK"
+#define STREAM_LOG_VERSION 3
+
+enum class FieldType : uint8_t
+{
+    Int8 = 1,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Int64,
+    UInt64,
+    Float32,
+    Float64,
+    //uint32_t count of doubles in the record, the doubles out of line
+    Float64Array
+};
+
+//Bytes of one value in a column (arrays: of the count)
+size_t field_type_size(FieldType type);
+//"i8", "u32", "f64[]", ... nullptr for an unknown type
+const char* field_type_name(FieldType type);
+
+// One field of a record in memory
+struct FieldSpec
+{
+    const char* name;
+    const char* unit;
+    FieldType type;
+    //of the value in the record; arrays: of the uint32_t element count
+    size_t offset;
+    //arrays only: of the first double
+    size_t arrayOffset;
+};
+
+struct StreamSchema
+{
+    const char* name;
+    std::vector<FieldSpec> fields;
+    //integer field the chunk time range is taken from
+    size_t timeField;
+};
+
+// Collects records into a chunk and writes it, the part of StreamLogEncoder
+// that does not depend on the record type
+class StreamLogWriter
+{
+public:
+    explicit StreamLogWriter(const StreamSchema& schema, size_t chunkRecords = 4096);
+
+    void Add(const void* record);
+    bool Full() const { return records >= chunkRecords; }
+    //The header the first time, then the chunk if it has records
+    bool WriteChunk(LogSink& sink);
+
+private:
+    void WriteHeader();
+
+    const StreamSchema& schema;
+    size_t chunkRecords;
+    size_t records;
+    long long firstTime, lastTime;
+    bool headerWritten;
+    std::vector<std::vector<uint8_t> > columns;
+    std::vector<std::vector<double> > arrays;
+    //integer column of the chunk being written, and its code
+    std::vector<int64_t> values;
+    std::vector<uint8_t> coded;
+    std::vector<uint8_t> out;
+};
+
+template <typename Record>
+class StreamLogEncoder : public RecordEncoder<Record>
+{
+public:
+    explicit StreamLogEncoder(const StreamSchema& schema, size_t chunkRecords = 4096)
+        : writer(schema, chunkRecords)
+    {
+    }
+
+    bool Add(const Record& record, LogSink& sink) override
+    {
+        writer.Add(&record);
+        return writer.Full() ? writer.WriteChunk(sink) : true;
+    }
+
+    bool Finish(LogSink& sink) override { return writer.WriteChunk(sink); }
+
+private:
+    StreamLogWriter writer;
+};
+
+// Reads a stream log chunk by chunk
+class StreamLogReader
+{
+public:
+    struct Field
+    {
+        std::string name;
+        std::string unit;
+        FieldType type;
+    };
+
+    StreamLogReader();
+    ~StreamLogReader();
+
+    //Opens the file and reads the header, false if it is no stream log
+    bool Open(const char* path);
+    void Close();
+
+    const std::string& Name() const { return name; }
+    const std::vector<Field>& Fields() const { return fields; }
+    size_t TimeField() const { return timeField; }
+
+    //Loads the next chunk whose time range overlaps [from, to], the ones
+    //before it are skipped without reading them. False at the end of the
+    //file; a chunk cut short (a log still being written) ends it as well.
+    bool NextChunk(long long from = INT64_MIN, long long to = INT64_MAX);
+
+    size_t Records() const { return records; }
+    long long FirstTime() const { return firstTime; }
+    long long LastTime() const { return lastTime; }
+
+    //Value of a scalar field in row of the chunk
+    long long Integer(size_t field, size_t row) const;
+    double Real(size_t field, size_t row) const;
+    //Elements of an array field in row, count set to how many
+    const double* Array(size_t field, size_t row, size_t& count) const;
+
+private:
+    FILE* file;
+    std::string name;
+    std::vector<Field> fields;
+    size_t timeField;
+
+    size_t records;
+    long long firstTime, lastTime;
+    std::vector<uint8_t> chunk;
+    //floats: where the column is in chunk; integers: the decoded values
+    std::vector<const uint8_t*> columns;
+    std::vector<std::vector<int64_t> > integers;
+    //arrays: the field's elements, and where each row's start within them
+    std::vector<std::vector<double> > arrays;
+    std::vector<std::vector<size_t> > arrayStarts;
+};
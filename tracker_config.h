@@ -0,0 +1,14 @@
+#pragma once
+
+#include "kinematics.hpp"
+
+// The mouse and arm the tracker is built for. Code.cpp runs with these, and
+// the benchmark and kinematics_test use the same ones so their numbers hold
+// for the live loop.
+
+//distance between the two sensors, inch
+const double D = 2.834646;
+//sensor resolution, counts per inch
+const double CPI = 1200.0;
+//link lengths from the shoulder out, inch
+const ArmGeometry<double> ARM = { 5, 8, 3 };
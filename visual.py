@@ -3,6 +3,55 @@ import sys
 import time
 
 import socket 
+import struct
+import mmap
+
+# pose_packet.h datagram: magic, version, flags, seq, device us, host ns, 10 doubles
+POSE_PACKET_MAGIC = b'PMWP'
+POSE_PACKET = struct.Struct('<4sHHIIq10d')
+
+# pose_shm.h segment, read instead of the socket with --shm
+POSE_SHM_NAME = 'pmw_pose'
+POSE_SHM_MAGIC = 0x53574D50
+POSE_SHM_HEADER = struct.Struct('<IHHIIQQ')
+POSE_SHM_SLOT = struct.Struct('<QQqIHH10d')
+POSE_SHM_LATEST = 64
+POSE_SHM_SIZE = 192 + 256 * POSE_SHM_SLOT.size
+# a stamp still odd after this many tries: the writer died mid-write
+POSE_SHM_READ_RETRIES = 1000
+
+def open_pose_shm():
+    """map the segment once Code.cpp has created it"""
+    while True:
+        try:
+            if sys.platform == 'win32':
+                shm = mmap.mmap(-1, POSE_SHM_SIZE, tagname='Local\\' + POSE_SHM_NAME, access=mmap.ACCESS_READ)
+            else:
+                with open('/dev/shm/' + POSE_SHM_NAME, 'rb') as f:
+                    shm = mmap.mmap(f.fileno(), POSE_SHM_SIZE, access=mmap.ACCESS_READ)
+            magic, version, _, ring_size, slot_size, count, closed = POSE_SHM_HEADER.unpack_from(shm)
+            if magic == POSE_SHM_MAGIC and version == 1 and slot_size == POSE_SHM_SLOT.size and not closed:
+                return shm
+            shm.close()
+        except (OSError, ValueError):
+            pass
+        time.sleep(0.1)
+
+def read_pose_shm(shm, last_seq):
+    """(closed, seq, fields) of the newest pose, fields None if it is still last_seq
+    or the writer stopped in the middle of it"""
+    closed = POSE_SHM_HEADER.unpack_from(shm)[6]
+    for _ in range(POSE_SHM_READ_RETRIES):
+        # seqlock: keep the copy only if the stamp was even and did not change
+        stamp, seq, host_ns, device_us, flags, _, *fields = POSE_SHM_SLOT.unpack_from(shm, POSE_SHM_LATEST)
+        if stamp & 1 == 0 and struct.unpack_from('<Q', shm, POSE_SHM_LATEST)[0] == stamp:
+            break
+    else:
+        return closed, last_seq, None
+    if stamp == 0 or seq == last_seq:
+        return closed, last_seq, None
+    return closed, seq, fields
+
 SCREEN_WIDTH = 640 * 2
 SCREEN_HEIGHT = 480 * 2
 
@@ -32,6 +81,10 @@ if __name__ == '__main__':
     UDPClientSocket = socket.socket(family=socket.AF_INET, type=socket.SOCK_DGRAM)
     UDPClientSocket.bind(serverAddressPort) 
 
+    # same machine as Code.cpp: read the newest pose from shared memory
+    shm = open_pose_shm() if '--shm' in sys.argv else None
+    shm_seq = None
+
 
 
     while True:
@@ -39,18 +92,35 @@ if __name__ == '__main__':
         for event in pygame.event.get():
             if event.type == pygame.QUIT:
                 sys.exit()
-        msgFromServer = UDPClientSocket.recvfrom(bufferSize)
-        msg = msgFromServer[0].decode('unicode_escape').encode('utf-8')
-        msg = msg.decode('utf-8')
-        temp = msg.split(' ')
-        screen.fill(white)
-        
-        if(temp[0] == 'END'):
-            print("Program is terminating")
-            quit()
-            
-        if(msg) :
-            pos_x1, pos_y1, pos_x2, pos_y2, pos_x3, pos_y3, degree1, degree2, degree3, rotate = float(temp[0]), float(temp[1]), float(temp[2]), float(temp[3]), float(temp[4]), float(temp[5]), float(temp[6]), float(temp[7]), float(temp[8]), float(temp[9])
+        fields = None
+        if shm is not None:
+            closed, shm_seq, fields = read_pose_shm(shm, shm_seq)
+            if closed:
+                print("Program is terminating")
+                quit()
+        else:
+            msgFromServer = UDPClientSocket.recvfrom(bufferSize)
+            data = msgFromServer[0]
+
+            if data[:4] == POSE_PACKET_MAGIC:
+                # later versions only append fields
+                magic, version, flags, seq, device_us, host_ns, *fields = POSE_PACKET.unpack_from(data)
+            else:
+                # text mode (Code.cpp UDP_BINARY = false) and the END message
+                msg = data.decode('unicode_escape').encode('utf-8')
+                msg = msg.decode('utf-8')
+                temp = msg.split(' ')
+
+                if(temp[0] == 'END'):
+                    print("Program is terminating")
+                    quit()
+
+                if(msg) :
+                    fields = [float(v) for v in temp[:10]]
+
+        if(fields) :
+            screen.fill(white)
+            pos_x1, pos_y1, pos_x2, pos_y2, pos_x3, pos_y3, degree1, degree2, degree3, rotate = fields
             rotated = pygame.transform.rotate(img, -rotate)
             rotated1 = pygame.transform.rotate(stick1, degree1) 
             rotated2 = pygame.transform.rotate(stick2, degree1 + degree2)
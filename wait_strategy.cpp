@@ -0,0 +1,122 @@
+#include "wait_strategy.h"
+
+#include <string.h>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define CPU_RELAX() _mm_pause()
+#elif defined(__x86_64__) || defined(__i386__)
+#define CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CPU_RELAX() ((void)0)
+#endif
+
+const char* wait_mode_name(WaitMode mode)
+{
+    switch (mode)
+    {
+    case WaitMode::Spin: return "spin";
+    case WaitMode::SpinYield: return "yield";
+    case WaitMode::Block: return "block";
+    }
+    return "?";
+}
+
+bool parse_wait_mode(const char* text, WaitMode& mode)
+{
+    if (strcmp(text, "spin") == 0) mode = WaitMode::Spin;
+    else if (strcmp(text, "yield") == 0) mode = WaitMode::SpinYield;
+    else if (strcmp(text, "block") == 0) mode = WaitMode::Block;
+    else return false;
+    return true;
+}
+
+WaitStrategy::WaitStrategy(WaitMode mode, unsigned int spinLimit, unsigned int blockTimeoutMs)
+    : mode(mode), spinLimit(spinLimit), blockTimeoutMs(blockTimeoutMs), idleRounds(0)
+{
+}
+
+void WaitStrategy::Idle(ByteSource& source)
+{
+    switch (mode)
+    {
+    case WaitMode::Spin:
+        CPU_RELAX();
+        break;
+    case WaitMode::SpinYield:
+        //Data usually comes back within a few microseconds of the last burst,
+        //only give the core away once that window has passed
+        if (idleRounds < spinLimit)
+        {
+            idleRounds++;
+            CPU_RELAX();
+        }
+        else
+            std::this_thread::yield();
+        break;
+    case WaitMode::Block:
+        source.Wait(blockTimeoutMs);
+        break;
+    }
+}
+
+double thread_cpu_seconds()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return 0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) * 1e-7;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+WaitStats::WaitStats()
+    : start(std::chrono::steady_clock::now()), startCpu(thread_cpu_seconds()),
+    reads(0), emptyReads(0), bytes(0), maxBacklog(0)
+{
+}
+
+void WaitStats::Record(int bytesRead)
+{
+    reads++;
+    if (bytesRead <= 0)
+    {
+        emptyReads++;
+        return;
+    }
+
+    bytes += bytesRead;
+    if ((unsigned long long)bytesRead > maxBacklog)
+        maxBacklog = bytesRead;
+}
+
+void WaitStats::Report(FILE* out, WaitMode mode, unsigned long baudRate) const
+{
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double cpu = thread_cpu_seconds() - startCpu;
+    unsigned long long dataReads = reads - emptyReads;
+    //8N1: 10 bits on the wire per byte
+    double byteTime = baudRate ? 10.0 / baudRate : 0;
+    double meanBacklog = dataReads ? (double)bytes / dataReads : 0;
+
+    fprintf(out, "wait mode %s: %.1f%% of a core over %.1fs\n", wait_mode_name(mode), wall > 0 ? 100.0 * cpu / wall : 0, wall);
+    fprintf(out, "  reads %llu (%.1f%% empty), %.0f reads/s\n", reads, reads ? 100.0 * emptyReads / reads : 0, wall > 0 ? reads / wall : 0);
+    fprintf(out, "  bytes per read mean %.1f max %llu, est. queueing latency mean %.3f ms max %.3f ms\n",
+        meanBacklog, maxBacklog, meanBacklog * byteTime * 1e3, maxBacklog * byteTime * 1e3);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdio.h>
+#include <chrono>
+
+#include "byte_source.h"
+
+// What the serial loop does when a read returned nothing.
+//   Spin      : go straight back to ReadData. Lowest latency, burns a full core.
+//   SpinYield : spin for a while, then give the core away with yield().
+//   Block     : sleep in ByteSource::Wait (Serial::WaitForData) until bytes arrive.
+enum class WaitMode
+{
+    Spin,
+    SpinYield,
+    Block
+};
+
+const char* wait_mode_name(WaitMode mode);
+//"spin", "yield" or "block", returns false for anything else
+bool parse_wait_mode(const char* text, WaitMode& mode);
+
+class WaitStrategy
+{
+public:
+    explicit WaitStrategy(WaitMode mode, unsigned int spinLimit = 2000, unsigned int blockTimeoutMs = 20);
+
+    //Call after a ReadData that returned no data
+    void Idle(ByteSource& source);
+    //Call after a ReadData that returned data
+    void Reset() { idleRounds = 0; }
+
+    WaitMode Mode() const { return mode; }
+
+private:
+    WaitMode mode;
+    unsigned int spinLimit;
+    unsigned int blockTimeoutMs;
+    unsigned int idleRounds;
+};
+
+// Measurement mode for the CPU-vs-latency trade-off of a wait strategy.
+// CPU is the time the calling thread spent on a core, compared to wall time.
+// Latency is estimated from the backlog: when a read returns n bytes, the
+// oldest of them has been waiting for about n byte times on the wire.
+class WaitStats
+{
+public:
+    WaitStats();
+
+    //Call after every ReadData, with its result
+    void Record(int bytesRead);
+    //Print the summary, baudRate is used for the latency estimate
+    void Report(FILE* out, WaitMode mode, unsigned long baudRate) const;
+
+private:
+    std::chrono::steady_clock::time_point start;
+    double startCpu;
+
+    unsigned long long reads;
+    unsigned long long emptyReads;
+    unsigned long long bytes;
+    unsigned long long maxBacklog;
+};
+
+//CPU seconds consumed by the calling thread
+double thread_cpu_seconds();